@@ -14,13 +14,14 @@ App::App(const HINSTANCE hInstance, const int nCmdShow)
     , mpPixelShader(nullptr)
     , mpSampler(nullptr)
     , mImageProcessor()
-    , mpImageGPU(nullptr)
-    , mpImageGPUView(nullptr)
+    , mpPresentationSink(nullptr)
     , mUIEventFlags(0)
 {
     ASSERT(hInstance != nullptr);
     ASSERT(nCmdShow >= 0);
 
+    Profiler::GetInstance()->SetThreadName("ui");
+
     HRESULT hr = S_OK;
     char msg[EDebugConstant::DEFAULT_BUFFER_SIZE];
 
@@ -263,6 +264,8 @@ App::App(const HINSTANCE hInstance, const int nCmdShow)
 
     // image
     {
+        mpPresentationSink = new TexturePresentationSink(mpDevice, mpDeviceContext);
+
         loadImage("default.png");
     }
 
@@ -283,8 +286,9 @@ App::~App()
 
     //d3d
     {
-        SafeRelease(mpImageGPUView);
-        SafeRelease(mpImageGPU);
+        delete mpPresentationSink;
+        mpPresentationSink = nullptr;
+
         SafeRelease(mpSampler);
         SafeRelease(mpPixelShader);
         SafeRelease(mpVertexBuffer);
@@ -380,30 +384,25 @@ LRESULT App::handleWndCallback(const HWND hWnd, const UINT message, const WPARAM
 
 void App::onDraw()
 {
+    PROFILE_SCOPE("App::onDraw");
+
     ASSERT(mpDeviceContext != nullptr);
     ASSERT(mpSwapChain != nullptr);
 
+    // processing runs on the worker, the newest finished result is shown without waiting for the one in flight
+    mImageProcessor.PickUpResult();
+
     const Image& imageToDraw = mImageProcessor.GetProcessedImage();
 
     // output
     {
-        D3D11_MAPPED_SUBRESOURCE mappedEntity;
-        ZeroMemory(&mappedEntity, sizeof(mappedEntity));
-
-        mpDeviceContext->Map(mpImageGPU, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedEntity);
+        // repaints of the same result upload nothing, a preview level binds the texture of its size and the quad stretches it.
+        // every result replaces the whole image and stays an Image for the histogram and the stage caches,
+        // so the frame is dirty as a whole and is copied here instead of written through BeginFrame by the worker
+        if (!imageToDraw.IsEmpty())
         {
-            uint8_t* pOutput = static_cast<uint8_t*>(mappedEntity.pData);
-            const Pixel* pRaw = imageToDraw.pRawPixels;
-
-            for (int y = 0; y < imageToDraw.Height; ++y)
-            {
-                memcpy(pOutput, pRaw, sizeof(Pixel) * imageToDraw.Width);
-
-                pOutput += mappedEntity.RowPitch;
-                pRaw += imageToDraw.Width;
-            }
+            mpPresentationSink->Present(imageToDraw.GetView(), imageToDraw.GetVersion(), MakeFullDirtyRect(imageToDraw.Width, imageToDraw.Height));
         }
-        mpDeviceContext->Unmap(mpImageGPU, 0);
 
         mpDeviceContext->Draw(4, 0);
     }
@@ -454,6 +453,8 @@ void App::onResize(const int width, const int height)
 
     mpDeviceContext->RSSetViewports(1, &viewport);
 
+    mImageProcessor.SetDisplaySize(width, height);
+
     // OM
     mpDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
     SafeRelease(mpRenderTargetView);
@@ -482,45 +483,14 @@ void App::onResize(const int width, const int height)
 
 void App::loadImage(const char* path)
 {
-    Image newImage(path);
-    {
-        char msg[EDebugConstant::DEFAULT_BUFFER_SIZE];
-
-        SafeRelease(mpImageGPU);
-        SafeRelease(mpImageGPUView);
-
-        D3D11_TEXTURE2D_DESC imageDesc;
-        imageDesc.Width = newImage.Width;
-        imageDesc.Height = newImage.Height;
-        imageDesc.MipLevels = 1;
-        imageDesc.ArraySize = 1;
-        imageDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-        imageDesc.SampleDesc.Count = 1;
-        imageDesc.SampleDesc.Quality = 0;
-        imageDesc.Usage = D3D11_USAGE_DYNAMIC;
-        imageDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        imageDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-        imageDesc.MiscFlags = 0;
-
-        HRESULT hr = mpDevice->CreateTexture2D(&imageDesc, nullptr, &mpImageGPU);
+    PROFILE_SCOPE("App::loadImage");
 
-        GetErrorDescription(hr, msg);
-        ASSERT(SUCCEEDED(hr), msg);
-
-        D3D11_SHADER_RESOURCE_VIEW_DESC imageViewDesc;
-        ZeroMemory(&imageViewDesc, sizeof(imageViewDesc));
-
-        imageViewDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-        imageViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-        imageViewDesc.Texture2D.MipLevels = 1;
-
-        mpDevice->CreateShaderResourceView(mpImageGPU, nullptr, &mpImageGPUView);
-
-        GetErrorDescription(hr, msg);
-        ASSERT(SUCCEEDED(hr), msg);
-
-        mpDeviceContext->PSSetShaderResources(0, 1, &mpImageGPUView);
+    Image newImage = DecodedImageCache::GetInstance()->Load(path);
+    if (newImage.IsEmpty())
+    {
+        return;
     }
+
     mImageProcessor.RegisterImage(std::move(newImage));
 }
 
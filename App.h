@@ -19,7 +19,10 @@
 #include "FileDialog.h"
 
 #include "Image.h"
+#include "DecodedImageCache.h"
 #include "ImageProcessor.h"
+#include "Profiler.h"
+#include "TexturePresentationSink.h"
 
 class App final
 {
@@ -60,8 +63,8 @@ private:
     // image
     ImageProcessor mImageProcessor;
 
-    ID3D11Texture2D* mpImageGPU;
-    ID3D11ShaderResourceView* mpImageGPUView;
+    // created with the device, resizes its texture to the presented image
+    TexturePresentationSink* mpPresentationSink;
 
     // ui
     UIFlags mUIEventFlags;
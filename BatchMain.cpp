@@ -0,0 +1,249 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "BatchProcessor.h"
+#include "PixelBufferPool.h"
+#include "Profiler.h"
+
+static void printUsage(const char* pProgramName)
+{
+    fprintf(stderr,
+        "usage: %s <input dir> <output dir> [options]\n"
+        "  --gray                 convert to gray scale\n"
+        "  --equalize             histogram equalization\n"
+        "  --match <path>         histogram matching against the reference image\n"
+        "  --brightness <ratio>   [0, 2], default 1\n"
+        "  --gamma <scaler>       [0.04, 25], default 1\n"
+        "  --simd                 vectorized brightness, gamma\n"
+        "  --format <ext>         output extension, png, jpg, bmp, tga (default: keep)\n"
+        "  --decode-threads <n>   default 1\n"
+        "  --process-threads <n>  default hardware threads - 2\n"
+        "  --encode-threads <n>   default 1\n"
+        "  --queue <n>            capacity of the queues between stages, default 4\n"
+        "  --stream               pgm / ppm row streaming for images larger than memory\n"
+        "  --large-pages          back large pixel buffers with large pages\n"
+        "  --profile <path>       chrome trace json of the run, for chrome://tracing or perfetto\n",
+        pProgramName);
+}
+
+static bool tryParseInt(const char* pText, int& outValue)
+{
+    char* pEnd = nullptr;
+    const long value = strtol(pText, &pEnd, 10);
+    if (pEnd == pText || *pEnd != '\0' || value <= 0)
+    {
+        return false;
+    }
+
+    outValue = static_cast<int>(value);
+
+    return true;
+}
+
+static bool tryParseFloat(const char* pText, float& outValue)
+{
+    char* pEnd = nullptr;
+    const float value = strtof(pText, &pEnd);
+    if (pEnd == pText || *pEnd != '\0')
+    {
+        return false;
+    }
+
+    outValue = value;
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    const int hardwareThreadCount = static_cast<int>(std::thread::hardware_concurrency());
+
+    BatchProcessor::Options options;
+    options.InputDirectory = argv[1];
+    options.OutputDirectory = argv[2];
+    options.bGrayScale = false;
+    options.HistogramProcessing = BatchProcessor::HISTOGRAM_PROCESSING_NONE;
+    options.BrightnessRatio = 1.f;
+    options.GammaScaler = 1.f;
+    options.bSIMD = false;
+    options.ThreadCounts[BatchProcessor::STAGE_DECODE] = 1;
+    options.ThreadCounts[BatchProcessor::STAGE_PROCESS] = std::max(hardwareThreadCount - 2, 1);
+    options.ThreadCounts[BatchProcessor::STAGE_ENCODE] = 1;
+    options.QueueCapacity = 4;
+    options.bStreaming = false;
+
+    const char* pProfilePath = nullptr;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        const char* const pArg = argv[i];
+        const char* const pValue = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        bool bValid = true;
+        if (strcmp(pArg, "--gray") == 0)
+        {
+            options.bGrayScale = true;
+        }
+        else if (strcmp(pArg, "--equalize") == 0)
+        {
+            options.HistogramProcessing = BatchProcessor::HISTOGRAM_PROCESSING_EQUALIZATION;
+        }
+        else if (strcmp(pArg, "--simd") == 0)
+        {
+            options.bSIMD = true;
+        }
+        else if (strcmp(pArg, "--stream") == 0)
+        {
+            options.bStreaming = true;
+        }
+        else if (strcmp(pArg, "--large-pages") == 0)
+        {
+            // the pool is shared by every stage, there is nothing to pass through the options
+            if (!PixelBufferPool::GetInstance()->SetLargePagesEnabled(true))
+            {
+                fprintf(stderr, "large pages are not available, normal pages are used\n");
+            }
+        }
+        else if (pValue == nullptr)
+        {
+            bValid = false;
+        }
+        else
+        {
+            ++i;
+
+            if (strcmp(pArg, "--match") == 0)
+            {
+                options.HistogramProcessing = BatchProcessor::HISTOGRAM_PROCESSING_MATCHING;
+                options.RefImagePath = pValue;
+            }
+            else if (strcmp(pArg, "--brightness") == 0)
+            {
+                bValid = tryParseFloat(pValue, options.BrightnessRatio) && options.BrightnessRatio >= 0.f;
+            }
+            else if (strcmp(pArg, "--gamma") == 0)
+            {
+                bValid = tryParseFloat(pValue, options.GammaScaler) && options.GammaScaler > 0.f;
+            }
+            else if (strcmp(pArg, "--format") == 0)
+            {
+                options.OutputExtension = pValue[0] == '.' ? pValue : std::string(".") + pValue;
+            }
+            else if (strcmp(pArg, "--decode-threads") == 0)
+            {
+                bValid = tryParseInt(pValue, options.ThreadCounts[BatchProcessor::STAGE_DECODE]);
+            }
+            else if (strcmp(pArg, "--process-threads") == 0)
+            {
+                bValid = tryParseInt(pValue, options.ThreadCounts[BatchProcessor::STAGE_PROCESS]);
+            }
+            else if (strcmp(pArg, "--encode-threads") == 0)
+            {
+                bValid = tryParseInt(pValue, options.ThreadCounts[BatchProcessor::STAGE_ENCODE]);
+            }
+            else if (strcmp(pArg, "--queue") == 0)
+            {
+                bValid = tryParseInt(pValue, options.QueueCapacity);
+            }
+            else if (strcmp(pArg, "--profile") == 0)
+            {
+                pProfilePath = pValue;
+            }
+            else
+            {
+                bValid = false;
+            }
+        }
+
+        if (!bValid)
+        {
+            fprintf(stderr, "invalid argument %s\n", pArg);
+            printUsage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (pProfilePath != nullptr)
+    {
+        Profiler::GetInstance()->SetThreadName("main");
+        Profiler::GetInstance()->SetEnabled(true);
+    }
+
+    BatchProcessor batchProcessor(options);
+
+    BatchProcessor::Report report;
+    if (!batchProcessor.Run(report))
+    {
+        return EXIT_FAILURE;
+    }
+
+    const int succeededCount = report.ImageCount - report.FailedCount;
+    const double imagesPerSecond = report.ElapsedSeconds > 0.0 ? succeededCount / report.ElapsedSeconds : 0.0;
+
+    printf("images: %d, failed: %d, elapsed: %.3f s, %.2f images/s\n", report.ImageCount, report.FailedCount, report.ElapsedSeconds, imagesPerSecond);
+
+    for (int stage = 0; stage < BatchProcessor::STAGE_COUNT; ++stage)
+    {
+        const BatchProcessor::StageStatistics& stats = report.Stages[stage];
+
+        // share of the wall time the threads of the stage spent working instead of waiting on a queue
+        const double utilization = report.ElapsedSeconds > 0.0 ? stats.BusySeconds / (report.ElapsedSeconds * stats.ThreadCount) : 0.0;
+        const double averageMilliseconds = stats.ProcessedCount > 0 ? stats.BusySeconds * 1000.0 / stats.ProcessedCount : 0.0;
+
+        printf("%-8s threads: %2d, images: %5d, avg: %8.2f ms, utilization: %5.1f%%\n",
+            BatchProcessor::GetStageName(static_cast<BatchProcessor::EStage>(stage)),
+            stats.ThreadCount, stats.ProcessedCount, averageMilliseconds, utilization * 100.0);
+    }
+
+    PixelBufferPool::Statistics poolStats;
+    PixelBufferPool::GetInstance()->GetStatistics(poolStats);
+
+    // images of similar size should reuse the pool instead of calling the system allocator
+    printf("buffers  acquired: %llu, reused: %llu, system allocations: %llu, large pages: %.1f MB\n",
+        static_cast<unsigned long long>(poolStats.AcquireCount),
+        static_cast<unsigned long long>(poolStats.ReuseCount),
+        static_cast<unsigned long long>(poolStats.SystemAllocationCount),
+        poolStats.LargePageBytes / (1024.0 * 1024.0));
+
+    if (pProfilePath != nullptr)
+    {
+        Profiler& profiler = *Profiler::GetInstance();
+        profiler.SetEnabled(false);
+
+        // the rings keep the latest events of every thread, a long run is summarized by its tail
+        std::vector<Profiler::ZoneStatistics> zones;
+        profiler.Summarize(std::numeric_limits<int64_t>::max(), zones);
+
+        for (const Profiler::ZoneStatistics& zone : zones)
+        {
+            const double gigabytesPerSecond = zone.TotalNanoseconds > 0 ? static_cast<double>(zone.TouchedBytes) / zone.TotalNanoseconds : 0.0;
+
+            printf("profile  %-36s %-5s calls: %7llu, total: %10.2f ms, max: %8.2f ms, %6.2f GB/s, allocations: %llu\n",
+                zone.pName, zone.Kind == PROFILE_EVENT_TASK ? "tasks" : "",
+                static_cast<unsigned long long>(zone.Count), zone.TotalNanoseconds * 1e-6, zone.MaxNanoseconds * 1e-6,
+                gigabytesPerSecond, static_cast<unsigned long long>(zone.AllocationCount));
+        }
+
+        if (!profiler.WriteChromeTrace(pProfilePath))
+        {
+            fprintf(stderr, "failed to write %s\n", pProfilePath);
+        }
+    }
+
+    return report.FailedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
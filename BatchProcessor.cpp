@@ -0,0 +1,512 @@
+#include "BatchProcessor.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <algorithm>
+
+#include "ImageProcessingHelper.h"
+#include "ImageProcessingHelperSIMD.h"
+#include "Profiler.h"
+#include "StreamingImage.h"
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+static bool isSupportedExtension(std::string extension)
+{
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const char c) { return static_cast<char>(tolower(c)); });
+
+    const char* const supportedExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif", ".psd", ".hdr", ".pic", ".pnm", ".ppm", ".pgm" };
+    for (const char* pSupported : supportedExtensions)
+    {
+        if (extension == pSupported)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static double toSeconds(const Clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+BatchProcessor::BatchProcessor(const Options& options)
+    : mOptions(options)
+    , mRefEqualizedHist()
+{
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        assert(mOptions.ThreadCounts[stage] > 0);
+    }
+    assert(mOptions.QueueCapacity > 0);
+}
+
+bool BatchProcessor::Run(Report& outReport)
+{
+    memset(&outReport, 0, sizeof(Report));
+
+    std::vector<Job> jobs;
+    if (!collectJobs(jobs) || !prepareReference())
+    {
+        return false;
+    }
+
+    if (mOptions.bStreaming)
+    {
+        return runStreaming(jobs, outReport);
+    }
+
+    const int jobCount = static_cast<int>(jobs.size());
+    outReport.ImageCount = jobCount;
+
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        outReport.Stages[stage].ThreadCount = mOptions.ThreadCounts[stage];
+    }
+
+    // queues carry job indices, images live in jobs
+    BoundedQueue<int> decodedQueue(mOptions.QueueCapacity);
+    BoundedQueue<int> processedQueue(mOptions.QueueCapacity);
+
+    std::atomic<int> nextJob(0);
+    std::atomic<int> failedCount(0);
+
+    std::atomic<int> activeStageThreads[STAGE_COUNT];
+    std::atomic<int64_t> busyNanoseconds[STAGE_COUNT];
+    std::atomic<int> processedCounts[STAGE_COUNT];
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        activeStageThreads[stage] = mOptions.ThreadCounts[stage];
+        busyNanoseconds[stage] = 0;
+        processedCounts[stage] = 0;
+    }
+
+    auto addBusyTime = [&](const EStage stage, const Clock::time_point begin)
+        {
+            busyNanoseconds[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+            ++processedCounts[stage];
+        };
+
+    auto decodeLoop = [&]()
+        {
+            Profiler::GetInstance()->SetThreadName(GetStageName(STAGE_DECODE));
+
+            int jobIndex;
+            while ((jobIndex = nextJob++) < jobCount)
+            {
+                const Clock::time_point begin = Clock::now();
+
+                Job& job = jobs[jobIndex];
+                {
+                    PROFILE_SCOPE("BatchProcessor::decode");
+
+                    job.image = Image(job.InputPath.c_str());
+                }
+
+                addBusyTime(STAGE_DECODE, begin);
+
+                if (job.image.IsEmpty())
+                {
+                    fprintf(stderr, "failed to decode %s\n", job.InputPath.c_str());
+                    ++failedCount;
+
+                    continue;
+                }
+
+                decodedQueue.Push(std::move(jobIndex));
+            }
+
+            if (--activeStageThreads[STAGE_DECODE] == 0)
+            {
+                decodedQueue.Close();
+            }
+        };
+
+    auto processLoop = [&]()
+        {
+            Profiler::GetInstance()->SetThreadName(GetStageName(STAGE_PROCESS));
+
+            int jobIndex;
+            while (decodedQueue.Pop(jobIndex))
+            {
+                const Clock::time_point begin = Clock::now();
+
+                process(jobs[jobIndex].image);
+
+                addBusyTime(STAGE_PROCESS, begin);
+
+                processedQueue.Push(std::move(jobIndex));
+            }
+
+            if (--activeStageThreads[STAGE_PROCESS] == 0)
+            {
+                processedQueue.Close();
+            }
+        };
+
+    auto encodeLoop = [&]()
+        {
+            Profiler::GetInstance()->SetThreadName(GetStageName(STAGE_ENCODE));
+
+            int jobIndex;
+            while (processedQueue.Pop(jobIndex))
+            {
+                const Clock::time_point begin = Clock::now();
+
+                Job& job = jobs[jobIndex];
+                {
+                    PROFILE_SCOPE("BatchProcessor::encode");
+
+                    if (!job.image.Save(job.OutputPath.c_str()))
+                    {
+                        fprintf(stderr, "failed to encode %s\n", job.OutputPath.c_str());
+                        ++failedCount;
+                    }
+                }
+
+                // release the pixels as soon as possible, only a few images should be alive at once
+                job.image = Image();
+
+                addBusyTime(STAGE_ENCODE, begin);
+            }
+        };
+
+    const Clock::time_point begin = Clock::now();
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < mOptions.ThreadCounts[STAGE_DECODE]; ++i)
+        {
+            threads.emplace_back(decodeLoop);
+        }
+
+        for (int i = 0; i < mOptions.ThreadCounts[STAGE_PROCESS]; ++i)
+        {
+            threads.emplace_back(processLoop);
+        }
+
+        for (int i = 0; i < mOptions.ThreadCounts[STAGE_ENCODE]; ++i)
+        {
+            threads.emplace_back(encodeLoop);
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+    outReport.ElapsedSeconds = toSeconds(Clock::now() - begin);
+    outReport.FailedCount = failedCount;
+
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        outReport.Stages[stage].ProcessedCount = processedCounts[stage];
+        outReport.Stages[stage].BusySeconds = busyNanoseconds[stage] * 1e-9;
+    }
+
+    return true;
+}
+
+const char* BatchProcessor::GetStageName(const EStage stage)
+{
+    switch (stage)
+    {
+    case STAGE_DECODE:
+        return "decode";
+
+    case STAGE_PROCESS:
+        return "process";
+
+    case STAGE_ENCODE:
+        return "encode";
+
+    default:
+        assert(false);
+        return "";
+    }
+}
+
+bool BatchProcessor::collectJobs(std::vector<Job>& outJobs) const
+{
+    std::error_code error;
+
+    const fs::path inputDirectory(mOptions.InputDirectory);
+    const fs::path outputDirectory(mOptions.OutputDirectory);
+
+    if (!fs::is_directory(inputDirectory, error))
+    {
+        fprintf(stderr, "%s is not a directory\n", mOptions.InputDirectory.c_str());
+
+        return false;
+    }
+
+    fs::create_directories(outputDirectory, error);
+    if (error)
+    {
+        fprintf(stderr, "failed to create %s\n", mOptions.OutputDirectory.c_str());
+
+        return false;
+    }
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(inputDirectory, error))
+    {
+        if (!entry.is_regular_file() || !isSupportedExtension(entry.path().extension().string()))
+        {
+            continue;
+        }
+
+        fs::path outputPath = outputDirectory / entry.path().filename();
+        if (!mOptions.OutputExtension.empty())
+        {
+            outputPath.replace_extension(mOptions.OutputExtension);
+        }
+
+        Job job;
+        job.InputPath = entry.path().string();
+        job.OutputPath = outputPath.string();
+
+        outJobs.push_back(std::move(job));
+    }
+
+    // deterministic order for reports
+    std::sort(outJobs.begin(), outJobs.end(), [](const Job& lhs, const Job& rhs) { return lhs.InputPath < rhs.InputPath; });
+
+    return true;
+}
+
+bool BatchProcessor::prepareReference()
+{
+    if (mOptions.HistogramProcessing != HISTOGRAM_PROCESSING_MATCHING)
+    {
+        return true;
+    }
+
+    Image refImage(mOptions.RefImagePath.c_str());
+    if (refImage.IsEmpty())
+    {
+        fprintf(stderr, "failed to decode reference %s\n", mOptions.RefImagePath.c_str());
+
+        return false;
+    }
+
+    if (mOptions.bGrayScale)
+    {
+        ConvertToGrayScale(refImage);
+    }
+
+    refImage.GetHistogram(mRefEqualizedHist);
+    EqualizeHistogram(mRefEqualizedHist, refImage.GetPixelCount());
+
+    return true;
+}
+
+void BatchProcessor::buildNormalizedTable(PixelF outNormalizedTable[EImageConstant::TABLE_SIZE]) const
+{
+    NormalizeTable(outNormalizedTable);
+
+    if (mOptions.bSIMD)
+    {
+        ModifyBrightnessSIMD(outNormalizedTable, TABLE_SIZE, mOptions.BrightnessRatio, mOptions.GammaScaler);
+    }
+    else
+    {
+        ModifyBrightness(outNormalizedTable, TABLE_SIZE, mOptions.BrightnessRatio, mOptions.GammaScaler);
+    }
+}
+
+void BatchProcessor::process(Image& outImage) const
+{
+    PROFILE_SCOPE("BatchProcessor::process");
+
+    // histogram pre-pass, the rest of the chain runs strip by strip in place
+    Histogram remapTable;
+    const Histogram* pRemapTable = nullptr;
+
+    switch (mOptions.HistogramProcessing)
+    {
+    case HISTOGRAM_PROCESSING_EQUALIZATION:
+        BuildEqualizationLookup(remapTable, outImage, mOptions.bGrayScale);
+        pRemapTable = &remapTable;
+        break;
+
+    case HISTOGRAM_PROCESSING_MATCHING:
+        BuildMatchingLookup(remapTable, outImage, mOptions.bGrayScale, mRefEqualizedHist);
+        pRemapTable = &remapTable;
+        break;
+
+    default:
+        // no action
+        break;
+    }
+
+    PixelF normalizedTable[TABLE_SIZE];
+    buildNormalizedTable(normalizedTable);
+
+    ProcessingChain chain;
+    chain.bGrayScale = mOptions.bGrayScale;
+    chain.bSIMD = mOptions.bSIMD;
+    chain.pRemapTable = pRemapTable;
+    chain.pNormalizedTable = normalizedTable;
+    chain.pSrcPlanes = nullptr;
+    chain.pCancellation = nullptr;
+
+    // every stage maps pixels independently so the image can be both source and destination
+    ExecuteChainInStrips(outImage, nullptr, outImage, chain);
+}
+
+bool BatchProcessor::runStreaming(const std::vector<Job>& jobs, Report& outReport) const
+{
+    const int jobCount = static_cast<int>(jobs.size());
+    outReport.ImageCount = jobCount;
+
+    double busySeconds[STAGE_COUNT] = { 0.0, };
+
+    const Clock::time_point begin = Clock::now();
+    for (const Job& job : jobs)
+    {
+        if (!processStreaming(job, busySeconds))
+        {
+            ++outReport.FailedCount;
+        }
+    }
+    outReport.ElapsedSeconds = toSeconds(Clock::now() - begin);
+
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        StageStatistics& stats = outReport.Stages[stage];
+        stats.ThreadCount = 1;
+        stats.ProcessedCount = jobCount - outReport.FailedCount;
+        stats.BusySeconds = busySeconds[stage];
+    }
+
+    return true;
+}
+
+bool BatchProcessor::processStreaming(const Job& job, double outBusySeconds[STAGE_COUNT]) const
+{
+    PROFILE_SCOPE("BatchProcessor::processStreaming");
+
+    if (!IsStreamableExtension(job.InputPath.c_str()) || !IsStreamableExtension(job.OutputPath.c_str()))
+    {
+        fprintf(stderr, "streaming needs pgm / ppm, skipping %s\n", job.InputPath.c_str());
+
+        return false;
+    }
+
+    ImageRowReader reader;
+    if (!reader.Open(job.InputPath.c_str()))
+    {
+        fprintf(stderr, "failed to decode %s\n", job.InputPath.c_str());
+
+        return false;
+    }
+
+    const int width = reader.GetWidth();
+    const int height = reader.GetHeight();
+    const int64_t pixelCount = static_cast<int64_t>(width) * height;
+
+    // luma of a gray pixel is not exactly the pixel, gray inputs skip the stage like ConvertToGrayScale
+    const bool bGrayScale = mOptions.bGrayScale && reader.GetChannelCount() > 2;
+
+    const int rowsPerStrip = std::max(1, static_cast<int>(STREAMING_STRIP_BYTES / (static_cast<int64_t>(width) * sizeof(Pixel))));
+    std::vector<Pixel> strip(static_cast<size_t>(width) * rowsPerStrip);
+
+    Clock::time_point stageBegin;
+    auto addBusyTime = [&](const EStage stage)
+        {
+            const Clock::time_point now = Clock::now();
+            outBusySeconds[stage] += toSeconds(now - stageBegin);
+            stageBegin = now;
+        };
+
+    // first pass, the histogram is the only global dependency
+    Histogram remapTable;
+    const Histogram* pRemapTable = nullptr;
+    if (mOptions.HistogramProcessing != HISTOGRAM_PROCESSING_NONE)
+    {
+        uint64_t frequencyTables[COLOR_COUNT][TABLE_SIZE] = { { 0, }, };
+
+        int readRowCount = 0;
+        int rowCount;
+
+        stageBegin = Clock::now();
+        while ((rowCount = reader.ReadRows(strip.data(), rowsPerStrip)) > 0)
+        {
+            addBusyTime(STAGE_DECODE);
+
+            AccumulateChainFrequencies(frequencyTables, strip.data(), static_cast<int64_t>(width) * rowCount, bGrayScale);
+            readRowCount += rowCount;
+
+            addBusyTime(STAGE_PROCESS);
+        }
+
+        if (readRowCount != height || !reader.Rewind())
+        {
+            fprintf(stderr, "failed to decode %s\n", job.InputPath.c_str());
+
+            return false;
+        }
+
+        EqualizeFrequencies(remapTable, frequencyTables, pixelCount);
+
+        if (mOptions.HistogramProcessing == HISTOGRAM_PROCESSING_MATCHING)
+        {
+            const Histogram equalizedHist = remapTable;
+            BuildInverseLookup(remapTable, equalizedHist, mRefEqualizedHist);
+        }
+
+        pRemapTable = &remapTable;
+    }
+
+    PixelF normalizedTable[TABLE_SIZE];
+    buildNormalizedTable(normalizedTable);
+
+    ProcessingChain chain;
+    chain.bGrayScale = bGrayScale;
+    chain.bSIMD = mOptions.bSIMD;
+    chain.pRemapTable = pRemapTable;
+    chain.pNormalizedTable = normalizedTable;
+    chain.pSrcPlanes = nullptr;
+    chain.pCancellation = nullptr;
+
+    ImageRowWriter writer;
+    if (!writer.Open(job.OutputPath.c_str(), width, height, reader.GetChannelCount()))
+    {
+        fprintf(stderr, "failed to encode %s\n", job.OutputPath.c_str());
+
+        return false;
+    }
+
+    // second pass, point operations, rows are written as soon as their strip is done
+    int rowCount;
+
+    stageBegin = Clock::now();
+    while ((rowCount = reader.ReadRows(strip.data(), rowsPerStrip)) > 0)
+    {
+        addBusyTime(STAGE_DECODE);
+
+        ExecuteChainInPlace(strip.data(), static_cast<int64_t>(width) * rowCount, chain);
+        addBusyTime(STAGE_PROCESS);
+
+        if (!writer.WriteRows(strip.data(), rowCount))
+        {
+            break;
+        }
+        addBusyTime(STAGE_ENCODE);
+    }
+
+    // Close fails unless every row has been read and written
+    if (!writer.Close())
+    {
+        fprintf(stderr, "failed to stream %s to %s\n", job.InputPath.c_str(), job.OutputPath.c_str());
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "BoundedQueue.h"
+
+// headless decode -> process -> encode pipeline over a directory
+class BatchProcessor final
+{
+public:
+    enum EHistogramProcessing
+    {
+        HISTOGRAM_PROCESSING_NONE,
+        HISTOGRAM_PROCESSING_EQUALIZATION,
+        HISTOGRAM_PROCESSING_MATCHING
+    };
+
+    enum EStage
+    {
+        STAGE_DECODE,
+        STAGE_PROCESS,
+        STAGE_ENCODE,
+
+        STAGE_COUNT
+    };
+
+    struct Options
+    {
+        std::string InputDirectory;
+        std::string OutputDirectory;
+
+        // empty keeps the input extension
+        std::string OutputExtension;
+
+        bool bGrayScale;
+        EHistogramProcessing HistogramProcessing;
+        std::string RefImagePath;
+
+        float BrightnessRatio;
+        float GammaScaler;
+        bool bSIMD;
+
+        int ThreadCounts[STAGE_COUNT];
+        int QueueCapacity;
+
+        // pgm / ppm only, images are read twice row by row and never held in memory as a whole.
+        // jobs run one after another and the stages of an image share the strips instead of queues
+        bool bStreaming;
+    };
+
+    struct StageStatistics
+    {
+        int ThreadCount;
+        int ProcessedCount;
+        double BusySeconds;
+    };
+
+    struct Report
+    {
+        int ImageCount;
+        int FailedCount;
+        double ElapsedSeconds;
+
+        StageStatistics Stages[STAGE_COUNT];
+    };
+
+public:
+    BatchProcessor(const Options& options);
+    ~BatchProcessor() = default;
+    BatchProcessor(const BatchProcessor& other) = delete;
+    BatchProcessor(BatchProcessor&& other) = delete;
+    BatchProcessor& operator=(const BatchProcessor& other) = delete;
+    BatchProcessor& operator=(BatchProcessor&& other) = delete;
+
+    // false when the input directory or the reference image can not be read
+    bool Run(Report& outReport);
+
+    static const char* GetStageName(const EStage stage);
+
+private:
+    enum EStreamingConstant
+    {
+        STREAMING_STRIP_BYTES = 8 * 1024 * 1024
+    };
+
+    struct Job
+    {
+        std::string InputPath;
+        std::string OutputPath;
+
+        Image image;
+    };
+
+private:
+    Options mOptions;
+
+    Histogram mRefEqualizedHist;
+
+private:
+    bool collectJobs(std::vector<Job>& outJobs) const;
+    bool prepareReference();
+
+    void buildNormalizedTable(PixelF outNormalizedTable[EImageConstant::TABLE_SIZE]) const;
+    void process(Image& outImage) const;
+
+    bool runStreaming(const std::vector<Job>& jobs, Report& outReport) const;
+    bool processStreaming(const Job& job, double outBusySeconds[STAGE_COUNT]) const;
+};
@@ -0,0 +1,785 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "Image.h"
+#include "ImageProcessingHelper.h"
+#include "ImageProcessingHelperSIMD.h"
+#include "IntegralImage.h"
+#include "PixelBufferPool.h"
+#include "MemoryPresentationSink.h"
+
+using Clock = std::chrono::steady_clock;
+
+enum EBenchmarkConstant
+{
+    DEFAULT_ITERATION_COUNT = 10,
+    WARM_UP_ITERATION_COUNT = 1,
+
+    LINE_BUFFER_SIZE = 1024,
+
+    // 48 bytes per pixel, the 16K tables would not fit in memory
+    MAX_INTEGRAL_IMAGE_PIXEL_COUNT = 7680 * 4320,
+    INTEGRAL_IMAGE_WINDOW_RADIUS = 15,
+
+    // brightness and gamma slider positions compared between the simd and scalar kernels
+    BRIGHTNESS_CHECK_STEP_COUNT = 16,
+    GAMMA_CHECK_STEP_COUNT = 64,
+
+    // quantized levels the simd powf may be off by
+    MAX_BRIGHTNESS_SIMD_DIFFERENCE = 1
+};
+
+struct BenchmarkCase
+{
+    std::string Name;
+
+    // sample image on disk or synthetic image of the given size when empty
+    std::string Path;
+    int Width;
+    int Height;
+};
+
+struct BenchmarkResult
+{
+    std::string Operation;
+    std::string CaseName;
+    int Width;
+    int Height;
+    int Iterations;
+
+    double MedianNsPerPixel;
+    double MeanNsPerPixel;
+    double StdDevNsPerPixel;
+    double GBPerSecond;
+};
+
+struct BenchmarkOptions
+{
+    int Iterations;
+    int MaxWidth;
+    bool bSkipDecode;
+    bool bJSON;
+    std::string OutputPath;
+    std::string BaselinePath;
+};
+
+static void printUsage(const char* pProgramName)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --iterations <n>    timed iterations per operation, default %d\n"
+        "  --max-width <n>     skip cases wider than n, 16K by default\n"
+        "  --skip-decode       do not time Image(const char*)\n"
+        "  --format csv|json   default csv\n"
+        "  --out <path>        write results to the file instead of stdout\n"
+        "  --baseline <path>   csv written by an earlier run, prints the speedup per operation\n",
+        pProgramName, DEFAULT_ITERATION_COUNT);
+}
+
+static void fillSynthetic(Image& outImage)
+{
+    // smooth gradients with noise so that histograms are not degenerate
+    Pixel* const pPixels = outImage.GetMutablePixels();
+
+    uint32_t seed = 0x12345678;
+    for (int y = 0; y < outImage.Height; ++y)
+    {
+        for (int x = 0; x < outImage.Width; ++x)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            const uint8_t noise = static_cast<uint8_t>(seed >> 28);
+
+            Pixel& pixel = pPixels[y * outImage.Width + x];
+            pixel.rgba.r = static_cast<uint8_t>(x * MAX_BRIGHTNESS / outImage.Width) ^ noise;
+            pixel.rgba.g = static_cast<uint8_t>(y * MAX_BRIGHTNESS / outImage.Height) ^ noise;
+            pixel.rgba.b = static_cast<uint8_t>((x + y) >> 4) ^ noise;
+            pixel.rgba.a = UINT8_MAX;
+        }
+    }
+}
+
+// quantized adjustment tables of both kernels over the slider ranges, false when an entry differs by more than allowed
+static bool checkModifyBrightnessSIMD()
+{
+    PixelF scalarTable[TABLE_SIZE];
+    PixelF simdTable[TABLE_SIZE];
+    uint8_t scalarLookup[COLOR_COUNT][TABLE_SIZE];
+    uint8_t simdLookup[COLOR_COUNT][TABLE_SIZE];
+
+    for (int brightnessStep = 0; brightnessStep <= BRIGHTNESS_CHECK_STEP_COUNT; ++brightnessStep)
+    {
+        // [0, 2]
+        const float brightnessRatio = 2.f * brightnessStep / BRIGHTNESS_CHECK_STEP_COUNT;
+
+        for (int gammaStep = 0; gammaStep <= GAMMA_CHECK_STEP_COUNT; ++gammaStep)
+        {
+            // [0.04, 25], evenly spaced in log scale
+            const float gammaScaler = 0.04f * powf(25.f / 0.04f, static_cast<float>(gammaStep) / GAMMA_CHECK_STEP_COUNT);
+
+            NormalizeTable(scalarTable);
+            NormalizeTable(simdTable);
+
+            ModifyBrightness(scalarTable, TABLE_SIZE, brightnessRatio, gammaScaler);
+            ModifyBrightnessSIMD(simdTable, TABLE_SIZE, brightnessRatio, gammaScaler);
+
+            BuildAdjustmentLookup(scalarLookup, scalarTable);
+            BuildAdjustmentLookup(simdLookup, simdTable);
+
+            for (int color = 0; color < COLOR_COUNT; ++color)
+            {
+                for (int i = 0; i < TABLE_SIZE; ++i)
+                {
+                    if (abs(scalarLookup[color][i] - simdLookup[color][i]) > MAX_BRIGHTNESS_SIMD_DIFFERENCE)
+                    {
+                        fprintf(stderr, "simd brightness differs at %d, brightness %.3f, gamma %.3f: %d, scalar %d\n",
+                            i, brightnessRatio, gammaScaler, simdLookup[color][i], scalarLookup[color][i]);
+
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// setup runs before every iteration and is not timed
+static BenchmarkResult measure(
+    const char* pOperation,
+    const BenchmarkCase& benchmarkCase,
+    const int width,
+    const int height,
+    const double bytesPerPixel,
+    const int iterations,
+    const std::function<void()>& setup,
+    const std::function<void()>& func)
+{
+    const double pixelCount = static_cast<double>(width) * height;
+
+    std::vector<double> nsPerPixel;
+    nsPerPixel.reserve(iterations);
+
+    for (int i = 0; i < WARM_UP_ITERATION_COUNT + iterations; ++i)
+    {
+        setup();
+
+        const Clock::time_point begin = Clock::now();
+        func();
+        const Clock::time_point end = Clock::now();
+
+        if (i >= WARM_UP_ITERATION_COUNT)
+        {
+            nsPerPixel.push_back(std::chrono::duration<double, std::nano>(end - begin).count() / pixelCount);
+        }
+    }
+
+    std::vector<double> sorted = nsPerPixel;
+    std::sort(sorted.begin(), sorted.end());
+
+    double mean = 0.0;
+    for (const double value : nsPerPixel)
+    {
+        mean += value;
+    }
+    mean /= iterations;
+
+    double variance = 0.0;
+    for (const double value : nsPerPixel)
+    {
+        variance += (value - mean) * (value - mean);
+    }
+    variance /= iterations;
+
+    BenchmarkResult result;
+    result.Operation = pOperation;
+    result.CaseName = benchmarkCase.Name;
+    result.Width = width;
+    result.Height = height;
+    result.Iterations = iterations;
+    result.MedianNsPerPixel = sorted[iterations / 2];
+    result.MeanNsPerPixel = mean;
+    result.StdDevNsPerPixel = sqrt(variance);
+
+    // bytes / ns = GB / s
+    result.GBPerSecond = bytesPerPixel / result.MedianNsPerPixel;
+
+    fprintf(stderr, "%-28s %-10s %6dx%-6d %8.3f ns/px %7.2f GB/s\n", pOperation, benchmarkCase.Name.c_str(), width, height, result.MedianNsPerPixel, result.GBPerSecond);
+
+    return result;
+}
+
+static void runCase(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options, const Histogram& refEqualizedHist, std::vector<BenchmarkResult>& outResults)
+{
+    const int iterations = options.Iterations;
+    auto noSetup = []() {};
+
+    Image source;
+    std::string decodePath = benchmarkCase.Path;
+
+    if (benchmarkCase.Path.empty())
+    {
+        source = Image(benchmarkCase.Width, benchmarkCase.Height, MAX_CHANNEL_COUNT);
+        fillSynthetic(source);
+
+        if (!options.bSkipDecode)
+        {
+            decodePath = "benchmark_" + benchmarkCase.Name + ".png";
+            if (!source.Save(decodePath.c_str()))
+            {
+                decodePath.clear();
+            }
+        }
+    }
+    else
+    {
+        source = Image(benchmarkCase.Path.c_str());
+        if (source.IsEmpty())
+        {
+            fprintf(stderr, "failed to decode %s, skipped\n", benchmarkCase.Path.c_str());
+
+            return;
+        }
+    }
+
+    const int width = source.Width;
+    const int height = source.Height;
+    const int64_t pixelCount = source.GetPixelCount();
+
+    // Image(const char*)
+    if (!options.bSkipDecode && !decodePath.empty())
+    {
+        Image decoded;
+        outResults.push_back(measure("decode", benchmarkCase, width, height, sizeof(Pixel), iterations,
+            [&]() { decoded = Image(); },
+            [&]() { decoded = Image(decodePath.c_str()); }));
+    }
+
+    if (benchmarkCase.Path.empty() && !decodePath.empty())
+    {
+        remove(decodePath.c_str());
+    }
+
+    Image work(source);
+
+    // copy, move
+    {
+        // shares the pixels, the deep copy is deferred to the first write
+        Image copied(source);
+        outResults.push_back(measure("copy_assign", benchmarkCase, width, height, 0, iterations,
+            noSetup,
+            [&]() { copied = source; }));
+
+        outResults.push_back(measure("copy_on_write", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            [&]() { copied = source; },
+            [&]() { copied.GetMutablePixels(); }));
+
+        Image moved;
+        outResults.push_back(measure("move_assign", benchmarkCase, width, height, 0, iterations,
+            [&]() { work = source; },
+            [&]() { moved = std::move(work); }));
+
+        work = source;
+    }
+
+    // GetHistogram, the version bump defeats the cache
+    {
+        Histogram hist;
+        outResults.push_back(measure("get_histogram", benchmarkCase, width, height, sizeof(Pixel), iterations,
+            [&]() { work.GetMutablePixels(); },
+            [&]() { work.GetHistogram(hist); }));
+
+        outResults.push_back(measure("get_histogram_cached", benchmarkCase, width, height, 0, iterations,
+            noSetup,
+            [&]() { work.GetHistogram(hist); }));
+    }
+
+    // in place stages restart from the source every iteration
+    auto restoreWork = [&]()
+        {
+            work = source;
+            work.GetMutablePixels();
+        };
+
+    outResults.push_back(measure("convert_to_gray_scale", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ConvertToGrayScale(work); }));
+
+    outResults.push_back(measure("execute_equalization", benchmarkCase, width, height, 3 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteEqualization(work); }));
+
+    outResults.push_back(measure("execute_clahe", benchmarkCase, width, height, 3 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteClahe(work, false); }));
+
+    // separable filters, rows and column blocks each read and write the image once
+    outResults.push_back(measure("gaussian_blur_sigma2", benchmarkCase, width, height, 4 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteGaussianBlur(work, 2.f); }));
+
+    outResults.push_back(measure("gaussian_blur_sigma20", benchmarkCase, width, height, 4 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteGaussianBlur(work, 20.f); }));
+
+    outResults.push_back(measure("box_blur_radius50", benchmarkCase, width, height, 4 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteBoxBlur(work, 50); }));
+
+    outResults.push_back(measure("unsharp_mask_sigma2", benchmarkCase, width, height, 7 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteUnsharpMask(work, 2.f, 1.f); }));
+
+    // summed area tables, then the mean and variance of a window around every pixel
+    if (pixelCount <= MAX_INTEGRAL_IMAGE_PIXEL_COUNT)
+    {
+        IntegralImage integralImage;
+        outResults.push_back(measure("integral_image_build", benchmarkCase, width, height, sizeof(Pixel) + 6 * sizeof(uint64_t), iterations,
+            noSetup,
+            [&]() { integralImage.Build(source); }));
+
+        double varianceSum = 0.0;
+        outResults.push_back(measure("integral_image_local_statistics_r15", benchmarkCase, width, height, 0, iterations,
+            noSetup,
+            [&]()
+            {
+                const int windowSize = 2 * INTEGRAL_IMAGE_WINDOW_RADIUS + 1;
+
+                IntegralImage::RegionStatistics statistics;
+                for (int y = 0; y < height; ++y)
+                {
+                    for (int x = 0; x < width; ++x)
+                    {
+                        integralImage.GetRegionStatistics(x - INTEGRAL_IMAGE_WINDOW_RADIUS, y - INTEGRAL_IMAGE_WINDOW_RADIUS, windowSize, windowSize, statistics);
+                        varianceSum += statistics.Variances[0];
+                    }
+                }
+            }));
+
+        // keeps the queries from being optimized away
+        if (varianceSum < 0.0)
+        {
+            fprintf(stderr, "negative variance\n");
+        }
+    }
+
+    outResults.push_back(measure("execute_histogram_matching", benchmarkCase, width, height, 3 * sizeof(Pixel), iterations,
+        restoreWork,
+        [&]() { ExecuteHistogramMatching(work, refEqualizedHist); }));
+
+    // brightness, gamma
+    {
+        PixelF normalizedTable[TABLE_SIZE];
+
+        // the kernels are timed on an image sized float buffer, which is what they would cost without the table
+        PixelBufferPool& pool = *PixelBufferPool::GetInstance();
+        PixelF* const pSourcePixels = pool.AcquireArray<PixelF>(pixelCount);
+        PixelF* const pNormalizedPixels = pool.AcquireArray<PixelF>(pixelCount);
+
+        // the pixels of the image to floats, NormalizeTable does the same for the TABLE_SIZE entries that replaced them
+        outResults.push_back(measure("normalize", benchmarkCase, width, height, sizeof(Pixel) + sizeof(PixelF), iterations,
+            noSetup,
+            [&]()
+            {
+                const Pixel* const pPixels = source.GetPixels();
+                for (int64_t i = 0; i < pixelCount; ++i)
+                {
+                    for (int color = 0; color < MAX_CHANNEL_COUNT; ++color)
+                    {
+                        pSourcePixels[i].subPixels[color] = pPixels[i].subPixels[color] * NORMALIZER_F;
+                    }
+                }
+            }));
+
+        // in place, repeated gamma would drift into denormals
+        auto restoreNormalizedPixels = [&]()
+            {
+                memcpy(pNormalizedPixels, pSourcePixels, sizeof(PixelF) * pixelCount);
+            };
+
+        outResults.push_back(measure("modify_brightness_scalar", benchmarkCase, width, height, 2 * sizeof(PixelF), iterations,
+            restoreNormalizedPixels,
+            [&]() { ModifyBrightness(pNormalizedPixels, pixelCount, 0.9f, 2.2f); }));
+
+        outResults.push_back(measure("modify_brightness_simd", benchmarkCase, width, height, 2 * sizeof(PixelF), iterations,
+            restoreNormalizedPixels,
+            [&]() { ModifyBrightnessSIMD(pNormalizedPixels, pixelCount, 0.9f, 2.2f); }));
+
+        pool.Release(pNormalizedPixels);
+        pool.Release(pSourcePixels);
+
+        NormalizeTable(normalizedTable);
+        ModifyBrightness(normalizedTable, TABLE_SIZE, 0.9f, 2.2f);
+
+        Image result(source);
+        outResults.push_back(measure("store_result", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]() { StoreAdjustedImage(source, result, normalizedTable, true); }));
+
+        outResults.push_back(measure("store_result_scalar", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]() { StoreAdjustedImage(source, result, normalizedTable, false); }));
+
+        // planes of the source, split once and kept with its pixels
+        {
+            Image planar(source);
+            outResults.push_back(measure("split_to_planar", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+                [&]() { planar.GetMutablePixels(); },
+                [&]() { planar.GetPlanarView(); }));
+
+            const PlanarImageView planes = planar.GetPlanarView();
+            outResults.push_back(measure("merge_from_planar", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { MergeFromPlanar(planes, result.GetMutableView()); }));
+
+            outResults.push_back(measure("store_result_planar", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { StoreAdjustedImage(planes, result.GetMutableView(), normalizedTable, true); }));
+
+            outResults.push_back(measure("store_result_planar_scalar", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { StoreAdjustedImage(planes, result.GetMutableView(), normalizedTable, false); }));
+
+            Histogram hist;
+            outResults.push_back(measure("gray_histogram", benchmarkCase, width, height, sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ComputeChainHistogram(source.GetView(), true, hist); }));
+
+            outResults.push_back(measure("gray_histogram_planar", benchmarkCase, width, height, sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ComputeChainHistogram(planes, true, hist); }));
+
+            outResults.push_back(measure("histogram_planar", benchmarkCase, width, height, sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ComputeChainHistogram(planes, false, hist); }));
+        }
+
+        // full gray scale -> equalization -> adjustment chain, one pass per stage against strips
+        Image buffered(source);
+        outResults.push_back(measure("chain_staged", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]()
+            {
+                buffered = source;
+                ConvertToGrayScale(buffered);
+                ExecuteEqualization(buffered);
+                StoreAdjustedImage(buffered, result, normalizedTable, true);
+            }));
+
+        outResults.push_back(measure("chain_strips", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]()
+            {
+                Histogram remapTable;
+                BuildEqualizationLookup(remapTable, source, true);
+
+                ProcessingChain chain;
+                chain.bGrayScale = true;
+                chain.bSIMD = true;
+                chain.pRemapTable = &remapTable;
+                chain.pNormalizedTable = normalizedTable;
+                chain.pSrcPlanes = nullptr;
+                chain.pCancellation = nullptr;
+
+                ExecuteChainInStrips(source, &buffered, result, chain);
+            }));
+
+        // the fused chain alone with the remap resolved before, vector against scalar instantiations
+        {
+            Histogram colorRemapTable;
+            BuildEqualizationLookup(colorRemapTable, source, false);
+
+            ProcessingChain chain;
+            chain.bGrayScale = false;
+            chain.bSIMD = true;
+            chain.pRemapTable = &colorRemapTable;
+            chain.pNormalizedTable = normalizedTable;
+            chain.pSrcPlanes = nullptr;
+            chain.pCancellation = nullptr;
+
+            ProcessingChain scalarChain = chain;
+            scalarChain.bSIMD = false;
+
+            outResults.push_back(measure("chain_fused_color", benchmarkCase, width, height, 3 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ExecuteChainInStrips(source, &buffered, result, chain); }));
+
+            outResults.push_back(measure("chain_fused_color_scalar", benchmarkCase, width, height, 3 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ExecuteChainInStrips(source, &buffered, result, scalarChain); }));
+
+            // nothing kept before the adjustment, remap and adjustment are a single lookup
+            outResults.push_back(measure("chain_fused_color_result", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+                noSetup,
+                [&]() { ExecuteChainInStrips(source, nullptr, result, chain); }));
+        }
+
+        // presentation of the result, a repaint without a new result copies nothing
+        MemoryPresentationSink sink;
+        const DirtyRect fullRect = MakeFullDirtyRect(width, height);
+        uint64_t frameVersion = 1;
+
+        sink.Present(result.GetView(), frameVersion, fullRect);
+        outResults.push_back(measure("present_unchanged", benchmarkCase, width, height, 0, iterations,
+            noSetup,
+            [&]() { sink.Present(result.GetView(), frameVersion, fullRect); }));
+
+        outResults.push_back(measure("present_changed", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            [&]() { ++frameVersion; },
+            [&]() { sink.Present(result.GetView(), frameVersion, fullRect); }));
+
+        // adjustment into an image that is presented afterwards against the adjustment written into the sink
+        outResults.push_back(measure("store_result_present", benchmarkCase, width, height, 4 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]()
+            {
+                StoreAdjustedImage(source, result, normalizedTable, true);
+                sink.Present(result.GetView(), ++frameVersion, fullRect);
+            }));
+
+        outResults.push_back(measure("store_result_direct", benchmarkCase, width, height, 2 * sizeof(Pixel), iterations,
+            noSetup,
+            [&]()
+            {
+                MutableImageView frameView;
+                if (sink.BeginFrame(width, height, fullRect, frameView))
+                {
+                    StoreAdjustedImage(source.GetView(), frameView, normalizedTable, true);
+                    sink.EndFrame(++frameVersion);
+                }
+            }));
+
+        const PresentationSink::Statistics& sinkStats = sink.GetStatistics();
+        fprintf(stderr, "present: %llu frames, %llu skipped, %llu written directly, %.1f MB copied per upload\n",
+            static_cast<unsigned long long>(sinkStats.FrameCount),
+            static_cast<unsigned long long>(sinkStats.SkipCount),
+            static_cast<unsigned long long>(sinkStats.DirectCount),
+            sinkStats.CopiedBytes / (1024.0 * 1024.0) / std::max<uint64_t>(1, sinkStats.UploadCount));
+    }
+}
+
+static void writeCSV(FILE* pFile, const std::vector<BenchmarkResult>& results)
+{
+    fprintf(pFile, "operation,case,width,height,iterations,median_ns_per_pixel,mean_ns_per_pixel,stddev_ns_per_pixel,gb_per_s\n");
+    for (const BenchmarkResult& result : results)
+    {
+        fprintf(pFile, "%s,%s,%d,%d,%d,%.6f,%.6f,%.6f,%.4f\n",
+            result.Operation.c_str(), result.CaseName.c_str(), result.Width, result.Height, result.Iterations,
+            result.MedianNsPerPixel, result.MeanNsPerPixel, result.StdDevNsPerPixel, result.GBPerSecond);
+    }
+}
+
+static void writeJSON(FILE* pFile, const std::vector<BenchmarkResult>& results)
+{
+    fprintf(pFile, "[\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        fprintf(pFile,
+            "  { \"operation\": \"%s\", \"case\": \"%s\", \"width\": %d, \"height\": %d, \"iterations\": %d, "
+            "\"median_ns_per_pixel\": %.6f, \"mean_ns_per_pixel\": %.6f, \"stddev_ns_per_pixel\": %.6f, \"gb_per_s\": %.4f }%s\n",
+            result.Operation.c_str(), result.CaseName.c_str(), result.Width, result.Height, result.Iterations,
+            result.MedianNsPerPixel, result.MeanNsPerPixel, result.StdDevNsPerPixel, result.GBPerSecond,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(pFile, "]\n");
+}
+
+static bool readBaseline(const char* pPath, std::vector<BenchmarkResult>& outResults)
+{
+    FILE* pFile = fopen(pPath, "r");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    char line[EBenchmarkConstant::LINE_BUFFER_SIZE];
+
+    // header
+    if (fgets(line, sizeof(line), pFile) == nullptr)
+    {
+        fclose(pFile);
+
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), pFile) != nullptr)
+    {
+        char operation[128];
+        char caseName[128];
+
+        BenchmarkResult result;
+        if (sscanf(line, "%127[^,],%127[^,],%d,%d,%d,%lf,%lf,%lf,%lf",
+            operation, caseName, &result.Width, &result.Height, &result.Iterations,
+            &result.MedianNsPerPixel, &result.MeanNsPerPixel, &result.StdDevNsPerPixel, &result.GBPerSecond) == 9)
+        {
+            result.Operation = operation;
+            result.CaseName = caseName;
+
+            outResults.push_back(result);
+        }
+    }
+
+    fclose(pFile);
+
+    return true;
+}
+
+static void compareWithBaseline(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline)
+{
+    printf("\n%-28s %-10s %14s %14s %9s\n", "operation", "case", "baseline ns/px", "current ns/px", "speedup");
+    for (const BenchmarkResult& result : results)
+    {
+        for (const BenchmarkResult& old : baseline)
+        {
+            if (old.Operation != result.Operation || old.CaseName != result.CaseName)
+            {
+                continue;
+            }
+
+            const double speedup = result.MedianNsPerPixel > 0.0 ? old.MedianNsPerPixel / result.MedianNsPerPixel : 0.0;
+
+            // a change within the noise of either run is not reported as a speedup or a regression
+            const double noise = 2.0 * std::max(old.StdDevNsPerPixel, result.StdDevNsPerPixel);
+            const char* const pVerdict = fabs(old.MedianNsPerPixel - result.MedianNsPerPixel) <= noise ? "~" : (speedup > 1.0 ? "+" : "-");
+
+            printf("%-28s %-10s %14.4f %14.4f %8.2fx %s\n", result.Operation.c_str(), result.CaseName.c_str(), old.MedianNsPerPixel, result.MedianNsPerPixel, speedup, pVerdict);
+            break;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    options.Iterations = DEFAULT_ITERATION_COUNT;
+    options.MaxWidth = 15360;
+    options.bSkipDecode = false;
+    options.bJSON = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const pArg = argv[i];
+        const char* const pValue = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(pArg, "--skip-decode") == 0)
+        {
+            options.bSkipDecode = true;
+        }
+        else if (strcmp(pArg, "--iterations") == 0 && pValue != nullptr && atoi(pValue) > 0)
+        {
+            options.Iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(pArg, "--max-width") == 0 && pValue != nullptr && atoi(pValue) > 0)
+        {
+            options.MaxWidth = atoi(argv[++i]);
+        }
+        else if (strcmp(pArg, "--format") == 0 && pValue != nullptr && (strcmp(pValue, "csv") == 0 || strcmp(pValue, "json") == 0))
+        {
+            options.bJSON = strcmp(argv[++i], "json") == 0;
+        }
+        else if (strcmp(pArg, "--out") == 0 && pValue != nullptr)
+        {
+            options.OutputPath = argv[++i];
+        }
+        else if (strcmp(pArg, "--baseline") == 0 && pValue != nullptr)
+        {
+            options.BaselinePath = argv[++i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the timings of a kernel that is wrong are meaningless
+    if (!checkModifyBrightnessSIMD())
+    {
+        return EXIT_FAILURE;
+    }
+
+    const BenchmarkCase cases[] = {
+        { "lenna", "Lenna.png", 0, 0 },
+        { "1080p", "", 1920, 1080 },
+        { "4k", "", 3840, 2160 },
+        { "8k", "", 7680, 4320 },
+        { "16k", "", 15360, 8640 }
+    };
+
+    // matching reference, same as picking Lenna in the dialog
+    Histogram refEqualizedHist;
+    {
+        Image refImage("Lenna.png");
+        if (refImage.IsEmpty())
+        {
+            refImage = Image(512, 512, MAX_CHANNEL_COUNT);
+            fillSynthetic(refImage);
+        }
+
+        refImage.GetHistogram(refEqualizedHist);
+        EqualizeHistogram(refEqualizedHist, refImage.GetPixelCount());
+    }
+
+    std::vector<BenchmarkResult> results;
+    for (const BenchmarkCase& benchmarkCase : cases)
+    {
+        if (benchmarkCase.Width > options.MaxWidth)
+        {
+            continue;
+        }
+
+        runCase(benchmarkCase, options, refEqualizedHist, results);
+    }
+
+    FILE* pOutput = stdout;
+    if (!options.OutputPath.empty())
+    {
+        pOutput = fopen(options.OutputPath.c_str(), "w");
+        if (pOutput == nullptr)
+        {
+            fprintf(stderr, "failed to open %s\n", options.OutputPath.c_str());
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.bJSON)
+    {
+        writeJSON(pOutput, results);
+    }
+    else
+    {
+        writeCSV(pOutput, results);
+    }
+
+    if (pOutput != stdout)
+    {
+        fclose(pOutput);
+    }
+
+    if (!options.BaselinePath.empty())
+    {
+        std::vector<BenchmarkResult> baseline;
+        if (!readBaseline(options.BaselinePath.c_str(), baseline))
+        {
+            fprintf(stderr, "failed to read baseline %s\n", options.BaselinePath.c_str());
+
+            return EXIT_FAILURE;
+        }
+
+        compareWithBaseline(results, baseline);
+    }
+
+    return EXIT_SUCCESS;
+}
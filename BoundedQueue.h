@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// blocking fifo with a fixed capacity, producers wait while it is full
+template<typename T>
+class BoundedQueue final
+{
+public:
+    BoundedQueue(const int capacity);
+    ~BoundedQueue() = default;
+    BoundedQueue(const BoundedQueue& other) = delete;
+    BoundedQueue(BoundedQueue&& other) = delete;
+    BoundedQueue& operator=(const BoundedQueue& other) = delete;
+    BoundedQueue& operator=(BoundedQueue&& other) = delete;
+
+    // false when the queue has been closed
+    bool Push(T&& item);
+
+    // false when the queue is closed and drained
+    bool Pop(T& outItem);
+
+    void Close();
+
+private:
+    const int mCapacity;
+
+    std::deque<T> mItems;
+    bool mbClosed;
+
+    std::mutex mMutex;
+    std::condition_variable mNotFullCondition;
+    std::condition_variable mNotEmptyCondition;
+};
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(const int capacity)
+    : mCapacity(capacity)
+    , mItems()
+    , mbClosed(false)
+    , mMutex()
+    , mNotFullCondition()
+    , mNotEmptyCondition()
+{
+    assert(capacity > 0);
+}
+
+template<typename T>
+bool BoundedQueue<T>::Push(T&& item)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mNotFullCondition.wait(lock, [this]() { return mbClosed || static_cast<int>(mItems.size()) < mCapacity; });
+    if (mbClosed)
+    {
+        return false;
+    }
+
+    mItems.push_back(std::move(item));
+
+    lock.unlock();
+    mNotEmptyCondition.notify_one();
+
+    return true;
+}
+
+template<typename T>
+bool BoundedQueue<T>::Pop(T& outItem)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mNotEmptyCondition.wait(lock, [this]() { return mbClosed || !mItems.empty(); });
+    if (mItems.empty())
+    {
+        return false;
+    }
+
+    outItem = std::move(mItems.front());
+    mItems.pop_front();
+
+    lock.unlock();
+    mNotFullCondition.notify_one();
+
+    return true;
+}
+
+template<typename T>
+void BoundedQueue<T>::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mbClosed = true;
+    }
+
+    mNotFullCondition.notify_all();
+    mNotEmptyCondition.notify_all();
+}
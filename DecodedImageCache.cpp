@@ -0,0 +1,224 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "DecodedImageCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <climits>
+#include <sys/stat.h>
+#endif
+
+static const char CACHE_MAGIC[8] = { 'I', 'P', 'B', 'G', 'R', 'A', '0', '1' };
+
+// FNV-1a, only used for file names
+static uint64_t hashPath(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : path)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+DecodedImageCache* DecodedImageCache::GetInstance()
+{
+    static DecodedImageCache staticInstance;
+
+    return &staticInstance;
+}
+
+DecodedImageCache::DecodedImageCache()
+    : mDirectory()
+{
+#ifdef _WIN32
+    char tempPath[MAX_PATH];
+    const DWORD length = GetTempPathA(MAX_PATH, tempPath);
+    if (length == 0 || length >= MAX_PATH)
+    {
+        return;
+    }
+
+    mDirectory = std::string(tempPath) + "ImageProcessingPractice\\";
+    CreateDirectoryA(mDirectory.c_str(), nullptr);
+#else
+    const char* pTempPath = getenv("TMPDIR");
+    mDirectory = std::string(pTempPath != nullptr ? pTempPath : "/tmp") + "/ImageProcessingPractice/";
+    mkdir(mDirectory.c_str(), 0700);
+#endif
+}
+
+Image DecodedImageCache::Load(const char* path)
+{
+    assert(path != nullptr);
+
+    Image image;
+    if (TryLoad(path, image))
+    {
+        return image;
+    }
+
+    image = Image(path);
+    if (!image.IsEmpty())
+    {
+        Store(path, image);
+    }
+
+    return image;
+}
+
+bool DecodedImageCache::TryLoad(const char* path, Image& outImage) const
+{
+    assert(path != nullptr);
+
+    SourceStamp stamp;
+    if (mDirectory.empty() || !TryGetSourceStamp(path, stamp))
+    {
+        return false;
+    }
+
+    std::shared_ptr<MappedFile> mappedFile = std::make_shared<MappedFile>();
+    if (!mappedFile->Open(getCachePath(stamp).c_str()) || mappedFile->GetSize() < CACHE_PIXEL_OFFSET)
+    {
+        return false;
+    }
+
+    const uint8_t* const pData = mappedFile->GetData();
+
+    CacheHeader header;
+    memcpy(&header, pData, sizeof(CacheHeader));
+
+    const int64_t pixelCount = static_cast<int64_t>(header.Width) * header.Height;
+    if (memcmp(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header.PixelOffset != CACHE_PIXEL_OFFSET
+        || header.Width <= 0 || header.Height <= 0
+        || header.ChannelCount <= 0 || header.ChannelCount > MAX_CHANNEL_COUNT
+        || header.SourceFileSize != stamp.FileSize
+        || header.SourceModifiedTime != stamp.ModifiedTime
+        || header.SourcePathLength != stamp.FullPath.size()
+        || sizeof(CacheHeader) + header.SourcePathLength > CACHE_PIXEL_OFFSET
+        || memcmp(pData + sizeof(CacheHeader), stamp.FullPath.data(), stamp.FullPath.size()) != 0
+        || mappedFile->GetSize() != CACHE_PIXEL_OFFSET + sizeof(Pixel) * static_cast<uint64_t>(pixelCount))
+    {
+        return false;
+    }
+
+    Image image;
+    image.Width = header.Width;
+    image.Height = header.Height;
+    image.ChannelCount = header.ChannelCount;
+
+    // read only view, GetMutablePixels copies before the first write
+    Pixel* const pPixels = reinterpret_cast<Pixel*>(const_cast<uint8_t*>(pData + CACHE_PIXEL_OFFSET));
+    image.mStorage = std::make_shared<Image::PixelStorage>(pPixels, std::move(mappedFile));
+    image.mpRawPixels = pPixels;
+
+    outImage = std::move(image);
+
+    return true;
+}
+
+bool DecodedImageCache::Store(const char* path, const Image& image) const
+{
+    assert(path != nullptr);
+    assert(!image.IsEmpty());
+
+    SourceStamp stamp;
+    if (mDirectory.empty() || !TryGetSourceStamp(path, stamp)
+        || sizeof(CacheHeader) + stamp.FullPath.size() > CACHE_PIXEL_OFFSET)
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.PixelOffset = CACHE_PIXEL_OFFSET;
+    header.Width = image.Width;
+    header.Height = image.Height;
+    header.ChannelCount = image.ChannelCount;
+    header.SourceFileSize = stamp.FileSize;
+    header.SourceModifiedTime = stamp.ModifiedTime;
+    header.SourcePathLength = static_cast<uint32_t>(stamp.FullPath.size());
+
+    std::vector<uint8_t> headerBlock(CACHE_PIXEL_OFFSET, 0);
+    memcpy(headerBlock.data(), &header, sizeof(CacheHeader));
+    memcpy(headerBlock.data() + sizeof(CacheHeader), stamp.FullPath.data(), stamp.FullPath.size());
+
+    // written aside and renamed so that a reader never maps a partial file
+    const std::string cachePath = getCachePath(stamp);
+    const std::string tempPath = cachePath + ".tmp";
+
+    FILE* pFile = fopen(tempPath.c_str(), "wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    const size_t pixelByteCount = sizeof(Pixel) * static_cast<size_t>(image.GetPixelCount());
+    bool bWritten = fwrite(headerBlock.data(), 1, headerBlock.size(), pFile) == headerBlock.size()
+        && fwrite(image.GetPixels(), 1, pixelByteCount, pFile) == pixelByteCount;
+    bWritten = fclose(pFile) == 0 && bWritten;
+
+    // an old entry that is still mapped can not be replaced on Windows, it is retried on the next miss
+    remove(cachePath.c_str());
+    if (!bWritten || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+
+        return false;
+    }
+
+    return true;
+}
+
+bool DecodedImageCache::TryGetSourceStamp(const char* path, SourceStamp& outStamp)
+{
+#ifdef _WIN32
+    char fullPath[MAX_PATH];
+    if (_fullpath(fullPath, path, MAX_PATH) == nullptr)
+    {
+        return false;
+    }
+
+    // 100ns resolution, stat only has seconds
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(fullPath, GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    outStamp.FullPath = fullPath;
+    outStamp.FileSize = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    outStamp.ModifiedTime = static_cast<int64_t>((static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+#else
+    char fullPath[PATH_MAX];
+    struct stat fileStatus;
+    if (realpath(path, fullPath) == nullptr || stat(fullPath, &fileStatus) != 0)
+    {
+        return false;
+    }
+
+    outStamp.FullPath = fullPath;
+    outStamp.FileSize = static_cast<uint64_t>(fileStatus.st_size);
+    outStamp.ModifiedTime = static_cast<int64_t>(fileStatus.st_mtim.tv_sec) * 1000000000 + fileStatus.st_mtim.tv_nsec;
+#endif
+
+    return true;
+}
+
+std::string DecodedImageCache::getCachePath(const SourceStamp& stamp) const
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.bgra", static_cast<unsigned long long>(hashPath(stamp.FullPath)));
+
+    return mDirectory + fileName;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Image.h"
+
+enum EDecodedImageCacheConstant
+{
+    // pixels start on a page boundary so that the mapped view can be used as Pixel* in place
+    CACHE_PIXEL_OFFSET = 4096
+};
+
+// decoded pixels kept on disk as raw bgra, keyed by source path, size and modification time.
+// a hit maps the file and the image uses the pixels in place, read only until the first GetMutablePixels.
+// repeated loads cost page faults instead of a decode and a channel swizzle
+class DecodedImageCache final
+{
+public:
+    // identity of a source file, a different stamp means different pixels
+    struct SourceStamp
+    {
+        std::string FullPath;
+        uint64_t FileSize;
+        int64_t ModifiedTime;
+    };
+
+public:
+    static DecodedImageCache* GetInstance();
+
+    static bool TryGetSourceStamp(const char* path, SourceStamp& outStamp);
+
+    // hit -> mapped image, miss -> stb decode, then the result is stored for the next load.
+    // empty image when decoding failed, like Image(const char*)
+    Image Load(const char* path);
+
+    bool TryLoad(const char* path, Image& outImage) const;
+    bool Store(const char* path, const Image& image) const;
+
+private:
+    struct CacheHeader
+    {
+        char Magic[8];
+        uint32_t PixelOffset;
+        int32_t Width;
+        int32_t Height;
+        int32_t ChannelCount;
+        uint64_t SourceFileSize;
+        int64_t SourceModifiedTime;
+        uint32_t SourcePathLength;
+        // source path follows, collisions of the file name hash are rejected by comparing it
+    };
+
+private:
+    std::string mDirectory;
+
+private:
+    DecodedImageCache();
+    ~DecodedImageCache() = default;
+    DecodedImageCache(const DecodedImageCache& other) = delete;
+    DecodedImageCache(DecodedImageCache&& other) = delete;
+    DecodedImageCache& operator=(const DecodedImageCache& other) = delete;
+    DecodedImageCache& operator=(DecodedImageCache&& other) = delete;
+
+    std::string getCachePath(const SourceStamp& stamp) const;
+};
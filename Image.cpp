@@ -1,13 +1,38 @@
+#define _CRT_SECURE_NO_WARNINGS
+
 #include "Image.h"
 
+#include <atomic>
+
+#include "TaskScheduler.h"
+#include "PixelBufferPool.h"
+#include "Profiler.h"
+#include "ImageProcessingHelper.h"
+#include "ImageProcessingHelperSIMD.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+enum EImageWriteConstant
+{
+    JPG_QUALITY = 95
+};
+
+// 0 is never issued, it marks an empty cache
+static std::atomic<uint64_t> staticVersionCounter(0);
+
 Image::Image()
-    : pRawPixels(nullptr)
+    : mpRawPixels(nullptr)
     , Width(0)
     , Height(0)
     , ChannelCount(0)
+    , mVersion(issueVersion())
+    , mCachedHistogram()
+    , mCachedHistogramVersion(0)
+    , mStorage()
 {
 }
 
@@ -17,192 +42,339 @@ Image::Image(const char* path)
     assert(path != nullptr);
 
     unsigned char* pData = stbi_load(path, &Width, &Height, &ChannelCount, 0);
-    assert(pData != nullptr);
+    if (pData == nullptr)
+    {
+        Width = 0;
+        Height = 0;
+        ChannelCount = 0;
+
+        return;
+    }
+
     assert(Width > 0);
     assert(Height > 0);
     assert(ChannelCount > 0 && ChannelCount <= MAX_CHANNEL_COUNT);
     {
-        pRawPixels = new Pixel[Width * Height];
+        allocatePixels();
 
-        for (int i = 0; i < Width * Height; ++i)
-        {
-            const int subPixelIndex = i * ChannelCount;
+        const int channelCount = ChannelCount;
+        Pixel* const pPixels = mpRawPixels;
 
-            Pixel pixel;
-            switch (ChannelCount)
+        TaskScheduler::GetInstance()->ParallelFor(0, GetPixelCount(), DEFAULT_GRAIN_PIXEL_COUNT, [pData, pPixels, channelCount](const int64_t begin, const int64_t end)
             {
-            case 1:
-                pixel.rgba.r = pData[subPixelIndex];
-                pixel.rgba.g = pixel.rgba.r;
-                pixel.rgba.b = pixel.rgba.r;
-                pixel.rgba.a = UINT8_MAX;
-                break;
-
-            case 2:
-                pixel.rgba.r = pData[subPixelIndex];
-                pixel.rgba.g = pixel.rgba.r;
-                pixel.rgba.b = pixel.rgba.r;
-                pixel.rgba.a = pData[subPixelIndex + 1];
-                break;
-
-            case 3:
-                pixel.rgba.r = pData[subPixelIndex];
-                pixel.rgba.g = pData[subPixelIndex + 1];
-                pixel.rgba.b = pData[subPixelIndex + 2];
-                pixel.rgba.a = UINT8_MAX;
-                break;
-
-            case 4:
-                pixel.rgba.r = pData[subPixelIndex];
-                pixel.rgba.g = pData[subPixelIndex + 1];
-                pixel.rgba.b = pData[subPixelIndex + 2];
-                pixel.rgba.a = pData[subPixelIndex + 3];
-                break;
-
-            default:
-                assert(false);
-                break;
-            }
-
-            pRawPixels[i] = pixel;
-        }
+                ExpandToBGRA(pData + begin * channelCount, pPixels + begin, end - begin, channelCount);
+            });
     }
     stbi_image_free(pData);
 }
 
+Image::Image(const int width, const int height, const int channelCount)
+    : Image()
+{
+    assert(width > 0);
+    assert(height > 0);
+    assert(channelCount > 0 && channelCount <= MAX_CHANNEL_COUNT);
+
+    Width = width;
+    Height = height;
+    ChannelCount = channelCount;
+
+    allocatePixels();
+}
+
 Image::~Image()
 {
-    delete[] pRawPixels;
+    releasePixels();
 }
 
 Image::Image(const Image& other)
-    : pRawPixels(nullptr)
+    : mpRawPixels(other.mpRawPixels)
     , Width(other.Width)
     , Height(other.Height)
     , ChannelCount(other.ChannelCount)
+    , mVersion(other.mVersion)
+    , mCachedHistogram(other.mCachedHistogram)
+    , mCachedHistogramVersion(other.mCachedHistogramVersion)
+    , mStorage(other.mStorage)
 {
-    assert(other.pRawPixels != nullptr);
+    assert(other.mpRawPixels != nullptr);
     assert(Width > 0);
     assert(Height > 0);
     assert(ChannelCount > 0 && ChannelCount <= MAX_CHANNEL_COUNT);
 
-    pRawPixels = new Pixel[Width * Height];
-
-    memcpy(pRawPixels, other.pRawPixels, sizeof(Pixel) * Width * Height);
+    // the pixels are shared until either side writes
 }
 
-Image::Image(Image&& other)
-    : pRawPixels(other.pRawPixels)
+Image::Image(Image&& other) noexcept
+    : mpRawPixels(other.mpRawPixels)
     , Width(other.Width)
     , Height(other.Height)
     , ChannelCount(other.ChannelCount)
+    , mVersion(other.mVersion)
+    , mCachedHistogram(other.mCachedHistogram)
+    , mCachedHistogramVersion(other.mCachedHistogramVersion)
+    , mStorage(std::move(other.mStorage))
 {
-    assert(other.pRawPixels != nullptr);
-    assert(Width > 0);
-    assert(Height > 0);
-    assert(ChannelCount > 0 && ChannelCount <= MAX_CHANNEL_COUNT);
-
-    other.pRawPixels = nullptr;
+    assert(ChannelCount >= 0 && ChannelCount <= MAX_CHANNEL_COUNT);
+
+    other.mpRawPixels = nullptr;
+    other.Width = 0;
+    other.Height = 0;
+    other.ChannelCount = 0;
+    other.mVersion = issueVersion();
+    other.mCachedHistogramVersion = 0;
 }
 
 Image& Image::operator=(const Image& other)
 {
-    assert(other.pRawPixels != nullptr);
+    assert(other.mpRawPixels != nullptr);
     assert(other.Width > 0);
     assert(other.Height > 0);
     assert(other.ChannelCount > 0 && other.ChannelCount <= MAX_CHANNEL_COUNT);
 
     if (this != &other)
     {
-        if (Width != other.Width || Height != other.Height)
-        {
-            delete[] pRawPixels;
-
-            Width = other.Width;
-            Height = other.Height;
-            ChannelCount = other.ChannelCount;
+        // shares the pixels, the previous ones go back to the pool when this was their last holder
+        mStorage = other.mStorage;
+        mpRawPixels = other.mpRawPixels;
 
-            pRawPixels = new Pixel[Width * Height];
-        }
+        Width = other.Width;
+        Height = other.Height;
+        ChannelCount = other.ChannelCount;
 
-        memcpy(pRawPixels, other.pRawPixels, sizeof(Pixel) * Width * Height);
+        mVersion = other.mVersion;
+        mCachedHistogram = other.mCachedHistogram;
+        mCachedHistogramVersion = other.mCachedHistogramVersion;
     }
 
     return *this;
 }
 
-Image& Image::operator=(Image&& other)
+Image& Image::operator=(Image&& other) noexcept
 {
-    assert(other.pRawPixels != nullptr);
-    assert(other.Width > 0);
-    assert(other.Height > 0);
-    assert(other.ChannelCount > 0 && other.ChannelCount <= MAX_CHANNEL_COUNT);
+    // moving an empty image is allowed, it releases the pixels
+    assert(other.ChannelCount >= 0 && other.ChannelCount <= MAX_CHANNEL_COUNT);
 
     if (this != &other)
     {
-        delete[] pRawPixels;
+        releasePixels();
 
-        pRawPixels = other.pRawPixels;
+        mpRawPixels = other.mpRawPixels;
+        mStorage = std::move(other.mStorage);
         Width = other.Width;
         Height = other.Height;
         ChannelCount = other.ChannelCount;
 
-        other.pRawPixels = nullptr;
+        mVersion = other.mVersion;
+        mCachedHistogram = other.mCachedHistogram;
+        mCachedHistogramVersion = other.mCachedHistogramVersion;
+
+        other.mpRawPixels = nullptr;
+        other.Width = 0;
+        other.Height = 0;
+        other.ChannelCount = 0;
+        other.mVersion = issueVersion();
+        other.mCachedHistogramVersion = 0;
     }
 
     return *this;
 }
 
-struct Args
+bool Image::Save(const char* path) const
 {
-    const Pixel* pPixels;
-    const int width;
-    const int height;
+    assert(path != nullptr);
+    assert(mpRawPixels != nullptr);
 
-    Histogram* pOutHistogram;
-    const int threadId;
-};
+    const char* const pExtension = strrchr(path, '.');
+    if (pExtension == nullptr)
+    {
+        return false;
+    }
 
-DWORD WINAPI getHistogramThread(VOID* const pParam)
-{
-    assert(pParam != nullptr);
+    // gray images are stored with one or two channels
+    const int outChannelCount = ChannelCount;
+    const int64_t pixelCount = GetPixelCount();
 
-    Args* const pArgs = reinterpret_cast<Args*>(pParam);
+    unsigned char* const pData = PixelBufferPool::GetInstance()->AcquireArray<unsigned char>(pixelCount * outChannelCount);
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const Pixel& pixel = mpRawPixels[i];
+        unsigned char* const pOut = pData + i * outChannelCount;
 
-    const int threadId = pArgs->threadId;
-    uint32_t* pOutTable = pArgs->pOutHistogram->frequencyTables[threadId];
+        switch (outChannelCount)
+        {
+        case 1:
+            pOut[0] = pixel.rgba.r;
+            break;
+
+        case 2:
+            pOut[0] = pixel.rgba.r;
+            pOut[1] = pixel.rgba.a;
+            break;
+
+        case 3:
+            pOut[0] = pixel.rgba.r;
+            pOut[1] = pixel.rgba.g;
+            pOut[2] = pixel.rgba.b;
+            break;
+
+        case 4:
+            pOut[0] = pixel.rgba.r;
+            pOut[1] = pixel.rgba.g;
+            pOut[2] = pixel.rgba.b;
+            pOut[3] = pixel.rgba.a;
+            break;
+
+        default:
+            assert(false);
+            break;
+        }
+    }
 
-    const Pixel* pPixels = pArgs->pPixels;
-    const int pixelCount = pArgs->width * pArgs->height;
+    int result = 0;
+    if (strcmp(pExtension, ".png") == 0)
+    {
+        result = stbi_write_png(path, Width, Height, outChannelCount, pData, Width * outChannelCount);
+    }
+    else if (strcmp(pExtension, ".jpg") == 0 || strcmp(pExtension, ".jpeg") == 0)
+    {
+        result = stbi_write_jpg(path, Width, Height, outChannelCount, pData, JPG_QUALITY);
+    }
+    else if (strcmp(pExtension, ".bmp") == 0)
+    {
+        result = stbi_write_bmp(path, Width, Height, outChannelCount, pData);
+    }
+    else if (strcmp(pExtension, ".tga") == 0)
+    {
+        result = stbi_write_tga(path, Width, Height, outChannelCount, pData);
+    }
+
+    PixelBufferPool::GetInstance()->Release(pData);
+
+    return result != 0;
+}
 
-    for (int i = 0; i < pixelCount; ++i)
+void Image::GetHistogram(Histogram& outHistogram) const
+{
+    assert(mpRawPixels != nullptr);
+
+    if (mCachedHistogramVersion == mVersion)
     {
-        ++pOutTable[pPixels[i].subPixels[threadId]];
+        memcpy(&outHistogram, &mCachedHistogram, sizeof(Histogram));
+
+        return;
     }
 
-    return 0;
+    PROFILE_SCOPE("Image::GetHistogram");
+
+    ComputeChainHistogram(GetView(), false, outHistogram);
+
+    memcpy(&mCachedHistogram, &outHistogram, sizeof(Histogram));
+    mCachedHistogramVersion = mVersion;
 }
 
-Histogram Image::GetHistogram() const
+PlanarImageView Image::GetPlanarView() const
 {
-    assert(pRawPixels != nullptr);
+    assert(mpRawPixels != nullptr);
+    assert(mStorage != nullptr);
 
-    Histogram hist = { 0, };
+    PixelStorage& storage = *mStorage;
+    const int64_t stride = ComputePlaneStride(Width);
 
-    Args argArr[COLOR_COUNT] = {
-        { pRawPixels, Width, Height, &hist, 0 },
-        { pRawPixels, Width, Height, &hist, 1 },
-        { pRawPixels, Width, Height, &hist, 2 }
-    };
+    uint8_t* pPlanes = storage.pPlanes.load(std::memory_order_acquire);
+    if (pPlanes == nullptr)
+    {
+        // copies on other threads may ask at the same time, only one of them splits
+        std::lock_guard<std::mutex> lock(storage.PlanesMutex);
 
-    HANDLE threadHandles[COLOR_COUNT];
+        pPlanes = storage.pPlanes.load(std::memory_order_relaxed);
+        if (pPlanes == nullptr)
+        {
+            pPlanes = PixelBufferPool::GetInstance()->AcquireArray<uint8_t>(stride * Height * MAX_CHANNEL_COUNT);
+
+            MutablePlanarImageView planesView;
+            for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
+            {
+                planesView.pPlanes[plane] = pPlanes + plane * stride * Height;
+            }
+            planesView.Width = Width;
+            planesView.Height = Height;
+            planesView.Stride = stride;
+            planesView.ChannelCount = ChannelCount;
+
+            SplitToPlanar(GetView(), planesView);
+
+            storage.pPlanes.store(pPlanes, std::memory_order_release);
+        }
+    }
 
-    for (int i = 0; i < COLOR_COUNT; ++i)
+    PlanarImageView view;
+    for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
     {
-        threadHandles[i] = CreateThread(nullptr, 0, getHistogramThread, argArr + i, 0, 0);
+        view.pPlanes[plane] = pPlanes + plane * stride * Height;
     }
+    view.Width = Width;
+    view.Height = Height;
+    view.Stride = stride;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
 
-    WaitForMultipleObjects(COLOR_COUNT, threadHandles, true, INFINITE);
+Image::PixelStorage::PixelStorage(Pixel* pixels, std::shared_ptr<const MappedFile> mapping)
+    : pPixels(pixels)
+    , Mapping(std::move(mapping))
+    , pPlanes(nullptr)
+    , PlanesMutex()
+{
+    assert(pPixels != nullptr);
+}
 
-    return hist;
+Image::PixelStorage::~PixelStorage()
+{
+    ReleasePlanes();
+
+    if (Mapping == nullptr)
+    {
+        PixelBufferPool::GetInstance()->Release(pPixels);
+    }
+}
+
+void Image::PixelStorage::ReleasePlanes()
+{
+    uint8_t* const pOldPlanes = pPlanes.exchange(nullptr, std::memory_order_relaxed);
+    if (pOldPlanes != nullptr)
+    {
+        PixelBufferPool::GetInstance()->Release(pOldPlanes);
+    }
+}
+
+void Image::allocatePixels()
+{
+    Pixel* const pPixels = PixelBufferPool::GetInstance()->AcquireArray<Pixel>(GetPixelCount());
+
+    mStorage = std::make_shared<PixelStorage>(pPixels, nullptr);
+    mpRawPixels = pPixels;
+}
+
+void Image::releasePixels()
+{
+    mStorage.reset();
+    mpRawPixels = nullptr;
+}
+
+void Image::detachPixels()
+{
+    assert(mStorage != nullptr);
+
+    // the other holders keep the old pixels alive during the copy
+    const std::shared_ptr<PixelStorage> sharedStorage = std::move(mStorage);
+
+    allocatePixels();
+    memcpy(mpRawPixels, sharedStorage->pPixels, sizeof(Pixel) * GetPixelCount());
+}
+
+uint64_t Image::issueVersion()
+{
+    return ++staticVersionCounter;
 }
@@ -3,15 +3,26 @@
 #include <cstdint>
 #include <cassert>
 #include <cstring>
-
-#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 enum EImageConstant
 {
     MAX_CHANNEL_COUNT = 4,
     TABLE_SIZE = UINT8_MAX + 1,
 
-    COLOR_COUNT = 3
+    COLOR_COUNT = 3,
+
+    // every row of a plane starts on a cache line, full vector loads never split a line
+    PLANE_ROW_ALIGNMENT = 64
+};
+
+// interleaved bgra pixels or one plane per channel
+enum EPixelLayout
+{
+    PIXEL_LAYOUT_INTERLEAVED,
+    PIXEL_LAYOUT_PLANAR
 };
 
 // min, max brightness
@@ -67,41 +78,341 @@ union Histogram
     uint32_t frequencyTables[COLOR_COUNT][EImageConstant::TABLE_SIZE];
 };
 
+// non owning rectangle of pixels, rows are Stride pixels apart so that a sub rectangle needs no copy.
+// valid while the image keeps its pixels, a copy on write in GetMutablePixels moves them
+template<typename PixelType>
+struct ImageViewT
+{
+    PixelType* pPixels;
+
+    int Width;
+    int Height;
+    int64_t Stride;
+    int ChannelCount;
+
+    inline PixelType* GetRow(const int y) const;
+    inline int64_t GetPixelCount() const;
+
+    // no gap between the rows, the view can be processed as a single span
+    inline bool IsContiguous() const;
+
+    inline ImageViewT GetSubView(const int x, const int y, const int width, const int height) const;
+
+    // mutable -> read only
+    inline operator ImageViewT<const Pixel>() const;
+};
+
+using ImageView = ImageViewT<const Pixel>;
+using MutableImageView = ImageViewT<Pixel>;
+
+// non owning b, g, r, a planes, a channel of a row is contiguous so that per channel kernels run at full vector width.
+// the rows of every plane are Stride bytes apart
+template<typename ByteType>
+struct PlanarImageViewT
+{
+    ByteType* pPlanes[MAX_CHANNEL_COUNT];
+
+    int Width;
+    int Height;
+    int64_t Stride;
+    int ChannelCount;
+
+    inline ByteType* GetRow(const int plane, const int y) const;
+    inline int64_t GetPixelCount() const;
+
+    inline PlanarImageViewT GetSubView(const int x, const int y, const int width, const int height) const;
+
+    // mutable -> read only
+    inline operator PlanarImageViewT<const uint8_t>() const;
+};
+
+using PlanarImageView = PlanarImageViewT<const uint8_t>;
+using MutablePlanarImageView = PlanarImageViewT<uint8_t>;
+
+// bytes between the rows of a plane
+inline int64_t ComputePlaneStride(const int width)
+{
+    return (static_cast<int64_t>(width) + PLANE_ROW_ALIGNMENT - 1) / PLANE_ROW_ALIGNMENT * PLANE_ROW_ALIGNMENT;
+}
+
 class App;
 class ImageProcessor;
+class DecodedImageCache;
+class MappedFile;
 
 class Image final
 {
     friend App;
     friend ImageProcessor;
+    friend DecodedImageCache;
 
 public:
+    Image();
     Image(const char* path);
+    // uninitialized pixels
+    Image(const int width, const int height, const int channelCount);
     ~Image();
     Image(const Image& other);
-    Image(Image&& other);
+    Image(Image&& other) noexcept;
     Image& operator=(const Image& other);
-    Image& operator=(Image&& other);
+    Image& operator=(Image&& other) noexcept;
 
-    Histogram GetHistogram() const;
+    // pixels are empty when decoding failed
+    inline bool IsEmpty() const;
 
-public:
-    Pixel* pRawPixels;
+    // format is chosen by extension, png, jpg, bmp, tga
+    bool Save(const char* path) const;
+
+    void GetHistogram(Histogram& outHistogram) const;
+
+    // may be shared with copies, do not cast the const away
+    inline const Pixel* GetPixels() const;
+
+    // every writer should go through here so that cached data derived from the pixels gets invalidated.
+    // copies share the pixels, the first write after a copy makes them private
+    inline Pixel* GetMutablePixels();
+    inline uint64_t GetVersion() const;
+
+    // 64 bit, gigapixel images overflow int
+    inline int64_t GetPixelCount() const;
+
+    inline ImageView GetView() const;
+    inline ImageView GetSubView(const int x, const int y, const int width, const int height) const;
+
+    // copy on write and version bump once for the whole image, take sub views from the result
+    inline MutableImageView GetMutableView();
+
+    // planes of the pixels for passes that prefer PIXEL_LAYOUT_PLANAR. split on the first call and kept with the pixels,
+    // so copies that share the pixels share the planes. any write drops them
+    PlanarImageView GetPlanarView() const;
+    inline bool HasPlanes() const;
 
+private:
+    // written through GetMutablePixels only
+    Pixel* mpRawPixels;
+
+public:
     int Width;
     int Height;
     int ChannelCount;
 
 private:
-    Image();
+    // content version, unique across all images so that copies with the same version have the same pixels
+    uint64_t mVersion;
+
+    mutable Histogram mCachedHistogram;
+    mutable uint64_t mCachedHistogramVersion;
+
+    // pixels shared by copies of the image, written only while a single image holds them
+    struct PixelStorage final
+    {
+        Pixel* pPixels;
+
+        // set while pPixels points into a read only cache file, pool buffer otherwise
+        std::shared_ptr<const MappedFile> Mapping;
 
-    inline int convertToIndex(const int x, const int y) const;
+        // pool buffer of MAX_CHANNEL_COUNT planes, nullptr until the first GetPlanarView
+        std::atomic<uint8_t*> pPlanes;
+        std::mutex PlanesMutex;
+
+        PixelStorage(Pixel* pixels, std::shared_ptr<const MappedFile> mapping);
+        ~PixelStorage();
+        PixelStorage(const PixelStorage& other) = delete;
+        PixelStorage(PixelStorage&& other) = delete;
+        PixelStorage& operator=(const PixelStorage& other) = delete;
+        PixelStorage& operator=(PixelStorage&& other) = delete;
+
+        // single holder only, the planes are about to go stale
+        void ReleasePlanes();
+    };
+
+    std::shared_ptr<PixelStorage> mStorage;
+
+private:
+    void allocatePixels();
+    void releasePixels();
+
+    // copy on write of shared or mapped pixels
+    void detachPixels();
+
+    inline int64_t convertToIndex(const int x, const int y) const;
+
+    static uint64_t issueVersion();
 };
 
-inline int Image::convertToIndex(const int x, const int y) const
+inline bool Image::IsEmpty() const
+{
+    return mpRawPixels == nullptr;
+}
+
+inline const Pixel* Image::GetPixels() const
+{
+    return mpRawPixels;
+}
+
+inline Pixel* Image::GetMutablePixels()
+{
+    if (mStorage != nullptr && (mStorage.use_count() > 1 || mStorage->Mapping != nullptr))
+    {
+        detachPixels();
+    }
+    else if (mStorage != nullptr && mStorage->pPlanes.load(std::memory_order_relaxed) != nullptr)
+    {
+        mStorage->ReleasePlanes();
+    }
+
+    mVersion = issueVersion();
+
+    return mpRawPixels;
+}
+
+inline bool Image::HasPlanes() const
+{
+    return mStorage != nullptr && mStorage->pPlanes.load(std::memory_order_acquire) != nullptr;
+}
+
+inline uint64_t Image::GetVersion() const
+{
+    return mVersion;
+}
+
+inline int64_t Image::GetPixelCount() const
+{
+    return static_cast<int64_t>(Width) * Height;
+}
+
+inline ImageView Image::GetView() const
+{
+    ImageView view;
+    view.pPixels = mpRawPixels;
+    view.Width = Width;
+    view.Height = Height;
+    view.Stride = Width;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
+
+inline ImageView Image::GetSubView(const int x, const int y, const int width, const int height) const
+{
+    return GetView().GetSubView(x, y, width, height);
+}
+
+inline MutableImageView Image::GetMutableView()
+{
+    MutableImageView view;
+    view.pPixels = GetMutablePixels();
+    view.Width = Width;
+    view.Height = Height;
+    view.Stride = Width;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
+
+inline int64_t Image::convertToIndex(const int x, const int y) const
 {
     assert(x >= 0);
     assert(y >= 0);
 
-    return y * Width + x;
+    return static_cast<int64_t>(y) * Width + x;
+}
+
+template<typename PixelType>
+inline PixelType* ImageViewT<PixelType>::GetRow(const int y) const
+{
+    assert(y >= 0 && y < Height);
+
+    return pPixels + y * Stride;
+}
+
+template<typename PixelType>
+inline int64_t ImageViewT<PixelType>::GetPixelCount() const
+{
+    return static_cast<int64_t>(Width) * Height;
+}
+
+template<typename PixelType>
+inline bool ImageViewT<PixelType>::IsContiguous() const
+{
+    return Stride == Width || Height <= 1;
+}
+
+template<typename PixelType>
+inline ImageViewT<PixelType> ImageViewT<PixelType>::GetSubView(const int x, const int y, const int width, const int height) const
+{
+    assert(x >= 0 && width > 0 && x + width <= Width);
+    assert(y >= 0 && height > 0 && y + height <= Height);
+
+    ImageViewT view;
+    view.pPixels = pPixels + y * Stride + x;
+    view.Width = width;
+    view.Height = height;
+    view.Stride = Stride;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
+
+template<typename PixelType>
+inline ImageViewT<PixelType>::operator ImageViewT<const Pixel>() const
+{
+    ImageViewT<const Pixel> view;
+    view.pPixels = pPixels;
+    view.Width = Width;
+    view.Height = Height;
+    view.Stride = Stride;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
+
+template<typename ByteType>
+inline ByteType* PlanarImageViewT<ByteType>::GetRow(const int plane, const int y) const
+{
+    assert(plane >= 0 && plane < MAX_CHANNEL_COUNT);
+    assert(y >= 0 && y < Height);
+
+    return pPlanes[plane] + y * Stride;
+}
+
+template<typename ByteType>
+inline int64_t PlanarImageViewT<ByteType>::GetPixelCount() const
+{
+    return static_cast<int64_t>(Width) * Height;
+}
+
+template<typename ByteType>
+inline PlanarImageViewT<ByteType> PlanarImageViewT<ByteType>::GetSubView(const int x, const int y, const int width, const int height) const
+{
+    assert(x >= 0 && width > 0 && x + width <= Width);
+    assert(y >= 0 && height > 0 && y + height <= Height);
+
+    PlanarImageViewT view;
+    for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
+    {
+        view.pPlanes[plane] = pPlanes[plane] + y * Stride + x;
+    }
+    view.Width = width;
+    view.Height = height;
+    view.Stride = Stride;
+    view.ChannelCount = ChannelCount;
+
+    return view;
+}
+
+template<typename ByteType>
+inline PlanarImageViewT<ByteType>::operator PlanarImageViewT<const uint8_t>() const
+{
+    PlanarImageViewT<const uint8_t> view;
+    for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
+    {
+        view.pPlanes[plane] = pPlanes[plane];
+    }
+    view.Width = Width;
+    view.Height = Height;
+    view.Stride = Stride;
+    view.ChannelCount = ChannelCount;
+
+    return view;
 }
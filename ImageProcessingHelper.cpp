@@ -0,0 +1,1384 @@
+#include "ImageProcessingHelper.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "TaskScheduler.h"
+#include "PixelBufferPool.h"
+#include "Profiler.h"
+#include "ImageProcessingHelperSIMD.h"
+
+// span kernels shared by the whole image passes and the strip chain
+
+static void convertToGrayScaleSpan(Pixel* pPixels, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        Pixel& pixel = pPixels[i];
+
+        const uint8_t grayBrightness = ComputeGrayBrightness(pixel);
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            pixel.subPixels[color] = grayBrightness;
+        }
+    }
+}
+
+static void remapSpan(Pixel* pPixels, const int64_t pixelCount, const Histogram& lookupTable)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        Pixel& pixel = pPixels[i];
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            pixel.subPixels[color] = lookupTable.frequencyTables[color][pixel.subPixels[color]];
+        }
+    }
+}
+
+// rows of the view in parallel, about DEFAULT_GRAIN_PIXEL_COUNT pixels per task
+template<typename RowRangeFunc>
+static void parallelForRows(const int width, const int height, const RowRangeFunc& func)
+{
+    const int64_t grainRowCount = std::max<int64_t>(1, DEFAULT_GRAIN_PIXEL_COUNT / std::max(width, 1));
+
+    TaskScheduler::GetInstance()->ParallelFor(0, height, grainRowCount, [&func](const int64_t beginRow, const int64_t endRow)
+        {
+            func(static_cast<int>(beginRow), static_cast<int>(endRow));
+        });
+}
+
+// func(pSrc, pDest, pixelCount) over rows [beginRow, endRow), a single span when neither view has gaps between rows
+template<typename SrcView, typename SpanFunc>
+static void forEachRowSpan(const SrcView& srcView, const MutableImageView& destView, const int beginRow, const int endRow, const SpanFunc& func)
+{
+    assert(srcView.Width == destView.Width);
+
+    if (srcView.IsContiguous() && destView.IsContiguous())
+    {
+        func(srcView.GetRow(beginRow), destView.GetRow(beginRow), static_cast<int64_t>(endRow - beginRow) * srcView.Width);
+
+        return;
+    }
+
+    for (int y = beginRow; y < endRow; ++y)
+    {
+        func(srcView.GetRow(y), destView.GetRow(y), static_cast<int64_t>(srcView.Width));
+    }
+}
+
+// func(pPixels, pixelCount) over rows [beginRow, endRow) of a read only view
+template<typename SpanFunc>
+static void forEachRowSpan(const ImageView& view, const int beginRow, const int endRow, const SpanFunc& func)
+{
+    if (view.IsContiguous())
+    {
+        func(view.GetRow(beginRow), static_cast<int64_t>(endRow - beginRow) * view.Width);
+
+        return;
+    }
+
+    for (int y = beginRow; y < endRow; ++y)
+    {
+        func(view.GetRow(y), static_cast<int64_t>(view.Width));
+    }
+}
+
+// plane lookups of a chain. without buffered pixels the remap is folded into the adjustment, a pixel is looked up once.
+// true when the three colors share the lookups
+static bool buildFusedChainTables(FusedChainTables& outTables, const Histogram* pRemapTable, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bBuffered)
+{
+    uint8_t adjustmentTable[COLOR_COUNT][TABLE_SIZE];
+    BuildAdjustmentLookup(adjustmentTable, normalizedTable);
+
+    uint8_t remapTable[COLOR_COUNT][TABLE_SIZE];
+    uint8_t composedTable[COLOR_COUNT][TABLE_SIZE];
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        for (int i = 0; i < TABLE_SIZE; ++i)
+        {
+            const uint8_t remapped = pRemapTable != nullptr ? static_cast<uint8_t>(pRemapTable->frequencyTables[color][i]) : static_cast<uint8_t>(i);
+
+            remapTable[color][i] = remapped;
+            composedTable[color][i] = bBuffered ? adjustmentTable[color][i] : adjustmentTable[color][remapped];
+        }
+    }
+
+    bool bUniform = true;
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        BuildPlaneLookup(outTables.Lookups[FUSED_LOOKUP_REMAP][color], remapTable[color]);
+        BuildPlaneLookup(outTables.Lookups[FUSED_LOOKUP_ADJUSTMENT][color], composedTable[color]);
+
+        bUniform = bUniform && memcmp(remapTable[color], remapTable[0], TABLE_SIZE) == 0 && memcmp(composedTable[color], composedTable[0], TABLE_SIZE) == 0;
+    }
+
+    return bUniform;
+}
+
+// kernel over rows [beginRow, endRow), a single call when the rows of every view follow each other
+static void executeFusedRows(const FusedChainKernel kernel, const ImageView& srcView, const MutableImageView* pBufferedView, const MutableImageView& resultView, const int beginRow, const int endRow, const FusedChainTables& tables)
+{
+    if (srcView.IsContiguous() && resultView.IsContiguous() && (pBufferedView == nullptr || pBufferedView->IsContiguous()))
+    {
+        kernel(srcView.GetRow(beginRow), pBufferedView != nullptr ? pBufferedView->GetRow(beginRow) : nullptr, resultView.GetRow(beginRow),
+            static_cast<int64_t>(endRow - beginRow) * srcView.Width, tables);
+
+        return;
+    }
+
+    for (int y = beginRow; y < endRow; ++y)
+    {
+        kernel(srcView.GetRow(y), pBufferedView != nullptr ? pBufferedView->GetRow(y) : nullptr, resultView.GetRow(y), static_cast<int64_t>(srcView.Width), tables);
+    }
+}
+
+void ConvertToGrayScale(Image& outImage)
+{
+    if (outImage.ChannelCount <= 2)
+    {
+        return;
+    }
+
+    ConvertToGrayScale(outImage.GetMutableView());
+}
+
+void ConvertToGrayScale(const MutableImageView& outView)
+{
+    PROFILE_SCOPE_BYTES("ConvertToGrayScale", outView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    if (outView.ChannelCount <= 2)
+    {
+        return;
+    }
+
+    parallelForRows(outView.Width, outView.Height, [&outView](const int beginRow, const int endRow)
+        {
+            forEachRowSpan(outView, outView, beginRow, endRow, [](const Pixel*, Pixel* pPixels, const int64_t pixelCount)
+                {
+                    convertToGrayScaleSpan(pPixels, pixelCount);
+                });
+        });
+}
+
+void EqualizeHistogram(Histogram& outHistogram, const int64_t pixelCount)
+{
+    uint64_t frequencyTables[COLOR_COUNT][TABLE_SIZE];
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        for (int i = 0; i < TABLE_SIZE; ++i)
+        {
+            frequencyTables[color][i] = outHistogram.frequencyTables[color][i];
+        }
+    }
+
+    EqualizeFrequencies(outHistogram, frequencyTables, pixelCount);
+}
+
+void EqualizeFrequencies(Histogram& outLookup, const uint64_t frequencyTables[COLOR_COUNT][EImageConstant::TABLE_SIZE], const int64_t pixelCount)
+{
+    assert(pixelCount > 0);
+
+    uint64_t cumulativeSum[COLOR_COUNT] = { 0, };
+    for (int i = 0; i <= MAX_BRIGHTNESS; ++i)
+    {
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            cumulativeSum[color] += frequencyTables[color][i];
+
+            const float newIntensity = roundf(MAX_BRIGHTNESS_F * cumulativeSum[color] / pixelCount);
+
+            outLookup.frequencyTables[color][i] = static_cast<uint8_t>(newIntensity);
+        }
+    }
+}
+
+void RemapImage(Image& outImage, const Histogram& lookupTable)
+{
+    RemapImage(outImage.GetMutableView(), lookupTable);
+}
+
+void RemapImage(const MutableImageView& outView, const Histogram& lookupTable)
+{
+    PROFILE_SCOPE_BYTES("RemapImage", outView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    parallelForRows(outView.Width, outView.Height, [&outView, &lookupTable](const int beginRow, const int endRow)
+        {
+            forEachRowSpan(outView, outView, beginRow, endRow, [&lookupTable](const Pixel*, Pixel* pPixels, const int64_t pixelCount)
+                {
+                    remapSpan(pPixels, pixelCount, lookupTable);
+                });
+        });
+}
+
+void ExecuteEqualization(Image& outImage)
+{
+    Histogram lookupTable;
+    BuildEqualizationLookup(lookupTable, outImage, false);
+
+    RemapImage(outImage, lookupTable);
+}
+
+void BuildInverseLookup(Histogram& outInverseLookup, const Histogram& equalizedHist, const Histogram& refEqualizedHist)
+{
+    for (int i = 0; i <= MAX_BRIGHTNESS; ++i)
+    {
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            int k = MAX_BRIGHTNESS;
+            while (k >= 0 && refEqualizedHist.frequencyTables[color][k] > equalizedHist.frequencyTables[color][i])
+            {
+                --k;
+            }
+
+            if (k < 0)
+            {
+                outInverseLookup.frequencyTables[color][i] = 0;
+            }
+            else
+            {
+                outInverseLookup.frequencyTables[color][i] = k;
+            }
+        }
+    }
+}
+
+void ExecuteHistogramMatching(Image& outImage, const Histogram& refEqualizedHist)
+{
+    Histogram inverseLookup;
+    BuildMatchingLookup(inverseLookup, outImage, false, refEqualizedHist);
+
+    RemapImage(outImage, inverseLookup);
+}
+
+void ComputeChainHistogram(const Image& srcImage, const bool bGrayScale, Histogram& outHistogram)
+{
+    // the plain histogram is cached by the image
+    if (!bGrayScale || srcImage.ChannelCount <= 2)
+    {
+        srcImage.GetHistogram(outHistogram);
+
+        return;
+    }
+
+    // the lumas of the planes are vectorized, cheaper than the interleaved pass even with the split
+    if (HISTOGRAM_PREFERRED_LAYOUT == PIXEL_LAYOUT_PLANAR)
+    {
+        ComputeChainHistogram(srcImage.GetPlanarView(), bGrayScale, outHistogram);
+
+        return;
+    }
+
+    ComputeChainHistogram(srcImage.GetView(), bGrayScale, outHistogram);
+}
+
+// rows of the view in ranges, a few per thread so that stealing can balance them.
+// countRows(beginRow, endRow, pTables) adds to tableCount zeroed tables of the task, a single table is shared by every color
+template<typename CountRowsFunc>
+static void computeHistogramInTasks(const int height, const int tableCount, Histogram& outHistogram, const CountRowsFunc& countRows)
+{
+    TaskScheduler& scheduler = *TaskScheduler::GetInstance();
+
+    const int taskCount = std::min(scheduler.GetThreadCount() * 4, height);
+    const int rowsPerTask = (height + taskCount - 1) / taskCount;
+
+    std::vector<uint32_t> partialTables(static_cast<size_t>(taskCount) * tableCount * TABLE_SIZE, 0);
+
+    scheduler.ParallelFor(0, taskCount, 1, [&](const int64_t beginTask, const int64_t endTask)
+        {
+            for (int64_t taskIndex = beginTask; taskIndex < endTask; ++taskIndex)
+            {
+                const int beginRow = std::min(static_cast<int>(taskIndex) * rowsPerTask, height);
+                const int endRow = std::min(beginRow + rowsPerTask, height);
+                if (beginRow >= endRow)
+                {
+                    continue;
+                }
+
+                countRows(beginRow, endRow, &partialTables[taskIndex * tableCount * TABLE_SIZE]);
+            }
+        });
+
+    // reduction
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        const int table = tableCount == 1 ? 0 : color;
+        for (int i = 0; i < TABLE_SIZE; ++i)
+        {
+            uint32_t frequency = 0;
+            for (int taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+            {
+                frequency += partialTables[(static_cast<size_t>(taskIndex) * tableCount + table) * TABLE_SIZE + i];
+            }
+
+            outHistogram.frequencyTables[color][i] = frequency;
+        }
+    }
+}
+
+void ComputeChainHistogram(const ImageView& srcView, const bool bGrayScale, Histogram& outHistogram)
+{
+    PROFILE_SCOPE_BYTES("ComputeChainHistogram", srcView.GetPixelCount() * sizeof(Pixel));
+
+    // every channel of a gray pixel has the same value, one table per task is enough
+    const bool bGray = bGrayScale && srcView.ChannelCount > 2;
+    const int tableCount = bGray ? 1 : COLOR_COUNT;
+
+    computeHistogramInTasks(srcView.Height, tableCount, outHistogram, [&srcView, bGray](const int beginRow, const int endRow, uint32_t* pTables)
+        {
+            forEachRowSpan(srcView, beginRow, endRow, [pTables, bGray](const Pixel* pPixels, const int64_t pixelCount)
+                {
+                    if (bGray)
+                    {
+                        for (int64_t i = 0; i < pixelCount; ++i)
+                        {
+                            ++pTables[ComputeGrayBrightness(pPixels[i])];
+                        }
+
+                        return;
+                    }
+
+                    uint32_t* const pBlueTable = pTables;
+                    uint32_t* const pGreenTable = pTables + TABLE_SIZE;
+                    uint32_t* const pRedTable = pTables + 2 * TABLE_SIZE;
+                    for (int64_t i = 0; i < pixelCount; ++i)
+                    {
+                        const Pixel pixel = pPixels[i];
+
+                        ++pBlueTable[pixel.rgba.b];
+                        ++pGreenTable[pixel.rgba.g];
+                        ++pRedTable[pixel.rgba.r];
+                    }
+                });
+        });
+}
+
+void BuildEqualizationLookup(Histogram& outLookup, const Image& srcImage, const bool bGrayScale)
+{
+    ComputeChainHistogram(srcImage, bGrayScale, outLookup);
+
+    EqualizeHistogram(outLookup, srcImage.GetPixelCount());
+}
+
+void BuildEqualizationLookup(Histogram& outLookup, const ImageView& srcView, const bool bGrayScale)
+{
+    ComputeChainHistogram(srcView, bGrayScale, outLookup);
+
+    EqualizeHistogram(outLookup, srcView.GetPixelCount());
+}
+
+void BuildMatchingLookup(Histogram& outLookup, const Image& srcImage, const bool bGrayScale, const Histogram& refEqualizedHist)
+{
+    Histogram equalizedHist;
+    BuildEqualizationLookup(equalizedHist, srcImage, bGrayScale);
+
+    BuildInverseLookup(outLookup, equalizedHist, refEqualizedHist);
+}
+
+void BuildMatchingLookup(Histogram& outLookup, const ImageView& srcView, const bool bGrayScale, const Histogram& refEqualizedHist)
+{
+    Histogram equalizedHist;
+    BuildEqualizationLookup(equalizedHist, srcView, bGrayScale);
+
+    BuildInverseLookup(outLookup, equalizedHist, refEqualizedHist);
+}
+
+// tiles of at least one pixel along one axis
+static void computeClaheTiling(const int length, const int tileCount, int& outTileCount, int& outTileLength)
+{
+    const int count = std::max(1, std::min(tileCount, length));
+
+    outTileLength = (length + count - 1) / count;
+    outTileCount = (length + outTileLength - 1) / outTileLength;
+}
+
+// the two tiles whose centers enclose the position and the fixed point weight of the far one, 0 outside the outer centers
+static void computeClaheWeight(const int position, const int tileLength, const int tileCount, int& outNearTile, int& outFarTile, int32_t& outWeight)
+{
+    const float center = (position + 0.5f) / tileLength - 0.5f;
+
+    if (center <= 0.f)
+    {
+        outNearTile = 0;
+        outFarTile = 0;
+        outWeight = 0;
+
+        return;
+    }
+
+    if (center >= static_cast<float>(tileCount - 1))
+    {
+        outNearTile = tileCount - 1;
+        outFarTile = tileCount - 1;
+        outWeight = 0;
+
+        return;
+    }
+
+    outNearTile = static_cast<int>(center);
+    outFarTile = outNearTile + 1;
+    outWeight = static_cast<int32_t>(lroundf((center - outNearTile) * CLAHE_WEIGHT_ONE));
+}
+
+// the excess over the limit is spread evenly, the remainder one bin at a time across the range so that the sum is kept
+static void clipFrequencies(uint32_t frequencyTable[EImageConstant::TABLE_SIZE], const uint32_t limit)
+{
+    uint32_t excess = 0;
+    for (int i = 0; i < TABLE_SIZE; ++i)
+    {
+        if (frequencyTable[i] > limit)
+        {
+            excess += frequencyTable[i] - limit;
+            frequencyTable[i] = limit;
+        }
+    }
+
+    const uint32_t increment = excess / TABLE_SIZE;
+    uint32_t remainder = excess % TABLE_SIZE;
+
+    for (int i = 0; i < TABLE_SIZE; ++i)
+    {
+        frequencyTable[i] += increment;
+    }
+
+    if (remainder > 0)
+    {
+        const int step = std::max(1, static_cast<int>(TABLE_SIZE / remainder));
+        for (int i = 0; i < TABLE_SIZE && remainder > 0; i += step)
+        {
+            ++frequencyTable[i];
+            --remainder;
+        }
+    }
+}
+
+void BuildClaheLookups(ClaheLookups& outLookups, const ImageView& srcView, const bool bGrayScale, const int tileCount, const float clipLimit)
+{
+    PROFILE_SCOPE_BYTES("BuildClaheLookups", srcView.GetPixelCount() * sizeof(Pixel));
+
+    assert(srcView.pPixels != nullptr);
+    assert(tileCount > 0);
+    assert(clipLimit > 0.f);
+
+    computeClaheTiling(srcView.Width, tileCount, outLookups.TileCountX, outLookups.TileWidth);
+    computeClaheTiling(srcView.Height, tileCount, outLookups.TileCountY, outLookups.TileHeight);
+
+    const int tileTotal = outLookups.TileCountX * outLookups.TileCountY;
+    outLookups.TileLookups.resize(tileTotal);
+
+    const bool bGray = bGrayScale && srcView.ChannelCount > 2;
+
+    // a tile is counted by a single task, there are enough tiles to fill the threads
+    TaskScheduler::GetInstance()->ParallelFor(0, tileTotal, 1, [&](const int64_t beginTile, const int64_t endTile)
+        {
+            for (int64_t tile = beginTile; tile < endTile; ++tile)
+            {
+                const int x = static_cast<int>(tile % outLookups.TileCountX) * outLookups.TileWidth;
+                const int y = static_cast<int>(tile / outLookups.TileCountX) * outLookups.TileHeight;
+                const int width = std::min(outLookups.TileWidth, srcView.Width - x);
+                const int height = std::min(outLookups.TileHeight, srcView.Height - y);
+
+                const ImageView tileView = srcView.GetSubView(x, y, width, height);
+
+                Histogram& lookup = outLookups.TileLookups[tile];
+                memset(&lookup, 0, sizeof(Histogram));
+
+                forEachRowSpan(tileView, 0, height, [&lookup, bGray](const Pixel* pPixels, const int64_t pixelCount)
+                    {
+                        if (bGray)
+                        {
+                            for (int64_t i = 0; i < pixelCount; ++i)
+                            {
+                                ++lookup.frequencyTables[0][ComputeGrayBrightness(pPixels[i])];
+                            }
+
+                            return;
+                        }
+
+                        for (int64_t i = 0; i < pixelCount; ++i)
+                        {
+                            for (int color = 0; color < COLOR_COUNT; ++color)
+                            {
+                                ++lookup.frequencyTables[color][pPixels[i].subPixels[color]];
+                            }
+                        }
+                    });
+
+                if (bGray)
+                {
+                    memcpy(lookup.frequencyTables[1], lookup.frequencyTables[0], sizeof(lookup.frequencyTables[0]));
+                    memcpy(lookup.frequencyTables[2], lookup.frequencyTables[0], sizeof(lookup.frequencyTables[0]));
+                }
+
+                const int64_t pixelCount = tileView.GetPixelCount();
+                const uint32_t limit = std::max<uint32_t>(1, static_cast<uint32_t>(clipLimit * pixelCount / TABLE_SIZE));
+
+                for (int color = 0; color < COLOR_COUNT; ++color)
+                {
+                    clipFrequencies(lookup.frequencyTables[color], limit);
+                }
+
+                EqualizeHistogram(lookup, pixelCount);
+            }
+        });
+}
+
+void ApplyClaheLookups(const ImageView& srcView, const MutableImageView& outView, const bool bGrayScale, const ClaheLookups& lookups)
+{
+    PROFILE_SCOPE_BYTES("ApplyClaheLookups", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width && srcView.Height == outView.Height);
+    assert(static_cast<int>(lookups.TileLookups.size()) == lookups.TileCountX * lookups.TileCountY);
+
+    const bool bGray = bGrayScale && srcView.ChannelCount > 2;
+    const int tableCount = bGray ? 1 : COLOR_COUNT;
+    const int tileCountX = lookups.TileCountX;
+
+    // runs of columns between the same two tile centers, shared by every row
+    struct ColumnRun
+    {
+        int BeginX;
+        int EndX;
+        int LeftTile;
+        int RightTile;
+    };
+
+    std::vector<int32_t> columnWeights(srcView.Width);
+    std::vector<ColumnRun> columnRuns;
+
+    for (int x = 0; x < srcView.Width; ++x)
+    {
+        int leftTile;
+        int rightTile;
+        computeClaheWeight(x, lookups.TileWidth, tileCountX, leftTile, rightTile, columnWeights[x]);
+
+        if (columnRuns.empty() || columnRuns.back().LeftTile != leftTile || columnRuns.back().RightTile != rightTile)
+        {
+            columnRuns.push_back({ x, x + 1, leftTile, rightTile });
+        }
+        else
+        {
+            columnRuns.back().EndX = x + 1;
+        }
+    }
+
+    const int blendedStride = COLOR_COUNT * TABLE_SIZE;
+
+    parallelForRows(srcView.Width, srcView.Height, [&](const int beginRow, const int endRow)
+        {
+            // lookups of every tile column blended between the tile rows above and below, once per row
+            std::vector<uint32_t> blendedTables(static_cast<size_t>(tileCountX) * blendedStride);
+
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                int topTile;
+                int bottomTile;
+                int32_t bottomWeight;
+                computeClaheWeight(y, lookups.TileHeight, lookups.TileCountY, topTile, bottomTile, bottomWeight);
+
+                for (int tileX = 0; tileX < tileCountX; ++tileX)
+                {
+                    const Histogram& topLookup = lookups.TileLookups[topTile * tileCountX + tileX];
+                    const Histogram& bottomLookup = lookups.TileLookups[bottomTile * tileCountX + tileX];
+                    uint32_t* const pBlended = &blendedTables[tileX * blendedStride];
+
+                    for (int color = 0; color < tableCount; ++color)
+                    {
+                        for (int i = 0; i < TABLE_SIZE; ++i)
+                        {
+                            pBlended[color * TABLE_SIZE + i] = topLookup.frequencyTables[color][i] * (CLAHE_WEIGHT_ONE - bottomWeight)
+                                + bottomLookup.frequencyTables[color][i] * bottomWeight;
+                        }
+                    }
+                }
+
+                const Pixel* const pSrcRow = srcView.GetRow(y);
+                Pixel* const pDestRow = outView.GetRow(y);
+
+                for (const ColumnRun& run : columnRuns)
+                {
+                    InterpolateTileLookupsSIMD(pSrcRow + run.BeginX, pDestRow + run.BeginX, run.EndX - run.BeginX,
+                        &blendedTables[run.LeftTile * blendedStride], &blendedTables[run.RightTile * blendedStride], &columnWeights[run.BeginX], bGray);
+                }
+            }
+        });
+}
+
+void ExecuteClahe(Image& outImage, const bool bGrayScale)
+{
+    ClaheLookups lookups;
+    BuildClaheLookups(lookups, outImage.GetView(), bGrayScale, DEFAULT_CLAHE_TILE_COUNT, DEFAULT_CLAHE_CLIP_LIMIT_F);
+
+    const MutableImageView view = outImage.GetMutableView();
+    ApplyClaheLookups(view, view, bGrayScale, lookups);
+}
+
+// one 1d pass of a separable filter, the same along the rows and the columns
+struct FilterPass
+{
+    int Radius;
+
+    // 2 * Radius + 1 weights, nullptr for a box
+    const float* pWeights;
+};
+
+static MutableImageView makeBlockView(Pixel* pPixels, const int width, const int height, const int channelCount)
+{
+    MutableImageView view;
+    view.pPixels = pPixels;
+    view.Width = width;
+    view.Height = height;
+    view.Stride = width;
+    view.ChannelCount = channelCount;
+
+    return view;
+}
+
+// radius pixels before and after the row repeat its border pixels
+static void padRow(Pixel* pRow, const int width, const int radius)
+{
+    std::fill(pRow - radius, pRow, pRow[0]);
+    std::fill(pRow + width, pRow + width + radius, pRow[width - 1]);
+}
+
+static void copyView(const ImageView& srcView, const MutableImageView& outView)
+{
+    if (srcView.pPixels == outView.pPixels)
+    {
+        return;
+    }
+
+    parallelForRows(srcView.Width, srcView.Height, [&srcView, &outView](const int beginRow, const int endRow)
+        {
+            forEachRowSpan(srcView, outView, beginRow, endRow, [](const Pixel* pSrc, Pixel* pDest, const int64_t pixelCount)
+                {
+                    std::copy(pSrc, pSrc + pixelCount, pDest);
+                });
+        });
+}
+
+static void executeSeparablePasses(const ImageView& srcView, const MutableImageView& outView, const FilterPass* pPasses, const int passCount)
+{
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+    assert(passCount > 0);
+
+    const int width = srcView.Width;
+    const int height = srcView.Height;
+
+    int maxRadius = 0;
+    int maxWeightedRadius = 0;
+    for (int i = 0; i < passCount; ++i)
+    {
+        maxRadius = std::max(maxRadius, pPasses[i].Radius);
+
+        if (pPasses[i].pWeights != nullptr)
+        {
+            maxWeightedRadius = std::max(maxWeightedRadius, pPasses[i].Radius);
+        }
+    }
+
+    // rows, the passes alternate between two padded copies of the row and the last one writes the destination
+    parallelForRows(width, height, [&](const int beginRow, const int endRow)
+        {
+            const int paddedWidth = width + 2 * maxRadius;
+
+            std::vector<Pixel> rowBuffers[2] = { std::vector<Pixel>(paddedWidth), std::vector<Pixel>(paddedWidth) };
+            std::vector<PixelF> scratch(maxWeightedRadius > 0 ? paddedWidth : 0);
+
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                Pixel* pRow = rowBuffers[0].data() + maxRadius;
+                std::copy(srcView.GetRow(y), srcView.GetRow(y) + width, pRow);
+
+                for (int i = 0; i < passCount; ++i)
+                {
+                    const FilterPass& pass = pPasses[i];
+                    padRow(pRow, width, pass.Radius);
+
+                    Pixel* const pDest = i + 1 == passCount ? outView.GetRow(y) : rowBuffers[(i + 1) % 2].data() + maxRadius;
+                    if (pass.pWeights == nullptr)
+                    {
+                        BoxFilterRowSIMD(pRow - pass.Radius, pDest, width, pass.Radius);
+                    }
+                    else
+                    {
+                        ConvolveRowSIMD(pRow - pass.Radius, pDest, width, pass.pWeights, pass.Radius, scratch.data());
+                    }
+
+                    pRow = pDest;
+                }
+            }
+        });
+
+    // columns, a block of whole columns goes through every pass in L2 before the next block is read
+    const int blockWidthStep = MIN_FILTER_COLUMN_BLOCK_WIDTH;
+    const int64_t blockColumnBytes = static_cast<int64_t>(height) * sizeof(Pixel);
+    const int blockWidth = std::min(width, std::max(blockWidthStep, static_cast<int>(FILTER_COLUMN_BLOCK_BYTES / blockColumnBytes) / blockWidthStep * blockWidthStep));
+    const int blockCount = (width + blockWidth - 1) / blockWidth;
+
+    TaskScheduler::GetInstance()->ParallelFor(0, blockCount, 1, [&](const int64_t beginBlock, const int64_t endBlock)
+        {
+            const int64_t blockPixelCount = static_cast<int64_t>(blockWidth) * height;
+
+            // every range is a block or a few, pooled buffers skip the allocation and the zeroing of a vector
+            PixelBufferPool& pool = *PixelBufferPool::GetInstance();
+            Pixel* const blockBuffers[2] = { pool.AcquireArray<Pixel>(blockPixelCount), pool.AcquireArray<Pixel>(blockPixelCount) };
+            std::vector<const Pixel*> paddedRows(height + 2 * maxRadius);
+            std::vector<uint32_t> sums(blockWidth * MAX_CHANNEL_COUNT);
+            std::vector<PixelF> scratch(maxWeightedRadius > 0 ? (2 * maxWeightedRadius + 1) * blockWidth : 0);
+
+            for (int64_t block = beginBlock; block < endBlock; ++block)
+            {
+                const int x = static_cast<int>(block) * blockWidth;
+                const int currentWidth = std::min(blockWidth, width - x);
+
+                const MutableImageView destView = outView.GetSubView(x, 0, currentWidth, height);
+
+                // the rows of the destination are overwritten by the last pass, the block is read out first
+                MutableImageView blockView = makeBlockView(blockBuffers[0], currentWidth, height, outView.ChannelCount);
+                for (int y = 0; y < height; ++y)
+                {
+                    std::copy(destView.GetRow(y), destView.GetRow(y) + currentWidth, blockView.GetRow(y));
+                }
+
+                for (int i = 0; i < passCount; ++i)
+                {
+                    const FilterPass& pass = pPasses[i];
+                    for (int k = 0; k < height + 2 * pass.Radius; ++k)
+                    {
+                        paddedRows[k] = blockView.GetRow(Clamp(k - pass.Radius, 0, height - 1));
+                    }
+
+                    const MutableImageView passView = i + 1 == passCount ? destView : makeBlockView(blockBuffers[(i + 1) % 2], currentWidth, height, outView.ChannelCount);
+                    if (pass.pWeights == nullptr)
+                    {
+                        BoxFilterColumnsSIMD(paddedRows.data(), passView, pass.Radius, sums.data());
+                    }
+                    else
+                    {
+                        ConvolveColumnsSIMD(paddedRows.data(), passView, pass.pWeights, pass.Radius, scratch.data());
+                    }
+
+                    blockView = passView;
+                }
+            }
+
+            pool.Release(blockBuffers[1]);
+            pool.Release(blockBuffers[0]);
+        });
+}
+
+// sampled gaussian of radius ceil(3 sigma), normalized
+static void buildGaussianKernel(std::vector<float>& outWeights, const float sigma)
+{
+    const int radius = std::min(static_cast<int>(std::ceil(3.f * sigma)), static_cast<int>(MAX_FILTER_RADIUS));
+
+    outWeights.resize(2 * radius + 1);
+
+    float weightSum = 0.f;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        const float weight = std::exp(-0.5f * i * i / (sigma * sigma));
+
+        outWeights[i + radius] = weight;
+        weightSum += weight;
+    }
+
+    for (float& weight : outWeights)
+    {
+        weight /= weightSum;
+    }
+}
+
+// widths of GAUSSIAN_BOX_PASS_COUNT boxes whose variances (w^2 - 1) / 12 add up to sigma^2, Kovesi's boxes for gauss
+static void buildGaussianBoxRadii(int outRadii[GAUSSIAN_BOX_PASS_COUNT], const float sigma)
+{
+    const int passCount = GAUSSIAN_BOX_PASS_COUNT;
+    const float variance = sigma * sigma;
+
+    int lowerWidth = static_cast<int>(std::floor(std::sqrt(12.f * variance / passCount + 1.f)));
+    if (lowerWidth % 2 == 0)
+    {
+        --lowerWidth;
+    }
+
+    const int upperWidth = lowerWidth + 2;
+
+    // passes with the lower width, the rest take the upper one
+    const float idealLowerCount = (12.f * variance - passCount * lowerWidth * lowerWidth - 4.f * passCount * lowerWidth - 3.f * passCount) / (-4.f * lowerWidth - 4.f);
+    const int lowerCount = static_cast<int>(std::round(idealLowerCount));
+
+    for (int i = 0; i < passCount; ++i)
+    {
+        const int boxWidth = i < lowerCount ? lowerWidth : upperWidth;
+
+        outRadii[i] = std::min((boxWidth - 1) / 2, static_cast<int>(MAX_FILTER_RADIUS));
+    }
+}
+
+void ExecuteBoxBlur(const ImageView& srcView, const MutableImageView& outView, const int radius)
+{
+    PROFILE_SCOPE_BYTES("ExecuteBoxBlur", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(radius >= 0);
+
+    if (radius == 0)
+    {
+        copyView(srcView, outView);
+
+        return;
+    }
+
+    const FilterPass pass = { std::min(radius, static_cast<int>(MAX_FILTER_RADIUS)), nullptr };
+    executeSeparablePasses(srcView, outView, &pass, 1);
+}
+
+void ExecuteBoxBlur(Image& outImage, const int radius)
+{
+    const MutableImageView view = outImage.GetMutableView();
+    ExecuteBoxBlur(view, view, radius);
+}
+
+void ExecuteGaussianBlur(const ImageView& srcView, const MutableImageView& outView, const float sigma)
+{
+    PROFILE_SCOPE_BYTES("ExecuteGaussianBlur", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(sigma >= 0.f);
+
+    if (sigma <= 0.f)
+    {
+        copyView(srcView, outView);
+
+        return;
+    }
+
+    if (sigma <= MAX_EXACT_GAUSSIAN_SIGMA_F)
+    {
+        std::vector<float> weights;
+        buildGaussianKernel(weights, sigma);
+
+        const FilterPass pass = { static_cast<int>(weights.size()) / 2, weights.data() };
+        executeSeparablePasses(srcView, outView, &pass, 1);
+
+        return;
+    }
+
+    int radii[GAUSSIAN_BOX_PASS_COUNT];
+    buildGaussianBoxRadii(radii, sigma);
+
+    FilterPass passes[GAUSSIAN_BOX_PASS_COUNT];
+    for (int i = 0; i < GAUSSIAN_BOX_PASS_COUNT; ++i)
+    {
+        passes[i].Radius = radii[i];
+        passes[i].pWeights = nullptr;
+    }
+
+    executeSeparablePasses(srcView, outView, passes, GAUSSIAN_BOX_PASS_COUNT);
+}
+
+void ExecuteGaussianBlur(Image& outImage, const float sigma)
+{
+    const MutableImageView view = outImage.GetMutableView();
+    ExecuteGaussianBlur(view, view, sigma);
+}
+
+void ExecuteUnsharpMask(const ImageView& srcView, const MutableImageView& outView, const float sigma, const float amount)
+{
+    PROFILE_SCOPE_BYTES("ExecuteUnsharpMask", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+
+    Image blurredImage(srcView.Width, srcView.Height, srcView.ChannelCount);
+    const MutableImageView blurredView = blurredImage.GetMutableView();
+
+    ExecuteGaussianBlur(srcView, blurredView, sigma);
+
+    parallelForRows(srcView.Width, srcView.Height, [&srcView, &outView, &blurredView, amount](const int beginRow, const int endRow)
+        {
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                SharpenSIMD(srcView.GetRow(y), blurredView.GetRow(y), outView.GetRow(y), srcView.Width, amount);
+            }
+        });
+}
+
+void ExecuteUnsharpMask(Image& outImage, const float sigma, const float amount)
+{
+    const MutableImageView view = outImage.GetMutableView();
+    ExecuteUnsharpMask(view, view, sigma, amount);
+}
+
+void DownsampleByHalf(const ImageView& srcView, Image& outImage)
+{
+    PROFILE_SCOPE_BYTES("DownsampleByHalf", srcView.GetPixelCount() * sizeof(Pixel) * 5 / 4);
+
+    assert(srcView.Width > 1 || srcView.Height > 1);
+
+    const int width = std::max(1, srcView.Width / 2);
+    const int height = std::max(1, srcView.Height / 2);
+
+    if (outImage.Width != width || outImage.Height != height || outImage.IsEmpty())
+    {
+        outImage = Image(width, height, srcView.ChannelCount);
+    }
+    outImage.ChannelCount = srcView.ChannelCount;
+
+    const MutableImageView destView = outImage.GetMutableView();
+
+    parallelForRows(width, height, [&srcView, &destView](const int beginRow, const int endRow)
+        {
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                const Pixel* const pTop = srcView.GetRow(std::min(y * 2, srcView.Height - 1));
+                const Pixel* const pBottom = srcView.GetRow(std::min(y * 2 + 1, srcView.Height - 1));
+                Pixel* const pDest = destView.GetRow(y);
+
+                for (int x = 0; x < destView.Width; ++x)
+                {
+                    const int left = std::min(x * 2, srcView.Width - 1);
+                    const int right = std::min(x * 2 + 1, srcView.Width - 1);
+
+                    for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+                    {
+                        const int sum = pTop[left].subPixels[channel] + pTop[right].subPixels[channel]
+                            + pBottom[left].subPixels[channel] + pBottom[right].subPixels[channel];
+
+                        pDest[x].subPixels[channel] = static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+        });
+}
+
+// planar passes
+
+enum EPlanarConstant
+{
+    // interleaved tables of one plane, a run of equal bytes would otherwise wait on its own increments
+    PLANE_COUNT_TABLE_COUNT = 4,
+
+    // gray lumas converted at a time
+    GRAY_SPAN_PIXEL_COUNT = 1024
+};
+
+static void countBytes(const uint8_t* pBytes, const int64_t count, uint32_t countTables[PLANE_COUNT_TABLE_COUNT][TABLE_SIZE])
+{
+    int64_t i = 0;
+    for (; i + PLANE_COUNT_TABLE_COUNT <= count; i += PLANE_COUNT_TABLE_COUNT)
+    {
+        ++countTables[0][pBytes[i]];
+        ++countTables[1][pBytes[i + 1]];
+        ++countTables[2][pBytes[i + 2]];
+        ++countTables[3][pBytes[i + 3]];
+    }
+
+    for (; i < count; ++i)
+    {
+        ++countTables[0][pBytes[i]];
+    }
+}
+
+static void addCountTables(uint32_t* pTable, const uint32_t countTables[PLANE_COUNT_TABLE_COUNT][TABLE_SIZE])
+{
+    for (int i = 0; i < TABLE_SIZE; ++i)
+    {
+        pTable[i] += countTables[0][i] + countTables[1][i] + countTables[2][i] + countTables[3][i];
+    }
+}
+
+void SplitToPlanar(const ImageView& srcView, const MutablePlanarImageView& outView)
+{
+    PROFILE_SCOPE_BYTES("SplitToPlanar", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+
+    parallelForRows(srcView.Width, srcView.Height, [&](const int beginRow, const int endRow)
+        {
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                uint8_t* const pPlaneRows[MAX_CHANNEL_COUNT] = { outView.GetRow(0, y), outView.GetRow(1, y), outView.GetRow(2, y), outView.GetRow(3, y) };
+
+                SplitToPlanesSIMD(srcView.GetRow(y), pPlaneRows, srcView.Width);
+            }
+        });
+}
+
+void MergeFromPlanar(const PlanarImageView& srcView, const MutableImageView& outView)
+{
+    PROFILE_SCOPE_BYTES("MergeFromPlanar", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+
+    parallelForRows(srcView.Width, srcView.Height, [&](const int beginRow, const int endRow)
+        {
+            for (int y = beginRow; y < endRow; ++y)
+            {
+                const uint8_t* const pPlaneRows[MAX_CHANNEL_COUNT] = { srcView.GetRow(0, y), srcView.GetRow(1, y), srcView.GetRow(2, y), srcView.GetRow(3, y) };
+
+                MergeFromPlanesSIMD(pPlaneRows, outView.GetRow(y), srcView.Width);
+            }
+        });
+}
+
+void ComputeChainHistogram(const PlanarImageView& srcView, const bool bGrayScale, Histogram& outHistogram)
+{
+    PROFILE_SCOPE_BYTES("ComputeChainHistogram planar", srcView.GetPixelCount() * (bGrayScale ? COLOR_COUNT : MAX_CHANNEL_COUNT));
+
+    const bool bGray = bGrayScale && srcView.ChannelCount > 2;
+    const int tableCount = bGray ? 1 : COLOR_COUNT;
+
+    computeHistogramInTasks(srcView.Height, tableCount, outHistogram, [&srcView, bGray](const int beginRow, const int endRow, uint32_t* pTables)
+        {
+            uint32_t countTables[PLANE_COUNT_TABLE_COUNT][TABLE_SIZE];
+
+            if (bGray)
+            {
+                memset(countTables, 0, sizeof(countTables));
+
+                uint8_t grays[GRAY_SPAN_PIXEL_COUNT];
+                for (int y = beginRow; y < endRow; ++y)
+                {
+                    for (int x = 0; x < srcView.Width; x += GRAY_SPAN_PIXEL_COUNT)
+                    {
+                        const int count = std::min(static_cast<int>(GRAY_SPAN_PIXEL_COUNT), srcView.Width - x);
+                        const uint8_t* const pPlaneRows[MAX_CHANNEL_COUNT] = { srcView.GetRow(0, y) + x, srcView.GetRow(1, y) + x, srcView.GetRow(2, y) + x, srcView.GetRow(3, y) + x };
+
+                        ComputeGrayPlaneSIMD(pPlaneRows, grays, count);
+                        countBytes(grays, count, countTables);
+                    }
+                }
+
+                addCountTables(pTables, countTables);
+
+                return;
+            }
+
+            // one plane after the other, each is a stream of its own
+            for (int color = 0; color < COLOR_COUNT; ++color)
+            {
+                memset(countTables, 0, sizeof(countTables));
+
+                for (int y = beginRow; y < endRow; ++y)
+                {
+                    countBytes(srcView.GetRow(color, y), srcView.Width, countTables);
+                }
+
+                addCountTables(pTables + color * TABLE_SIZE, countTables);
+            }
+        });
+}
+
+void BuildEqualizationLookup(Histogram& outLookup, const PlanarImageView& srcView, const bool bGrayScale)
+{
+    ComputeChainHistogram(srcView, bGrayScale, outLookup);
+
+    EqualizeHistogram(outLookup, srcView.GetPixelCount());
+}
+
+void BuildMatchingLookup(Histogram& outLookup, const PlanarImageView& srcView, const bool bGrayScale, const Histogram& refEqualizedHist)
+{
+    Histogram equalizedHist;
+    BuildEqualizationLookup(equalizedHist, srcView, bGrayScale);
+
+    BuildInverseLookup(outLookup, equalizedHist, refEqualizedHist);
+}
+
+static void buildPlaneLookups(PlaneLookup outLookups[COLOR_COUNT], const PixelF normalizedTable[EImageConstant::TABLE_SIZE])
+{
+    uint8_t lookupTable[COLOR_COUNT][TABLE_SIZE];
+    BuildAdjustmentLookup(lookupTable, normalizedTable);
+
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        BuildPlaneLookup(outLookups[color], lookupTable[color]);
+    }
+}
+
+// rows [beginRow, endRow) of the planes, adjusted and interleaved
+static void storeAdjustedPlanarRows(const PlanarImageView& srcView, const MutableImageView& outView, const int beginRow, const int endRow, const PlaneLookup lookups[COLOR_COUNT], const bool bSIMD)
+{
+    for (int y = beginRow; y < endRow; ++y)
+    {
+        const uint8_t* const pPlaneRows[MAX_CHANNEL_COUNT] = { srcView.GetRow(0, y), srcView.GetRow(1, y), srcView.GetRow(2, y), srcView.GetRow(3, y) };
+
+        if (bSIMD)
+        {
+            StoreLookedUpPlanesSIMD(pPlaneRows, outView.GetRow(y), srcView.Width, lookups);
+
+            continue;
+        }
+
+        Pixel* const pDest = outView.GetRow(y);
+        for (int x = 0; x < srcView.Width; ++x)
+        {
+            Pixel pixel;
+            pixel.rgba.b = lookups[0].Table[pPlaneRows[0][x]];
+            pixel.rgba.g = lookups[1].Table[pPlaneRows[1][x]];
+            pixel.rgba.r = lookups[2].Table[pPlaneRows[2][x]];
+            pixel.rgba.a = pPlaneRows[3][x];
+
+            pDest[x] = pixel;
+        }
+    }
+}
+
+void StoreAdjustedImage(const PlanarImageView& srcView, const MutableImageView& outView, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD)
+{
+    PROFILE_SCOPE_BYTES("StoreAdjustedImage planar", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+
+    PlaneLookup lookups[COLOR_COUNT];
+    buildPlaneLookups(lookups, normalizedTable);
+
+    parallelForRows(srcView.Width, srcView.Height, [&](const int beginRow, const int endRow)
+        {
+            storeAdjustedPlanarRows(srcView, outView, beginRow, endRow, lookups, bSIMD);
+        });
+}
+
+void NormalizeTable(PixelF outTable[EImageConstant::TABLE_SIZE])
+{
+    for (int i = 0; i < TABLE_SIZE; ++i)
+    {
+        PixelF& normalizedPixel = outTable[i];
+        for (int color = 0; color < MAX_CHANNEL_COUNT; ++color)
+        {
+            normalizedPixel.subPixels[color] = i * NORMALIZER_F;
+        }
+    }
+}
+
+void ModifyBrightness(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler)
+{
+    assert(pPixels != nullptr);
+
+    // scalar reference
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        PixelF& pixel = pPixels[i];
+
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            const float newIntensity = ClampNormalizedBrightness(pixel.subPixels[color] * brightnessRatio);
+
+            pixel.subPixels[color] = powf(newIntensity, gammaScaler);
+        }
+    }
+}
+
+void BuildAdjustmentLookup(uint8_t outLookupTable[COLOR_COUNT][EImageConstant::TABLE_SIZE], const PixelF normalizedTable[EImageConstant::TABLE_SIZE])
+{
+    for (int i = 0; i < TABLE_SIZE; ++i)
+    {
+        const PixelF& pixel = normalizedTable[i];
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            outLookupTable[color][i] = static_cast<uint8_t>(pixel.subPixels[color] * UNNORMALIZER_F);
+        }
+    }
+}
+
+void StoreAdjustedImage(const Image& srcImage, Image& outImage, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD)
+{
+    assert(srcImage.Width == outImage.Width);
+    assert(srcImage.Height == outImage.Height);
+
+    // the destination first, a copy on write must not leave an aliased source behind
+    const MutableImageView destView = outImage.GetMutableView();
+    const ImageView srcView = &srcImage == &outImage ? destView : srcImage.GetView();
+
+    StoreAdjustedImage(srcView, destView, normalizedTable, bSIMD);
+}
+
+void StoreAdjustedImage(const ImageView& srcView, const MutableImageView& outView, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD)
+{
+    PROFILE_SCOPE_BYTES("StoreAdjustedImage", srcView.GetPixelCount() * sizeof(Pixel) * 2);
+
+    assert(srcView.Width == outView.Width);
+    assert(srcView.Height == outView.Height);
+
+    FusedChainTables tables;
+    const bool bUniformLookups = buildFusedChainTables(tables, nullptr, normalizedTable, false);
+    const FusedChainKernel kernel = SelectFusedChainKernel(srcView.ChannelCount, false, false, false, bUniformLookups, bSIMD);
+
+    // single read, single write pass over the view
+    parallelForRows(srcView.Width, srcView.Height, [&](const int beginRow, const int endRow)
+        {
+            executeFusedRows(kernel, srcView, nullptr, outView, beginRow, endRow, tables);
+        });
+}
+
+bool IsIdentityAdjustment(const PixelF normalizedTable[EImageConstant::TABLE_SIZE])
+{
+    uint8_t lookupTable[COLOR_COUNT][TABLE_SIZE];
+    BuildAdjustmentLookup(lookupTable, normalizedTable);
+
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        for (int i = 0; i < TABLE_SIZE; ++i)
+        {
+            if (lookupTable[color][i] != i)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ExecuteChainInStrips(const Image& srcImage, Image* pOutBufferedImage, Image& outResultImage, const ProcessingChain& chain)
+{
+    assert(!srcImage.IsEmpty());
+    assert(pOutBufferedImage != &srcImage);
+
+    // writing the source would drop its planes
+    assert(chain.pSrcPlanes == nullptr || &outResultImage != &srcImage);
+
+    const int width = srcImage.Width;
+    const int height = srcImage.Height;
+    const int channelCount = srcImage.ChannelCount;
+
+    if (&outResultImage != &srcImage
+        && (outResultImage.Width != width || outResultImage.Height != height || outResultImage.IsEmpty()))
+    {
+        outResultImage = Image(width, height, channelCount);
+    }
+
+    if (pOutBufferedImage != nullptr
+        && (pOutBufferedImage->Width != width || pOutBufferedImage->Height != height || pOutBufferedImage->IsEmpty()))
+    {
+        *pOutBufferedImage = Image(width, height, channelCount);
+    }
+
+    outResultImage.ChannelCount = channelCount;
+    if (pOutBufferedImage != nullptr)
+    {
+        pOutBufferedImage->ChannelCount = channelCount;
+    }
+
+    // the result first, a copy on write must not leave an aliased source behind
+    const MutableImageView resultView = outResultImage.GetMutableView();
+    const ImageView srcView = &outResultImage == &srcImage ? resultView : srcImage.GetView();
+
+    if (pOutBufferedImage != nullptr)
+    {
+        const MutableImageView bufferedView = pOutBufferedImage->GetMutableView();
+
+        return ExecuteChainInStrips(srcView, &bufferedView, resultView, chain);
+    }
+
+    return ExecuteChainInStrips(srcView, nullptr, resultView, chain);
+}
+
+bool ExecuteChainInStrips(const ImageView& srcView, const MutableImageView* pOutBufferedView, const MutableImageView& outResultView, const ProcessingChain& chain)
+{
+    PROFILE_SCOPE_BYTES("ExecuteChainInStrips", srcView.GetPixelCount() * sizeof(Pixel) * (pOutBufferedView != nullptr ? 3 : 2));
+
+    assert(chain.pNormalizedTable != nullptr);
+    assert(srcView.Width == outResultView.Width && srcView.Height == outResultView.Height);
+    assert(pOutBufferedView == nullptr || (srcView.Width == pOutBufferedView->Width && srcView.Height == pOutBufferedView->Height));
+
+    const bool bGrayScale = chain.bGrayScale && srcView.ChannelCount > 2;
+    const Histogram* const pRemapTable = chain.pRemapTable;
+    const CancellationToken* const pCancellation = chain.pCancellation;
+
+    // one pass reads the source and writes the buffered pixels and the result, no stage is copied
+    FusedChainTables tables;
+    const bool bUniformLookups = buildFusedChainTables(tables, pRemapTable, chain.pNormalizedTable, pOutBufferedView != nullptr);
+    const FusedChainKernel kernel = SelectFusedChainKernel(srcView.ChannelCount, bGrayScale, pRemapTable != nullptr, pOutBufferedView != nullptr, bUniformLookups, chain.bSIMD);
+
+    // only the adjustment, the planes skip the split. the planar kernel is vectorized, the scalar loop reads the pixels
+    const bool bAdjustmentOnly = !bGrayScale && pRemapTable == nullptr && pOutBufferedView == nullptr;
+
+    const PlanarImageView* const pSrcPlanes = bAdjustmentOnly && chain.bSIMD ? chain.pSrcPlanes : nullptr;
+    assert(pSrcPlanes == nullptr || (pSrcPlanes->Width == srcView.Width && pSrcPlanes->Height == srcView.Height));
+
+    const int width = srcView.Width;
+    const int height = srcView.Height;
+
+    // every strip is a sub view, the strips are the tiles of the parallel loop
+    const int rowsPerStrip = std::max(1, static_cast<int>(STRIP_CACHE_BYTES / (static_cast<int64_t>(width) * sizeof(Pixel))));
+    const int stripCount = (height + rowsPerStrip - 1) / rowsPerStrip;
+
+    std::atomic<bool> bCancelled(false);
+
+    TaskScheduler::GetInstance()->ParallelFor(0, stripCount, 1, [&](const int64_t beginStrip, const int64_t endStrip)
+        {
+            for (int64_t strip = beginStrip; strip < endStrip; ++strip)
+            {
+                if (pCancellation != nullptr && pCancellation->IsCancelled())
+                {
+                    bCancelled.store(true, std::memory_order_relaxed);
+
+                    return;
+                }
+
+                const int beginRow = static_cast<int>(strip) * rowsPerStrip;
+                const int endRow = std::min(beginRow + rowsPerStrip, height);
+
+                if (pSrcPlanes != nullptr)
+                {
+                    storeAdjustedPlanarRows(*pSrcPlanes, outResultView, beginRow, endRow, tables.Lookups[FUSED_LOOKUP_ADJUSTMENT], chain.bSIMD);
+
+                    continue;
+                }
+
+                executeFusedRows(kernel, srcView, pOutBufferedView, outResultView, beginRow, endRow, tables);
+            }
+        });
+
+    return !bCancelled.load(std::memory_order_relaxed);
+}
+
+void ExecuteChainInPlace(Pixel* pPixels, const int64_t pixelCount, const ProcessingChain& chain)
+{
+    PROFILE_SCOPE_BYTES("ExecuteChainInPlace", pixelCount * sizeof(Pixel) * 2);
+
+    assert(pPixels != nullptr);
+    assert(chain.pNormalizedTable != nullptr);
+
+    // the channel count is unknown, four keeps the alpha as it is
+    FusedChainTables tables;
+    const bool bUniformLookups = buildFusedChainTables(tables, chain.pRemapTable, chain.pNormalizedTable, false);
+    const FusedChainKernel kernel = SelectFusedChainKernel(MAX_CHANNEL_COUNT, chain.bGrayScale, chain.pRemapTable != nullptr, false, bUniformLookups, chain.bSIMD);
+
+    TaskScheduler::GetInstance()->ParallelFor(0, pixelCount, DEFAULT_GRAIN_PIXEL_COUNT, [&](const int64_t begin, const int64_t end)
+        {
+            kernel(pPixels + begin, nullptr, pPixels + begin, end - begin, tables);
+        });
+}
+
+void AccumulateChainFrequencies(uint64_t outFrequencyTables[COLOR_COUNT][EImageConstant::TABLE_SIZE], const Pixel* pPixels, const int64_t pixelCount, const bool bGrayScale)
+{
+    assert(pPixels != nullptr);
+
+    if (bGrayScale)
+    {
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            const uint8_t grayBrightness = ComputeGrayBrightness(pPixels[i]);
+            for (int color = 0; color < COLOR_COUNT; ++color)
+            {
+                ++outFrequencyTables[color][grayBrightness];
+            }
+        }
+
+        return;
+    }
+
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const Pixel pixel = pPixels[i];
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            ++outFrequencyTables[color][pixel.subPixels[color]];
+        }
+    }
+}
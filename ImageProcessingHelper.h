@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "Image.h"
+
+// ui independent processing shared by ImageProcessor and the batch tool.
+// the passes take a whole Image or a strided view of a rectangle of one
+
+template<typename T>
+inline T Clamp(T value, T min, T max)
+{
+    if (value < min)
+    {
+        return min;
+    }
+
+    if (value > max)
+    {
+        return max;
+    }
+
+    return value;
+}
+
+inline float ClampBrightness(const float value)
+{
+    return Clamp(value, MIN_BRIGHTNESS_F, MAX_BRIGHTNESS_F);
+}
+
+inline float ClampNormalizedBrightness(const float value)
+{
+    return Clamp(value, NORMALIZED_MIN_F, NORMALIZED_MAX_F);
+}
+
+// luma coding
+inline uint8_t ComputeGrayBrightness(const Pixel pixel)
+{
+    return static_cast<uint8_t>(ClampBrightness(pixel.rgba.r * 0.299f + pixel.rgba.g * 0.587f + pixel.rgba.b * 0.114f));
+}
+
+void ConvertToGrayScale(Image& outImage);
+void ConvertToGrayScale(const MutableImageView& outView);
+
+// frequency table -> equalized intensity table
+void EqualizeHistogram(Histogram& outHistogram, const int64_t pixelCount);
+
+// 64 bit frequencies of streamed images, more than 4G pixels overflow Histogram
+void EqualizeFrequencies(Histogram& outLookup, const uint64_t frequencyTables[COLOR_COUNT][EImageConstant::TABLE_SIZE], const int64_t pixelCount);
+
+// pixel.subPixels[color] = lookupTable.frequencyTables[color][pixel.subPixels[color]]
+void RemapImage(Image& outImage, const Histogram& lookupTable);
+void RemapImage(const MutableImageView& outView, const Histogram& lookupTable);
+
+void ExecuteEqualization(Image& outImage);
+
+void BuildInverseLookup(Histogram& outInverseLookup, const Histogram& equalizedHist, const Histogram& refEqualizedHist);
+void ExecuteHistogramMatching(Image& outImage, const Histogram& refEqualizedHist);
+
+// histogram of the image as it looks after the optional gray scale stage, nothing is written
+void ComputeChainHistogram(const Image& srcImage, const bool bGrayScale, Histogram& outHistogram);
+void ComputeChainHistogram(const ImageView& srcView, const bool bGrayScale, Histogram& outHistogram);
+
+// remap tables from the chain histogram, a view restricts the statistics to its rectangle
+void BuildEqualizationLookup(Histogram& outLookup, const Image& srcImage, const bool bGrayScale);
+void BuildEqualizationLookup(Histogram& outLookup, const ImageView& srcView, const bool bGrayScale);
+void BuildMatchingLookup(Histogram& outLookup, const Image& srcImage, const bool bGrayScale, const Histogram& refEqualizedHist);
+void BuildMatchingLookup(Histogram& outLookup, const ImageView& srcView, const bool bGrayScale, const Histogram& refEqualizedHist);
+
+// contrast limited adaptive histogram equalization.
+// every tile equalizes its own histogram, clipped at clipLimit times the mean bin height with the excess spread over all bins,
+// and every pixel interpolates bilinearly between the lookups of the four nearest tile centers
+enum EClaheConstant
+{
+    DEFAULT_CLAHE_TILE_COUNT = 8,
+
+    // fixed point weights of the interpolation
+    CLAHE_WEIGHT_ONE = 256
+};
+
+constexpr float DEFAULT_CLAHE_CLIP_LIMIT_F = 2.f;
+
+struct ClaheLookups
+{
+    int TileCountX;
+    int TileCountY;
+
+    // the last column and row of tiles may be smaller
+    int TileWidth;
+    int TileHeight;
+
+    // remap table per tile, row major
+    std::vector<Histogram> TileLookups;
+};
+
+void BuildClaheLookups(ClaheLookups& outLookups, const ImageView& srcView, const bool bGrayScale, const int tileCount, const float clipLimit);
+
+// source -> optional gray scale -> interpolated tile remap, the source may be the destination
+void ApplyClaheLookups(const ImageView& srcView, const MutableImageView& outView, const bool bGrayScale, const ClaheLookups& lookups);
+
+void ExecuteClahe(Image& outImage, const bool bGrayScale);
+
+// separable neighborhood filters, the border pixel is repeated outside of the image and all four channels are filtered.
+// every 1d pass of a filter runs on a padded copy of a row in L1, then on blocks of whole columns that fit in L2,
+// so the image goes through DRAM twice whatever the number of passes. the source may be the destination
+enum EFilterConstant
+{
+    MAX_FILTER_RADIUS = 2048,
+
+    // one buffer of the column passes, the block width follows from the image height
+    FILTER_COLUMN_BLOCK_BYTES = 512 * 1024,
+    MIN_FILTER_COLUMN_BLOCK_WIDTH = 32,
+
+    // boxes whose variances add up to the gaussian's
+    GAUSSIAN_BOX_PASS_COUNT = 3
+};
+
+// exact kernel of radius 3 sigma up to here, the box passes are cheaper above
+constexpr float MAX_EXACT_GAUSSIAN_SIGMA_F = 2.f;
+
+// running sums, O(1) per pixel whatever the radius
+void ExecuteBoxBlur(const ImageView& srcView, const MutableImageView& outView, const int radius);
+void ExecuteBoxBlur(Image& outImage, const int radius);
+
+void ExecuteGaussianBlur(const ImageView& srcView, const MutableImageView& outView, const float sigma);
+void ExecuteGaussianBlur(Image& outImage, const float sigma);
+
+// src + amount * (src - gaussian(src)), alpha is left untouched
+void ExecuteUnsharpMask(const ImageView& srcView, const MutableImageView& outView, const float sigma, const float amount);
+void ExecuteUnsharpMask(Image& outImage, const float sigma, const float amount);
+
+// 2 x 2 box filter, the next level of a mip pyramid. an odd last row or column is averaged with itself
+void DownsampleByHalf(const ImageView& srcView, Image& outImage);
+
+// brightness, gamma
+void NormalizeTable(PixelF outTable[EImageConstant::TABLE_SIZE]);
+void ModifyBrightness(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler);
+void BuildAdjustmentLookup(uint8_t outLookupTable[COLOR_COUNT][EImageConstant::TABLE_SIZE], const PixelF normalizedTable[EImageConstant::TABLE_SIZE]);
+// bSIMD picks the vector loop, false runs the scalar reference
+void StoreAdjustedImage(const Image& srcImage, Image& outImage, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD);
+void StoreAdjustedImage(const ImageView& srcView, const MutableImageView& outView, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD);
+
+// true when StoreAdjustedImage would reproduce the source, the result can share its pixels
+bool IsIdentityAdjustment(const PixelF normalizedTable[EImageConstant::TABLE_SIZE]);
+
+// planar passes over the planes of Image::GetPlanarView, every channel of a row is read as contiguous bytes.
+// a pass that prefers PIXEL_LAYOUT_PLANAR pays for one split of an image without planes, which is worth it
+// when the image is read again, e.g. the buffered image that every slider drag adjusts
+constexpr EPixelLayout HISTOGRAM_PREFERRED_LAYOUT = PIXEL_LAYOUT_PLANAR;
+constexpr EPixelLayout ADJUSTMENT_PREFERRED_LAYOUT = PIXEL_LAYOUT_PLANAR;
+
+// views of the same size
+void SplitToPlanar(const ImageView& srcView, const MutablePlanarImageView& outView);
+void MergeFromPlanar(const PlanarImageView& srcView, const MutableImageView& outView);
+
+void ComputeChainHistogram(const PlanarImageView& srcView, const bool bGrayScale, Histogram& outHistogram);
+void BuildEqualizationLookup(Histogram& outLookup, const PlanarImageView& srcView, const bool bGrayScale);
+void BuildMatchingLookup(Histogram& outLookup, const PlanarImageView& srcView, const bool bGrayScale, const Histogram& refEqualizedHist);
+
+void StoreAdjustedImage(const PlanarImageView& srcView, const MutableImageView& outView, const PixelF normalizedTable[EImageConstant::TABLE_SIZE], const bool bSIMD);
+
+// strip execution of the whole chain, source -> gray scale -> remap -> adjustment.
+// the stages are fused into one loop per channel count and stage combination, see SelectFusedChainKernel,
+// so the image goes through DRAM once for reading and once per written image instead of once per stage.
+// the strips are the units of the parallel loop and of the cancellation.
+// the histogram is a global dependency and has to be resolved before, see ComputeChainHistogram
+enum EStripConstant
+{
+    STRIP_CACHE_BYTES = 256 * 1024
+};
+
+// polled between strips, the work is abandoned as soon as a newer request has been issued
+struct CancellationToken
+{
+    const std::atomic<uint64_t>* pLatestSerial;
+    uint64_t Serial;
+
+    inline bool IsCancelled() const;
+};
+
+struct ProcessingChain
+{
+    bool bGrayScale;
+
+    // vector loop when the cpu has avx2, the scalar one otherwise
+    bool bSIMD;
+
+    // nullptr when histogram processing is off
+    const Histogram* pRemapTable;
+
+    const PixelF* pNormalizedTable;
+
+    // planes of the source or nullptr, an adjustment only chain reads them instead of the pixels
+    const PlanarImageView* pSrcPlanes;
+
+    // nullptr when the chain always runs to the end
+    const CancellationToken* pCancellation;
+};
+
+// pOutBufferedImage receives the image before the adjustment and may be nullptr.
+// srcImage and outResultImage may be the same image.
+// false when cancelled, the outputs are partially written then
+bool ExecuteChainInStrips(const Image& srcImage, Image* pOutBufferedImage, Image& outResultImage, const ProcessingChain& chain);
+
+// views of the same size, e.g. the visible region or one tile of a large image.
+// the source may be the result view, the buffered view must not overlap either
+bool ExecuteChainInStrips(const ImageView& srcView, const MutableImageView* pOutBufferedView, const MutableImageView& outResultView, const ProcessingChain& chain);
+
+// chain on pixels that are not owned by an Image, e.g. the strips of a streamed image.
+// bGrayScale of the chain has to be false for images with less than three channels
+void ExecuteChainInPlace(Pixel* pPixels, const int64_t pixelCount, const ProcessingChain& chain);
+
+// streaming counterpart of ComputeChainHistogram, adds the pixels to 64 bit frequencies
+void AccumulateChainFrequencies(uint64_t outFrequencyTables[COLOR_COUNT][EImageConstant::TABLE_SIZE], const Pixel* pPixels, const int64_t pixelCount, const bool bGrayScale);
+
+inline bool CancellationToken::IsCancelled() const
+{
+    return pLatestSerial->load(std::memory_order_relaxed) != Serial;
+}
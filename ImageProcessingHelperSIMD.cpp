@@ -0,0 +1,1860 @@
+#include "ImageProcessingHelperSIMD.h"
+
+#include "ImageProcessingHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// cephes logf
+constexpr float SQRT_HALF_F = 0.707106781186547524f;
+constexpr float LOG_P0_F = 7.0376836292E-2f;
+constexpr float LOG_P1_F = -1.1514610310E-1f;
+constexpr float LOG_P2_F = 1.1676998740E-1f;
+constexpr float LOG_P3_F = -1.2420140846E-1f;
+constexpr float LOG_P4_F = 1.4249322787E-1f;
+constexpr float LOG_P5_F = -1.6668057665E-1f;
+constexpr float LOG_P6_F = 2.0000714765E-1f;
+constexpr float LOG_P7_F = -2.4999993993E-1f;
+constexpr float LOG_P8_F = 3.3333331174E-1f;
+
+// ln(2) = LN2_HI_F + LN2_LO_F
+constexpr float LN2_HI_F = 0.693359375f;
+constexpr float LN2_LO_F = -2.12194440e-4f;
+
+// cephes expf
+constexpr float EXP_MIN_F = -87.3365478515625f;
+constexpr float LOG2E_F = 1.44269504088896341f;
+constexpr float EXP_P0_F = 1.9875691500E-4f;
+constexpr float EXP_P1_F = 1.3981999507E-3f;
+constexpr float EXP_P2_F = 8.3334519073E-3f;
+constexpr float EXP_P3_F = 4.1665795894E-2f;
+constexpr float EXP_P4_F = 1.6666665459E-1f;
+constexpr float EXP_P5_F = 5.0000001201E-1f;
+
+constexpr int FLOAT_EXPONENT_BIAS = 127;
+constexpr int FLOAT_MANTISSA_BITS = 23;
+
+bool IsAVX2Supported()
+{
+    static const bool bSupported = []()
+        {
+            int cpuInfo[4] = { 0, };
+
+#if defined(_MSC_VER)
+            __cpuid(cpuInfo, 0);
+            if (cpuInfo[0] < 7)
+            {
+                return false;
+            }
+
+            __cpuid(cpuInfo, 1);
+#else
+            if (__get_cpuid_max(0, nullptr) < 7)
+            {
+                return false;
+            }
+
+            __cpuid(1, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
+#endif
+            const bool bOSXSave = (cpuInfo[2] & (1 << 27)) != 0;
+            const bool bAVX = (cpuInfo[2] & (1 << 28)) != 0;
+            if (!bOSXSave || !bAVX)
+            {
+                return false;
+            }
+
+            // os should save ymm registers on context switch
+#if defined(_MSC_VER)
+            const unsigned long long xcr0 = _xgetbv(0);
+#else
+            unsigned int eax;
+            unsigned int edx;
+            __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            const unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+            if ((xcr0 & 0x6) != 0x6)
+            {
+                return false;
+            }
+
+#if defined(_MSC_VER)
+            __cpuidex(cpuInfo, 7, 0);
+#else
+            __cpuid_count(7, 0, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
+#endif
+            return (cpuInfo[1] & (1 << 5)) != 0;
+        }();
+
+    return bSupported;
+}
+
+// sse2, one pixel per register
+static inline __m128 logPS(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+
+    // keep only the mantissa in [0.5, 1)
+    __m128i exponent = _mm_srli_epi32(_mm_castps_si128(x), FLOAT_MANTISSA_BITS);
+    x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~(0xFF << FLOAT_MANTISSA_BITS))));
+    x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+
+    exponent = _mm_sub_epi32(exponent, _mm_set1_epi32(FLOAT_EXPONENT_BIAS));
+    __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), one);
+
+    // x < sqrt(0.5) ? (e - 1, 2x - 1) : (e, x - 1)
+    const __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(SQRT_HALF_F));
+    const __m128 tmp = _mm_and_ps(x, mask);
+    x = _mm_sub_ps(x, one);
+    e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+    x = _mm_add_ps(x, tmp);
+
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(LOG_P0_F);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P1_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P2_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P3_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P4_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P5_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P6_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P7_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P8_F));
+    y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(LN2_LO_F)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+
+    x = _mm_add_ps(x, y);
+    x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(LN2_HI_F)));
+
+    return x;
+}
+
+static inline __m128 expPS(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+
+    // only non positive exponents are produced by pow on [0, 1]
+    x = _mm_max_ps(x, _mm_set1_ps(EXP_MIN_F));
+
+    // n = floor(x * log2(e) + 0.5)
+    __m128 n = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E_F)), _mm_set1_ps(0.5f));
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(n));
+    n = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, n), one));
+
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_HI_F)));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_LO_F)));
+
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(EXP_P0_F);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4_F));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5_F));
+    y = _mm_add_ps(_mm_mul_ps(y, z), x);
+    y = _mm_add_ps(y, one);
+
+    // 2^n
+    __m128i pow2n = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(FLOAT_EXPONENT_BIAS));
+    pow2n = _mm_slli_epi32(pow2n, FLOAT_MANTISSA_BITS);
+
+    return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+}
+
+static inline __m128 modifyBrightnessPS(const __m128 pixel, const __m128 ratio, const __m128 gamma, const __m128 alphaMask)
+{
+    __m128 x = _mm_mul_ps(pixel, ratio);
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(NORMALIZED_MIN_F)), _mm_set1_ps(NORMALIZED_MAX_F));
+
+    // pow(0, gamma) = 0
+    const __m128 nonZeroMask = _mm_cmpgt_ps(x, _mm_setzero_ps());
+    __m128 result = expPS(_mm_mul_ps(gamma, logPS(x)));
+    result = _mm_and_ps(result, nonZeroMask);
+
+    return _mm_or_ps(_mm_and_ps(alphaMask, pixel), _mm_andnot_ps(alphaMask, result));
+}
+
+// avx2, eight values per register
+SIMD_TARGET_AVX2 static inline __m256 logPS(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(x), FLOAT_MANTISSA_BITS);
+    x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~(0xFF << FLOAT_MANTISSA_BITS))));
+    x = _mm256_or_ps(x, _mm256_set1_ps(0.5f));
+
+    exponent = _mm256_sub_epi32(exponent, _mm256_set1_epi32(FLOAT_EXPONENT_BIAS));
+    __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(exponent), one);
+
+    const __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(SQRT_HALF_F), _CMP_LT_OQ);
+    const __m256 tmp = _mm256_and_ps(x, mask);
+    x = _mm256_sub_ps(x, one);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+    x = _mm256_add_ps(x, tmp);
+
+    const __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 y = _mm256_set1_ps(LOG_P0_F);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P1_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P2_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P3_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P4_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P5_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P6_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P7_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P8_F));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+    y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(LN2_LO_F)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+
+    x = _mm256_add_ps(x, y);
+    x = _mm256_add_ps(x, _mm256_mul_ps(e, _mm256_set1_ps(LN2_HI_F)));
+
+    return x;
+}
+
+SIMD_TARGET_AVX2 static inline __m256 expPS(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    x = _mm256_max_ps(x, _mm256_set1_ps(EXP_MIN_F));
+
+    __m256 n = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E_F)), _mm256_set1_ps(0.5f));
+    n = _mm256_floor_ps(n);
+
+    x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_HI_F)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_LO_F)));
+
+    const __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 y = _mm256_set1_ps(EXP_P0_F);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P1_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P2_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P3_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P4_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(EXP_P5_F));
+    y = _mm256_add_ps(_mm256_mul_ps(y, z), x);
+    y = _mm256_add_ps(y, one);
+
+    __m256i pow2n = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(FLOAT_EXPONENT_BIAS));
+    pow2n = _mm256_slli_epi32(pow2n, FLOAT_MANTISSA_BITS);
+
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+// rows of four floats in each 128 bit lane -> columns, its own inverse
+SIMD_TARGET_AVX2 static inline void transposeLanePS(__m256& row0, __m256& row1, __m256& row2, __m256& row3)
+{
+    const __m256 low01 = _mm256_unpacklo_ps(row0, row1);
+    const __m256 high01 = _mm256_unpackhi_ps(row0, row1);
+    const __m256 low23 = _mm256_unpacklo_ps(row2, row3);
+    const __m256 high23 = _mm256_unpackhi_ps(row2, row3);
+
+    row0 = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(1, 0, 1, 0));
+    row1 = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(3, 2, 3, 2));
+    row2 = _mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(1, 0, 1, 0));
+    row3 = _mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+SIMD_TARGET_AVX2 static inline __m256 modifyBrightnessPS(const __m256 channel, const __m256 ratio, const __m256 gamma)
+{
+    __m256 x = _mm256_mul_ps(channel, ratio);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(NORMALIZED_MIN_F)), _mm256_set1_ps(NORMALIZED_MAX_F));
+
+    // pow(0, gamma) = 0
+    const __m256 nonZeroMask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ);
+    const __m256 result = expPS(_mm256_mul_ps(gamma, logPS(x)));
+
+    return _mm256_and_ps(result, nonZeroMask);
+}
+
+// eight pixels per iteration split into b, g, r, a registers, so every lane of the pow is a color channel
+SIMD_TARGET_AVX2 static void modifyBrightnessAVX2(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler)
+{
+    const __m256 ratio = _mm256_set1_ps(brightnessRatio);
+    const __m256 gamma = _mm256_set1_ps(gammaScaler);
+
+    float* pSubPixels = pPixels->subPixels;
+
+    int64_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        float* pRow = pSubPixels + i * MAX_CHANNEL_COUNT;
+
+        // pixels 0 1, 2 3, 4 5, 6 7 -> b, g, r, a of pixels 0 2 4 6 | 1 3 5 7
+        __m256 blue = _mm256_loadu_ps(pRow);
+        __m256 green = _mm256_loadu_ps(pRow + 8);
+        __m256 red = _mm256_loadu_ps(pRow + 16);
+        __m256 alpha = _mm256_loadu_ps(pRow + 24);
+        transposeLanePS(blue, green, red, alpha);
+
+        blue = modifyBrightnessPS(blue, ratio, gamma);
+        green = modifyBrightnessPS(green, ratio, gamma);
+        red = modifyBrightnessPS(red, ratio, gamma);
+
+        transposeLanePS(blue, green, red, alpha);
+        _mm256_storeu_ps(pRow, blue);
+        _mm256_storeu_ps(pRow + 8, green);
+        _mm256_storeu_ps(pRow + 16, red);
+        _mm256_storeu_ps(pRow + 24, alpha);
+    }
+
+    // tail, one pixel per sse register
+    const __m128 tailRatio = _mm_set1_ps(brightnessRatio);
+    const __m128 tailGamma = _mm_set1_ps(gammaScaler);
+    const __m128 alphaMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    for (; i < pixelCount; ++i)
+    {
+        const __m128 pixel = _mm_loadu_ps(pSubPixels + i * MAX_CHANNEL_COUNT);
+        _mm_storeu_ps(pSubPixels + i * MAX_CHANNEL_COUNT, modifyBrightnessPS(pixel, tailRatio, tailGamma, alphaMask));
+    }
+
+    _mm256_zeroupper();
+}
+
+static void modifyBrightnessSSE2(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler)
+{
+    const __m128 ratio = _mm_set1_ps(brightnessRatio);
+    const __m128 gamma = _mm_set1_ps(gammaScaler);
+    const __m128 alphaMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    float* pSubPixels = pPixels->subPixels;
+
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const __m128 pixel = _mm_loadu_ps(pSubPixels + i * MAX_CHANNEL_COUNT);
+        _mm_storeu_ps(pSubPixels + i * MAX_CHANNEL_COUNT, modifyBrightnessPS(pixel, ratio, gamma, alphaMask));
+    }
+}
+
+void ModifyBrightnessSIMD(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler)
+{
+    assert(pPixels != nullptr);
+    assert(pixelCount >= 0);
+    assert(gammaScaler > 0.f);
+
+    if (IsAVX2Supported())
+    {
+        modifyBrightnessAVX2(pPixels, pixelCount, brightnessRatio, gammaScaler);
+    }
+    else
+    {
+        modifyBrightnessSSE2(pPixels, pixelCount, brightnessRatio, gammaScaler);
+    }
+}
+
+// decoded rgb order -> dxgi bgra, one kernel per channel count, scalar versions handle the tails
+
+static void expandGrayScalar(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        pDest[i].pixel = pSrc[i] * 0x010101u | 0xFF000000u;
+    }
+}
+
+static void expandGrayAlphaScalar(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const uint32_t gray = pSrc[i * 2];
+        const uint32_t alpha = pSrc[i * 2 + 1];
+
+        pDest[i].pixel = gray * 0x010101u | alpha << 24;
+    }
+}
+
+static void expandRGBScalar(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const uint8_t* const pSubPixels = pSrc + i * 3;
+
+        pDest[i].pixel = static_cast<uint32_t>(pSubPixels[2]) | pSubPixels[1] << 8 | pSubPixels[0] << 16 | 0xFF000000u;
+    }
+}
+
+static void expandRGBAScalar(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        uint32_t value;
+        memcpy(&value, pSrc + i * 4, sizeof(uint32_t));
+
+        // swap r and b
+        pDest[i].pixel = (value & 0xFF00FF00u) | (value >> 16 & 0xFFu) | (value & 0xFFu) << 16;
+    }
+}
+
+// 16 gray -> 16 pixels
+static void expandGraySSE2(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(UINT8_MAX));
+
+    int64_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+
+        const __m128i grayGrayLow = _mm_unpacklo_epi8(gray, gray);
+        const __m128i grayGrayHigh = _mm_unpackhi_epi8(gray, gray);
+        const __m128i grayAlphaLow = _mm_unpacklo_epi8(gray, alpha);
+        const __m128i grayAlphaHigh = _mm_unpackhi_epi8(gray, alpha);
+
+        __m128i* const pOut = reinterpret_cast<__m128i*>(pDest + i);
+        _mm_storeu_si128(pOut, _mm_unpacklo_epi16(grayGrayLow, grayAlphaLow));
+        _mm_storeu_si128(pOut + 1, _mm_unpackhi_epi16(grayGrayLow, grayAlphaLow));
+        _mm_storeu_si128(pOut + 2, _mm_unpacklo_epi16(grayGrayHigh, grayAlphaHigh));
+        _mm_storeu_si128(pOut + 3, _mm_unpackhi_epi16(grayGrayHigh, grayAlphaHigh));
+    }
+
+    expandGrayScalar(pSrc + i, pDest + i, pixelCount - i);
+}
+
+// 8 gray, alpha pairs -> 8 pixels
+static void expandGrayAlphaSSE2(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    const __m128i grayMask = _mm_set1_epi16(UINT8_MAX);
+
+    int64_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        const __m128i grayAlpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 2));
+
+        const __m128i gray = _mm_and_si128(grayAlpha, grayMask);
+        const __m128i grayGray = _mm_or_si128(gray, _mm_slli_epi16(gray, 8));
+
+        __m128i* const pOut = reinterpret_cast<__m128i*>(pDest + i);
+        _mm_storeu_si128(pOut, _mm_unpacklo_epi16(grayGray, grayAlpha));
+        _mm_storeu_si128(pOut + 1, _mm_unpackhi_epi16(grayGray, grayAlpha));
+    }
+
+    expandGrayAlphaScalar(pSrc + i * 2, pDest + i, pixelCount - i);
+}
+
+// 4 pixels, r and b swapped with shifts, no pshufb before ssse3
+static void expandRGBASSE2(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    const __m128i greenAlphaMask = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m128i lowMask = _mm_set1_epi32(UINT8_MAX);
+
+    int64_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+
+        const __m128i greenAlpha = _mm_and_si128(rgba, greenAlphaMask);
+        const __m128i blue = _mm_and_si128(_mm_srli_epi32(rgba, 16), lowMask);
+        const __m128i red = _mm_slli_epi32(_mm_and_si128(rgba, lowMask), 16);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), _mm_or_si128(greenAlpha, _mm_or_si128(blue, red)));
+    }
+
+    expandRGBAScalar(pSrc + i * 4, pDest + i, pixelCount - i);
+}
+
+// 8 pixels, one 12 byte group per 128 bit lane
+SIMD_TARGET_AVX2 static void expandRGBAVX2(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+
+    // the second load reads 4 bytes past its group, stop while they are still inside the source
+    int64_t i = 0;
+    for (; (i + 8) * 3 + 4 <= pixelCount * 3; i += 8)
+    {
+        const uint8_t* const pGroup = pSrc + i * 3;
+
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pGroup));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pGroup + 12));
+        const __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+        const __m256i bgra = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), bgra);
+    }
+
+    _mm256_zeroupper();
+
+    expandRGBScalar(pSrc + i * 3, pDest + i, pixelCount - i);
+}
+
+// 8 pixels
+SIMD_TARGET_AVX2 static void expandRGBAAVX2(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    int64_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        const __m256i rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i * 4));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), _mm256_shuffle_epi8(rgba, shuffle));
+    }
+
+    _mm256_zeroupper();
+
+    expandRGBAScalar(pSrc + i * 4, pDest + i, pixelCount - i);
+}
+
+void ExpandToBGRA(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount, const int channelCount)
+{
+    assert(pSrc != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    switch (channelCount)
+    {
+    case 1:
+        expandGraySSE2(pSrc, pDest, pixelCount);
+        break;
+
+    case 2:
+        expandGrayAlphaSSE2(pSrc, pDest, pixelCount);
+        break;
+
+    case 3:
+        if (IsAVX2Supported())
+        {
+            expandRGBAVX2(pSrc, pDest, pixelCount);
+        }
+        else
+        {
+            expandRGBScalar(pSrc, pDest, pixelCount);
+        }
+        break;
+
+    case 4:
+        if (IsAVX2Supported())
+        {
+            expandRGBAAVX2(pSrc, pDest, pixelCount);
+        }
+        else
+        {
+            expandRGBASSE2(pSrc, pDest, pixelCount);
+        }
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+}
+
+// left * (1 - weight) + right * weight with weight in 1 / CLAHE_WEIGHT_ONE, the tables are scaled by CLAHE_WEIGHT_ONE as well
+static inline uint8_t interpolateTileLookup(const uint32_t left, const uint32_t right, const int32_t weight)
+{
+    const int32_t value = static_cast<int32_t>(left) * CLAHE_WEIGHT_ONE + (static_cast<int32_t>(right) - static_cast<int32_t>(left)) * weight;
+
+    return static_cast<uint8_t>((value + (1 << 15)) >> 16);
+}
+
+static void interpolateTileLookupsScalar(const Pixel* pSrc, Pixel* pDest, const int64_t pixelCount, const uint32_t* pLeftTables, const uint32_t* pRightTables, const int32_t* pWeights, const bool bGrayScale)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const Pixel pixel = pSrc[i];
+        const int32_t weight = pWeights[i];
+
+        Pixel resultPixel;
+        resultPixel.rgba.a = pixel.rgba.a;
+
+        if (bGrayScale)
+        {
+            const uint8_t grayBrightness = ComputeGrayBrightness(pixel);
+            const uint8_t value = interpolateTileLookup(pLeftTables[grayBrightness], pRightTables[grayBrightness], weight);
+
+            resultPixel.rgba.b = value;
+            resultPixel.rgba.g = value;
+            resultPixel.rgba.r = value;
+        }
+        else
+        {
+            for (int color = 0; color < COLOR_COUNT; ++color)
+            {
+                const int index = color * TABLE_SIZE + pixel.subPixels[color];
+
+                resultPixel.subPixels[color] = interpolateTileLookup(pLeftTables[index], pRightTables[index], weight);
+            }
+        }
+
+        pDest[i] = resultPixel;
+    }
+}
+
+// 8 lookups of one channel, the gathers read 32 bit entries
+SIMD_TARGET_AVX2 static inline __m256i interpolateTileLookupsEPI32(const uint32_t* pLeftTable, const uint32_t* pRightTable, const __m256i index, const __m256i weight)
+{
+    const __m256i left = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pLeftTable), index, 4);
+    const __m256i right = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pRightTable), index, 4);
+
+    // left * 256 + (right - left) * weight is never negative
+    const __m256i value = _mm256_add_epi32(_mm256_slli_epi32(left, 8), _mm256_mullo_epi32(_mm256_sub_epi32(right, left), weight));
+
+    return _mm256_srli_epi32(_mm256_add_epi32(value, _mm256_set1_epi32(1 << 15)), 16);
+}
+
+// 8 pixels, gray brightness is computed by the scalar formula so that both paths agree
+SIMD_TARGET_AVX2 static void interpolateTileLookupsAVX2(const Pixel* pSrc, Pixel* pDest, const int64_t pixelCount, const uint32_t* pLeftTables, const uint32_t* pRightTables, const int32_t* pWeights, const bool bGrayScale)
+{
+    const __m256i byteMask = _mm256_set1_epi32(UINT8_MAX);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+
+    int64_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        const __m256i weight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pWeights + i));
+
+        __m256i result = _mm256_and_si256(pixels, alphaMask);
+
+        if (bGrayScale)
+        {
+            alignas(32) int32_t grayBrightnesses[8];
+            for (int k = 0; k < 8; ++k)
+            {
+                grayBrightnesses[k] = ComputeGrayBrightness(pSrc[i + k]);
+            }
+
+            const __m256i index = _mm256_load_si256(reinterpret_cast<const __m256i*>(grayBrightnesses));
+            const __m256i value = interpolateTileLookupsEPI32(pLeftTables, pRightTables, index, weight);
+
+            result = _mm256_or_si256(result, _mm256_or_si256(value, _mm256_or_si256(_mm256_slli_epi32(value, 8), _mm256_slli_epi32(value, 16))));
+        }
+        else
+        {
+            const __m256i blue = interpolateTileLookupsEPI32(pLeftTables, pRightTables, _mm256_and_si256(pixels, byteMask), weight);
+            const __m256i green = interpolateTileLookupsEPI32(pLeftTables + TABLE_SIZE, pRightTables + TABLE_SIZE, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), weight);
+            const __m256i red = interpolateTileLookupsEPI32(pLeftTables + 2 * TABLE_SIZE, pRightTables + 2 * TABLE_SIZE, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), weight);
+
+            result = _mm256_or_si256(result, _mm256_or_si256(blue, _mm256_or_si256(_mm256_slli_epi32(green, 8), _mm256_slli_epi32(red, 16))));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), result);
+    }
+
+    _mm256_zeroupper();
+
+    interpolateTileLookupsScalar(pSrc + i, pDest + i, pixelCount - i, pLeftTables, pRightTables, pWeights + i, bGrayScale);
+}
+
+void InterpolateTileLookupsSIMD(const Pixel* pSrc, Pixel* pDest, const int64_t pixelCount, const uint32_t* pLeftTables, const uint32_t* pRightTables, const int32_t* pWeights, const bool bGrayScale)
+{
+    assert(pSrc != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    // no gather before avx2
+    if (IsAVX2Supported())
+    {
+        interpolateTileLookupsAVX2(pSrc, pDest, pixelCount, pLeftTables, pRightTables, pWeights, bGrayScale);
+    }
+    else
+    {
+        interpolateTileLookupsScalar(pSrc, pDest, pixelCount, pLeftTables, pRightTables, pWeights, bGrayScale);
+    }
+}
+
+// separable filter passes on padded inputs, the border pixels are already repeated by the caller.
+// box sums are divided by a multiply with a 24 bit fixed point reciprocal, exact rounding for every radius up to MAX_FILTER_RADIUS
+constexpr int BOX_RECIPROCAL_SHIFT = 24;
+
+static inline uint32_t computeBoxReciprocal(const int radius)
+{
+    const uint32_t windowLength = 2 * radius + 1;
+
+    return ((1u << BOX_RECIPROCAL_SHIFT) + windowLength / 2) / windowLength;
+}
+
+static inline uint8_t divideBoxSum(const uint32_t sum, const uint32_t reciprocal)
+{
+    return static_cast<uint8_t>((sum * reciprocal + (1u << (BOX_RECIPROCAL_SHIFT - 1))) >> BOX_RECIPROCAL_SHIFT);
+}
+
+// weighted sums are rounded to nearest even like cvtps
+static inline uint8_t roundToSubPixel(const float value)
+{
+    return static_cast<uint8_t>(Clamp<long>(std::lrint(value), MIN_BRIGHTNESS, MAX_BRIGHTNESS));
+}
+
+// 4 x 2 pixels of epi32 subpixels -> 8 pixels in order, saturated to [0, 255]
+SIMD_TARGET_AVX2 static inline __m256i packPixelsEPI32(const __m256i pixels01, const __m256i pixels23, const __m256i pixels45, const __m256i pixels67)
+{
+    // lanes hold the even and odd pixels after the in lane packs
+    const __m256i words = _mm256_packus_epi32(pixels01, pixels23);
+    const __m256i words2 = _mm256_packus_epi32(pixels45, pixels67);
+    const __m256i bytes = _mm256_packus_epi16(words, words2);
+
+    return _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+SIMD_TARGET_AVX2 static inline __m256i loadPixelsEPI32(const Pixel* pPixels)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pPixels)));
+}
+
+SIMD_TARGET_AVX2 static inline __m256i divideBoxSumsEPI32(const __m256i sums, const __m256i reciprocal)
+{
+    const __m256i rounding = _mm256_set1_epi32(1 << (BOX_RECIPROCAL_SHIFT - 1));
+
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sums, reciprocal), rounding), BOX_RECIPROCAL_SHIFT);
+}
+
+static void boxFilterRowScalar(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const int radius)
+{
+    const uint32_t reciprocal = computeBoxReciprocal(radius);
+
+    uint32_t sums[MAX_CHANNEL_COUNT] = { 0, };
+    for (int i = 0; i <= 2 * radius; ++i)
+    {
+        for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+        {
+            sums[channel] += pPaddedSrc[i].subPixels[channel];
+        }
+    }
+
+    for (int x = 0; x < width; ++x)
+    {
+        for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+        {
+            pDest[x].subPixels[channel] = divideBoxSum(sums[channel], reciprocal);
+        }
+
+        if (x + 1 == width)
+        {
+            break;
+        }
+
+        // the window of x + 1 drops x - r and takes x + r + 1, padded indices x and x + 2r + 1
+        for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+        {
+            sums[channel] += pPaddedSrc[x + 2 * radius + 1].subPixels[channel] - pPaddedSrc[x].subPixels[channel];
+        }
+    }
+}
+
+// the running sums of two neighbouring pixels advance together by two pixels
+SIMD_TARGET_AVX2 static void boxFilterRowAVX2(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const int radius)
+{
+    const int windowLength = 2 * radius + 1;
+    const __m128i reciprocal = _mm_set1_epi32(computeBoxReciprocal(radius));
+    const __m128i rounding = _mm_set1_epi32(1 << (BOX_RECIPROCAL_SHIFT - 1));
+
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < windowLength; ++i)
+    {
+        sum = _mm_add_epi32(sum, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pPaddedSrc[i].pixel))));
+    }
+
+    int x = 0;
+    if (width >= 4)
+    {
+        const __m128i nextSum = _mm_sub_epi32(_mm_add_epi32(sum, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pPaddedSrc[windowLength].pixel)))),
+            _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pPaddedSrc[0].pixel))));
+
+        const __m256i reciprocals = _mm256_set1_epi32(computeBoxReciprocal(radius));
+
+        __m256i sums = _mm256_inserti128_si256(_mm256_castsi128_si256(sum), nextSum, 1);
+
+        // the next pair reads up to padded index x + 2r + 3
+        for (; x + 4 <= width; x += 2)
+        {
+            const __m256i result = divideBoxSumsEPI32(sums, reciprocals);
+            const __m256i words = _mm256_packus_epi32(result, result);
+            const __m256i bytes = _mm256_packus_epi16(words, words);
+
+            pDest[x].pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(bytes)));
+            pDest[x + 1].pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1)));
+
+            const __m256i entering = _mm256_add_epi32(loadPixelsEPI32(pPaddedSrc + x + windowLength), loadPixelsEPI32(pPaddedSrc + x + windowLength + 1));
+            const __m256i leaving = _mm256_add_epi32(loadPixelsEPI32(pPaddedSrc + x), loadPixelsEPI32(pPaddedSrc + x + 1));
+
+            sums = _mm256_add_epi32(sums, _mm256_sub_epi32(entering, leaving));
+        }
+
+        sum = _mm256_castsi256_si128(sums);
+    }
+
+    _mm256_zeroupper();
+
+    for (; x < width; ++x)
+    {
+        const __m128i result = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(sum, reciprocal), rounding), BOX_RECIPROCAL_SHIFT);
+        const __m128i words = _mm_packus_epi32(result, result);
+
+        pDest[x].pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+
+        if (x + 1 == width)
+        {
+            break;
+        }
+
+        sum = _mm_sub_epi32(_mm_add_epi32(sum, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pPaddedSrc[x + windowLength].pixel)))),
+            _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pPaddedSrc[x].pixel))));
+    }
+}
+
+void BoxFilterRowSIMD(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const int radius)
+{
+    assert(pPaddedSrc != nullptr);
+    assert(pDest != nullptr);
+    assert(width > 0);
+    assert(radius >= 0 && radius <= MAX_FILTER_RADIUS);
+
+    if (IsAVX2Supported())
+    {
+        boxFilterRowAVX2(pPaddedSrc, pDest, width, radius);
+    }
+    else
+    {
+        boxFilterRowScalar(pPaddedSrc, pDest, width, radius);
+    }
+}
+
+static void boxFilterColumnsScalar(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const int radius, uint32_t* pSums)
+{
+    const int subPixelCount = outView.Width * MAX_CHANNEL_COUNT;
+    const uint32_t reciprocal = computeBoxReciprocal(radius);
+
+    std::fill(pSums, pSums + subPixelCount, 0u);
+    for (int i = 0; i <= 2 * radius; ++i)
+    {
+        const uint8_t* pSubPixels = ppPaddedRows[i]->subPixels;
+        for (int j = 0; j < subPixelCount; ++j)
+        {
+            pSums[j] += pSubPixels[j];
+        }
+    }
+
+    for (int y = 0; y < outView.Height; ++y)
+    {
+        uint8_t* pDestSubPixels = outView.GetRow(y)->subPixels;
+        for (int j = 0; j < subPixelCount; ++j)
+        {
+            pDestSubPixels[j] = divideBoxSum(pSums[j], reciprocal);
+        }
+
+        if (y + 1 == outView.Height)
+        {
+            break;
+        }
+
+        const uint8_t* pEntering = ppPaddedRows[y + 2 * radius + 1]->subPixels;
+        const uint8_t* pLeaving = ppPaddedRows[y]->subPixels;
+        for (int j = 0; j < subPixelCount; ++j)
+        {
+            pSums[j] += pEntering[j] - pLeaving[j];
+        }
+    }
+}
+
+// the sums of the whole block row stay in L1, 8 pixels per step
+SIMD_TARGET_AVX2 static void boxFilterColumnsAVX2(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const int radius, uint32_t* pSums)
+{
+    const int width = outView.Width;
+    const int vectorWidth = width - width % 8;
+    const uint32_t scalarReciprocal = computeBoxReciprocal(radius);
+    const __m256i reciprocal = _mm256_set1_epi32(scalarReciprocal);
+
+    __m256i* const pSumVectors = reinterpret_cast<__m256i*>(pSums);
+
+    std::fill(pSums, pSums + width * MAX_CHANNEL_COUNT, 0u);
+    for (int i = 0; i <= 2 * radius; ++i)
+    {
+        const Pixel* const pRow = ppPaddedRows[i];
+
+        int x = 0;
+        for (; x + 2 <= width; x += 2)
+        {
+            _mm256_storeu_si256(pSumVectors + x / 2, _mm256_add_epi32(_mm256_loadu_si256(pSumVectors + x / 2), loadPixelsEPI32(pRow + x)));
+        }
+
+        for (; x < width; ++x)
+        {
+            for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+            {
+                pSums[x * MAX_CHANNEL_COUNT + channel] += pRow[x].subPixels[channel];
+            }
+        }
+    }
+
+    for (int y = 0; y < outView.Height; ++y)
+    {
+        Pixel* const pDest = outView.GetRow(y);
+        const bool bLastRow = y + 1 == outView.Height;
+
+        const Pixel* const pEntering = bLastRow ? nullptr : ppPaddedRows[y + 2 * radius + 1];
+        const Pixel* const pLeaving = ppPaddedRows[y];
+
+        int x = 0;
+        for (; x < vectorWidth; x += 8)
+        {
+            __m256i* const pVectors = pSumVectors + x / 2;
+
+            const __m256i sum01 = _mm256_loadu_si256(pVectors);
+            const __m256i sum23 = _mm256_loadu_si256(pVectors + 1);
+            const __m256i sum45 = _mm256_loadu_si256(pVectors + 2);
+            const __m256i sum67 = _mm256_loadu_si256(pVectors + 3);
+
+            const __m256i result = packPixelsEPI32(divideBoxSumsEPI32(sum01, reciprocal), divideBoxSumsEPI32(sum23, reciprocal),
+                divideBoxSumsEPI32(sum45, reciprocal), divideBoxSumsEPI32(sum67, reciprocal));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + x), result);
+
+            if (bLastRow)
+            {
+                continue;
+            }
+
+            _mm256_storeu_si256(pVectors, _mm256_add_epi32(sum01, _mm256_sub_epi32(loadPixelsEPI32(pEntering + x), loadPixelsEPI32(pLeaving + x))));
+            _mm256_storeu_si256(pVectors + 1, _mm256_add_epi32(sum23, _mm256_sub_epi32(loadPixelsEPI32(pEntering + x + 2), loadPixelsEPI32(pLeaving + x + 2))));
+            _mm256_storeu_si256(pVectors + 2, _mm256_add_epi32(sum45, _mm256_sub_epi32(loadPixelsEPI32(pEntering + x + 4), loadPixelsEPI32(pLeaving + x + 4))));
+            _mm256_storeu_si256(pVectors + 3, _mm256_add_epi32(sum67, _mm256_sub_epi32(loadPixelsEPI32(pEntering + x + 6), loadPixelsEPI32(pLeaving + x + 6))));
+        }
+
+        // tail pixels one by one, their sums are 4 subpixels each
+        for (; x < width; ++x)
+        {
+            uint32_t* const pPixelSums = pSums + x * MAX_CHANNEL_COUNT;
+            for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+            {
+                pDest[x].subPixels[channel] = divideBoxSum(pPixelSums[channel], scalarReciprocal);
+
+                if (!bLastRow)
+                {
+                    pPixelSums[channel] += pEntering[x].subPixels[channel] - pLeaving[x].subPixels[channel];
+                }
+            }
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+void BoxFilterColumnsSIMD(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const int radius, uint32_t* pSums)
+{
+    assert(ppPaddedRows != nullptr);
+    assert(outView.pPixels != nullptr);
+    assert(radius >= 0 && radius <= MAX_FILTER_RADIUS);
+    assert(pSums != nullptr);
+
+    if (IsAVX2Supported())
+    {
+        boxFilterColumnsAVX2(ppPaddedRows, outView, radius, pSums);
+    }
+    else
+    {
+        boxFilterColumnsScalar(ppPaddedRows, outView, radius, pSums);
+    }
+}
+
+static void convolveRowScalar(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const float* pWeights, const int radius)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        float sums[MAX_CHANNEL_COUNT] = { 0.f, };
+        for (int k = 0; k <= 2 * radius; ++k)
+        {
+            for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+            {
+                sums[channel] += pWeights[k] * pPaddedSrc[x + k].subPixels[channel];
+            }
+        }
+
+        for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+        {
+            pDest[x].subPixels[channel] = roundToSubPixel(sums[channel]);
+        }
+    }
+}
+
+SIMD_TARGET_AVX2 static inline void convertToFloatPixels(const Pixel* pSrc, PixelF* pDest, const int pixelCount)
+{
+    int i = 0;
+    for (; i + 2 <= pixelCount; i += 2)
+    {
+        _mm256_storeu_ps(pDest[i].subPixels, _mm256_cvtepi32_ps(loadPixelsEPI32(pSrc + i)));
+    }
+
+    for (; i < pixelCount; ++i)
+    {
+        _mm_storeu_ps(pDest[i].subPixels, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pSrc[i].pixel)))));
+    }
+}
+
+// sum of weighted float pixels -> 8 bit, one pixel
+SIMD_TARGET_AVX2 static inline uint32_t storeWeightedPixel(const __m128 sum)
+{
+    const __m128i words = _mm_packus_epi32(_mm_cvtps_epi32(sum), _mm_setzero_si128());
+
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+// the padded row is converted once, every tap is a multiply and add of float pixels in L1 / L2
+SIMD_TARGET_AVX2 static void convolveRowAVX2(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const float* pWeights, const int radius, PixelF* pScratch)
+{
+    const int tapCount = 2 * radius + 1;
+
+    convertToFloatPixels(pPaddedSrc, pScratch, width + 2 * radius);
+
+    const float* const pSubPixels = pScratch->subPixels;
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // named accumulators, an array is kept in memory by the compilers
+        const __m256 centerWeight = _mm256_set1_ps(pWeights[radius]);
+        const float* const pCenter = pSubPixels + (x + radius) * MAX_CHANNEL_COUNT;
+
+        __m256 sum01 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter));
+        __m256 sum23 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 2 * MAX_CHANNEL_COUNT));
+        __m256 sum45 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 4 * MAX_CHANNEL_COUNT));
+        __m256 sum67 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 6 * MAX_CHANNEL_COUNT));
+
+        // mirrored taps share their weight
+        for (int k = 0; k < radius; ++k)
+        {
+            const __m256 weight = _mm256_set1_ps(pWeights[k]);
+            const float* const pLeft = pSubPixels + (x + k) * MAX_CHANNEL_COUNT;
+            const float* const pRight = pSubPixels + (x + tapCount - 1 - k) * MAX_CHANNEL_COUNT;
+
+            sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pLeft), _mm256_loadu_ps(pRight))));
+            sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pLeft + 2 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pRight + 2 * MAX_CHANNEL_COUNT))));
+            sum45 = _mm256_add_ps(sum45, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pLeft + 4 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pRight + 4 * MAX_CHANNEL_COUNT))));
+            sum67 = _mm256_add_ps(sum67, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pLeft + 6 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pRight + 6 * MAX_CHANNEL_COUNT))));
+        }
+
+        const __m256i result = packPixelsEPI32(_mm256_cvtps_epi32(sum01), _mm256_cvtps_epi32(sum23), _mm256_cvtps_epi32(sum45), _mm256_cvtps_epi32(sum67));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + x), result);
+    }
+
+    for (; x < width; ++x)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < tapCount; ++k)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pWeights[k]), _mm_loadu_ps(pScratch[x + k].subPixels)));
+        }
+
+        pDest[x].pixel = storeWeightedPixel(sum);
+    }
+
+    _mm256_zeroupper();
+}
+
+void ConvolveRowSIMD(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const float* pWeights, const int radius, PixelF* pScratch)
+{
+    assert(pPaddedSrc != nullptr);
+    assert(pDest != nullptr);
+    assert(width > 0);
+    assert(pWeights != nullptr);
+    assert(radius >= 0 && radius <= MAX_FILTER_RADIUS);
+    assert(pScratch != nullptr);
+
+    if (IsAVX2Supported())
+    {
+        convolveRowAVX2(pPaddedSrc, pDest, width, pWeights, radius, pScratch);
+    }
+    else
+    {
+        convolveRowScalar(pPaddedSrc, pDest, width, pWeights, radius);
+    }
+}
+
+static void convolveColumnsScalar(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const float* pWeights, const int radius)
+{
+    for (int y = 0; y < outView.Height; ++y)
+    {
+        Pixel* const pDest = outView.GetRow(y);
+        for (int x = 0; x < outView.Width; ++x)
+        {
+            float sums[MAX_CHANNEL_COUNT] = { 0.f, };
+            for (int k = 0; k <= 2 * radius; ++k)
+            {
+                for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+                {
+                    sums[channel] += pWeights[k] * ppPaddedRows[y + k][x].subPixels[channel];
+                }
+            }
+
+            for (int channel = 0; channel < MAX_CHANNEL_COUNT; ++channel)
+            {
+                pDest[x].subPixels[channel] = roundToSubPixel(sums[channel]);
+            }
+        }
+    }
+}
+
+// ring of the 2r + 1 float rows under the window, every input row is converted once
+SIMD_TARGET_AVX2 static void convolveColumnsAVX2(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const float* pWeights, const int radius, PixelF* pScratch)
+{
+    const int width = outView.Width;
+    const int tapCount = 2 * radius + 1;
+
+    std::vector<const PixelF*> tapRows(tapCount);
+    const PixelF** const ppTaps = tapRows.data();
+
+    for (int k = 0; k < tapCount - 1; ++k)
+    {
+        convertToFloatPixels(ppPaddedRows[k], pScratch + static_cast<int64_t>(k) * width, width);
+    }
+
+    for (int y = 0; y < outView.Height; ++y)
+    {
+        // the row entering the window replaces the one that left it
+        const int enteringIndex = y + tapCount - 1;
+        convertToFloatPixels(ppPaddedRows[enteringIndex], pScratch + static_cast<int64_t>(enteringIndex % tapCount) * width, width);
+
+        // float rows of the window in tap order, the oldest one is in the slot of y
+        int slot = y % tapCount;
+        for (int k = 0; k < tapCount; ++k)
+        {
+            ppTaps[k] = pScratch + static_cast<int64_t>(slot) * width;
+
+            slot = slot + 1 == tapCount ? 0 : slot + 1;
+        }
+
+        Pixel* const pDest = outView.GetRow(y);
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256 centerWeight = _mm256_set1_ps(pWeights[radius]);
+            const float* const pCenter = ppTaps[radius][x].subPixels;
+
+            __m256 sum01 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter));
+            __m256 sum23 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 2 * MAX_CHANNEL_COUNT));
+            __m256 sum45 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 4 * MAX_CHANNEL_COUNT));
+            __m256 sum67 = _mm256_mul_ps(centerWeight, _mm256_loadu_ps(pCenter + 6 * MAX_CHANNEL_COUNT));
+
+            for (int k = 0; k < radius; ++k)
+            {
+                const __m256 weight = _mm256_set1_ps(pWeights[k]);
+                const float* const pTop = ppTaps[k][x].subPixels;
+                const float* const pBottom = ppTaps[tapCount - 1 - k][x].subPixels;
+
+                sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pTop), _mm256_loadu_ps(pBottom))));
+                sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pTop + 2 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pBottom + 2 * MAX_CHANNEL_COUNT))));
+                sum45 = _mm256_add_ps(sum45, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pTop + 4 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pBottom + 4 * MAX_CHANNEL_COUNT))));
+                sum67 = _mm256_add_ps(sum67, _mm256_mul_ps(weight, _mm256_add_ps(_mm256_loadu_ps(pTop + 6 * MAX_CHANNEL_COUNT), _mm256_loadu_ps(pBottom + 6 * MAX_CHANNEL_COUNT))));
+            }
+
+            const __m256i result = packPixelsEPI32(_mm256_cvtps_epi32(sum01), _mm256_cvtps_epi32(sum23), _mm256_cvtps_epi32(sum45), _mm256_cvtps_epi32(sum67));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + x), result);
+        }
+
+        for (; x < width; ++x)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < tapCount; ++k)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pWeights[k]), _mm_loadu_ps(ppTaps[k][x].subPixels)));
+            }
+
+            pDest[x].pixel = storeWeightedPixel(sum);
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+void ConvolveColumnsSIMD(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const float* pWeights, const int radius, PixelF* pScratch)
+{
+    assert(ppPaddedRows != nullptr);
+    assert(outView.pPixels != nullptr);
+    assert(pWeights != nullptr);
+    assert(radius >= 0 && radius <= MAX_FILTER_RADIUS);
+    assert(pScratch != nullptr);
+
+    if (IsAVX2Supported())
+    {
+        convolveColumnsAVX2(ppPaddedRows, outView, pWeights, radius, pScratch);
+    }
+    else
+    {
+        convolveColumnsScalar(ppPaddedRows, outView, pWeights, radius);
+    }
+}
+
+static void sharpenScalar(const Pixel* pSrc, const Pixel* pBlurred, Pixel* pDest, const int64_t pixelCount, const float amount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const Pixel pixel = pSrc[i];
+
+        Pixel resultPixel;
+        resultPixel.rgba.a = pixel.rgba.a;
+
+        for (int color = 0; color < COLOR_COUNT; ++color)
+        {
+            const float value = pixel.subPixels[color];
+            resultPixel.subPixels[color] = roundToSubPixel(value + amount * (value - pBlurred[i].subPixels[color]));
+        }
+
+        pDest[i] = resultPixel;
+    }
+}
+
+// 2 pixels
+SIMD_TARGET_AVX2 static inline __m256i sharpenEPI32(const Pixel* pSrc, const Pixel* pBlurred, const __m256 amounts)
+{
+    const __m256 pixels = _mm256_cvtepi32_ps(loadPixelsEPI32(pSrc));
+    const __m256 blurred = _mm256_cvtepi32_ps(loadPixelsEPI32(pBlurred));
+
+    return _mm256_cvtps_epi32(_mm256_add_ps(pixels, _mm256_mul_ps(amounts, _mm256_sub_ps(pixels, blurred))));
+}
+
+SIMD_TARGET_AVX2 static void sharpenAVX2(const Pixel* pSrc, const Pixel* pBlurred, Pixel* pDest, const int64_t pixelCount, const float amount)
+{
+    // bgra bgra, alpha is scaled by 0 and keeps the source
+    const __m256 amounts = _mm256_setr_ps(amount, amount, amount, 0.f, amount, amount, amount, 0.f);
+
+    int64_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        const __m256i result = packPixelsEPI32(sharpenEPI32(pSrc + i, pBlurred + i, amounts), sharpenEPI32(pSrc + i + 2, pBlurred + i + 2, amounts),
+            sharpenEPI32(pSrc + i + 4, pBlurred + i + 4, amounts), sharpenEPI32(pSrc + i + 6, pBlurred + i + 6, amounts));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), result);
+    }
+
+    _mm256_zeroupper();
+
+    sharpenScalar(pSrc + i, pBlurred + i, pDest + i, pixelCount - i, amount);
+}
+
+void SharpenSIMD(const Pixel* pSrc, const Pixel* pBlurred, Pixel* pDest, const int64_t pixelCount, const float amount)
+{
+    assert(pSrc != nullptr);
+    assert(pBlurred != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    if (IsAVX2Supported())
+    {
+        sharpenAVX2(pSrc, pBlurred, pDest, pixelCount, amount);
+    }
+    else
+    {
+        sharpenScalar(pSrc, pBlurred, pDest, pixelCount, amount);
+    }
+}
+
+// interleaved <-> planar
+
+static void splitToPlanesScalar(const Pixel* pSrc, uint8_t* const pOutPlanes[MAX_CHANNEL_COUNT], const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        const Pixel pixel = pSrc[i];
+        for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
+        {
+            pOutPlanes[plane][i] = pixel.subPixels[plane];
+        }
+    }
+}
+
+static void mergeFromPlanesScalar(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        Pixel pixel;
+        for (int plane = 0; plane < MAX_CHANNEL_COUNT; ++plane)
+        {
+            pixel.subPixels[plane] = pPlanes[plane][i];
+        }
+
+        pDest[i] = pixel;
+    }
+}
+
+// bgra bgra .. <-> bbbb gggg rrrr aaaa within every 128 bit lane, its own inverse
+SIMD_TARGET_AVX2 static inline __m256i transposeLaneEPI8(const __m256i pixels)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+        0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    return _mm256_shuffle_epi8(pixels, shuffle);
+}
+
+// 8 pixels -> 8 bytes of b, g, r, a in that order
+SIMD_TARGET_AVX2 static inline __m256i splitPixelsEPI8(const Pixel* pSrc)
+{
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc));
+
+    return _mm256_permutevar8x32_epi32(transposeLaneEPI8(pixels), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+// 8 bytes of b, g, r, a -> 8 pixels
+SIMD_TARGET_AVX2 static inline void storeMergedEPI8(Pixel* pDest, const __m256i channels)
+{
+    const __m256i pixels = transposeLaneEPI8(_mm256_permutevar8x32_epi32(channels, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest), pixels);
+}
+
+// 32 pixels of 4 planes -> 4 x 8 pixels
+SIMD_TARGET_AVX2 static inline void storeMergedPlanesEPI8(Pixel* pDest, const __m256i blue, const __m256i green, const __m256i red, const __m256i alpha)
+{
+    const __m256i blueRed01 = _mm256_permute2x128_si256(blue, red, 0x20);
+    const __m256i blueRed23 = _mm256_permute2x128_si256(blue, red, 0x31);
+    const __m256i greenAlpha01 = _mm256_permute2x128_si256(green, alpha, 0x20);
+    const __m256i greenAlpha23 = _mm256_permute2x128_si256(green, alpha, 0x31);
+
+    storeMergedEPI8(pDest, _mm256_unpacklo_epi64(blueRed01, greenAlpha01));
+    storeMergedEPI8(pDest + 8, _mm256_unpackhi_epi64(blueRed01, greenAlpha01));
+    storeMergedEPI8(pDest + 16, _mm256_unpacklo_epi64(blueRed23, greenAlpha23));
+    storeMergedEPI8(pDest + 24, _mm256_unpackhi_epi64(blueRed23, greenAlpha23));
+}
+
+// 32 pixels as b, g, r, a planes in registers
+struct PixelBlock
+{
+    __m256i Blue;
+    __m256i Green;
+    __m256i Red;
+    __m256i Alpha;
+};
+
+SIMD_TARGET_AVX2 static inline void loadPixelBlockEPI8(const Pixel* pSrc, PixelBlock& outBlock)
+{
+    const __m256i channels0 = splitPixelsEPI8(pSrc);
+    const __m256i channels1 = splitPixelsEPI8(pSrc + 8);
+    const __m256i channels2 = splitPixelsEPI8(pSrc + 16);
+    const __m256i channels3 = splitPixelsEPI8(pSrc + 24);
+
+    // b0 b1 | r0 r1, g0 g1 | a0 a1 ..
+    const __m256i blueRed01 = _mm256_unpacklo_epi64(channels0, channels1);
+    const __m256i greenAlpha01 = _mm256_unpackhi_epi64(channels0, channels1);
+    const __m256i blueRed23 = _mm256_unpacklo_epi64(channels2, channels3);
+    const __m256i greenAlpha23 = _mm256_unpackhi_epi64(channels2, channels3);
+
+    outBlock.Blue = _mm256_permute2x128_si256(blueRed01, blueRed23, 0x20);
+    outBlock.Green = _mm256_permute2x128_si256(greenAlpha01, greenAlpha23, 0x20);
+    outBlock.Red = _mm256_permute2x128_si256(blueRed01, blueRed23, 0x31);
+    outBlock.Alpha = _mm256_permute2x128_si256(greenAlpha01, greenAlpha23, 0x31);
+}
+
+SIMD_TARGET_AVX2 static inline void storePixelBlockEPI8(Pixel* pDest, const PixelBlock& block)
+{
+    storeMergedPlanesEPI8(pDest, block.Blue, block.Green, block.Red, block.Alpha);
+}
+
+SIMD_TARGET_AVX2 static void splitToPlanesAVX2(const Pixel* pSrc, uint8_t* const pOutPlanes[MAX_CHANNEL_COUNT], const int64_t pixelCount)
+{
+    int64_t i = 0;
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        PixelBlock block;
+        loadPixelBlockEPI8(pSrc + i, block);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutPlanes[0] + i), block.Blue);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutPlanes[1] + i), block.Green);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutPlanes[2] + i), block.Red);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutPlanes[3] + i), block.Alpha);
+    }
+
+    _mm256_zeroupper();
+
+    uint8_t* const pTailPlanes[MAX_CHANNEL_COUNT] = { pOutPlanes[0] + i, pOutPlanes[1] + i, pOutPlanes[2] + i, pOutPlanes[3] + i };
+    splitToPlanesScalar(pSrc + i, pTailPlanes, pixelCount - i);
+}
+
+SIMD_TARGET_AVX2 static void mergeFromPlanesAVX2(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount)
+{
+    int64_t i = 0;
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        const __m256i blue = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[0] + i));
+        const __m256i green = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[1] + i));
+        const __m256i red = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[2] + i));
+        const __m256i alpha = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[3] + i));
+
+        storeMergedPlanesEPI8(pDest + i, blue, green, red, alpha);
+    }
+
+    _mm256_zeroupper();
+
+    const uint8_t* const pTailPlanes[MAX_CHANNEL_COUNT] = { pPlanes[0] + i, pPlanes[1] + i, pPlanes[2] + i, pPlanes[3] + i };
+    mergeFromPlanesScalar(pTailPlanes, pDest + i, pixelCount - i);
+}
+
+void SplitToPlanesSIMD(const Pixel* pSrc, uint8_t* const pOutPlanes[MAX_CHANNEL_COUNT], const int64_t pixelCount)
+{
+    assert(pSrc != nullptr);
+    assert(pOutPlanes != nullptr);
+    assert(pixelCount >= 0);
+
+    if (IsAVX2Supported())
+    {
+        splitToPlanesAVX2(pSrc, pOutPlanes, pixelCount);
+    }
+    else
+    {
+        splitToPlanesScalar(pSrc, pOutPlanes, pixelCount);
+    }
+}
+
+void MergeFromPlanesSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount)
+{
+    assert(pPlanes != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    if (IsAVX2Supported())
+    {
+        mergeFromPlanesAVX2(pPlanes, pDest, pixelCount);
+    }
+    else
+    {
+        mergeFromPlanesScalar(pPlanes, pDest, pixelCount);
+    }
+}
+
+// plane lookups
+
+void BuildPlaneLookup(PlaneLookup& outLookup, const uint8_t lookupTable[TABLE_SIZE])
+{
+    constexpr int rowCount = TABLE_SIZE / 16;
+
+    memcpy(outLookup.Table, lookupTable, TABLE_SIZE);
+
+    // an index of the lower half hits the rows 0 to its own, the upper half starts over at row 8
+    for (int row = 0; row < rowCount; ++row)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint8_t previous = row % (rowCount / 2) == 0 ? 0 : lookupTable[(row - 1) * 16 + i];
+
+            outLookup.ShuffleTables[row][i] = lookupTable[row * 16 + i] ^ previous;
+        }
+    }
+}
+
+static void storeLookedUpPlanesScalar(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount, const PlaneLookup lookups[COLOR_COUNT])
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        Pixel pixel;
+        pixel.rgba.b = lookups[0].Table[pPlanes[0][i]];
+        pixel.rgba.g = lookups[1].Table[pPlanes[1][i]];
+        pixel.rgba.r = lookups[2].Table[pPlanes[2][i]];
+        pixel.rgba.a = pPlanes[3][i];
+
+        pDest[i] = pixel;
+    }
+}
+
+// 32 lookups. index - 16k has bit 7 clear for the rows k up to the row of the index and selects its column,
+// pshufb zeroes the rows above. the upper half runs the same on index - 128, bit 7 of the index picks the half
+SIMD_TARGET_AVX2 static inline __m256i lookUpEPI8(const __m256i indices, const PlaneLookup& lookup)
+{
+    const __m256i step = _mm256_set1_epi8(16);
+
+    __m256i lowIndices = indices;
+    __m256i highIndices = _mm256_xor_si256(indices, _mm256_set1_epi8(static_cast<char>(0x80)));
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+
+    for (int row = 0; row < TABLE_SIZE / 32; ++row)
+    {
+        const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lookup.ShuffleTables[row])));
+        const __m256i highTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lookup.ShuffleTables[row + TABLE_SIZE / 32])));
+
+        low = _mm256_xor_si256(low, _mm256_shuffle_epi8(lowTable, lowIndices));
+        high = _mm256_xor_si256(high, _mm256_shuffle_epi8(highTable, highIndices));
+
+        lowIndices = _mm256_sub_epi8(lowIndices, step);
+        highIndices = _mm256_sub_epi8(highIndices, step);
+    }
+
+    return _mm256_blendv_epi8(low, high, indices);
+}
+
+SIMD_TARGET_AVX2 static void storeLookedUpPlanesAVX2(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount, const PlaneLookup lookups[COLOR_COUNT])
+{
+    int64_t i = 0;
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        const __m256i blue = lookUpEPI8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[0] + i)), lookups[0]);
+        const __m256i green = lookUpEPI8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[1] + i)), lookups[1]);
+        const __m256i red = lookUpEPI8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[2] + i)), lookups[2]);
+        const __m256i alpha = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPlanes[3] + i));
+
+        storeMergedPlanesEPI8(pDest + i, blue, green, red, alpha);
+    }
+
+    _mm256_zeroupper();
+
+    const uint8_t* const pTailPlanes[MAX_CHANNEL_COUNT] = { pPlanes[0] + i, pPlanes[1] + i, pPlanes[2] + i, pPlanes[3] + i };
+    storeLookedUpPlanesScalar(pTailPlanes, pDest + i, pixelCount - i, lookups);
+}
+
+void StoreLookedUpPlanesSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount, const PlaneLookup lookups[COLOR_COUNT])
+{
+    assert(pPlanes != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    if (IsAVX2Supported())
+    {
+        storeLookedUpPlanesAVX2(pPlanes, pDest, pixelCount, lookups);
+    }
+    else
+    {
+        storeLookedUpPlanesScalar(pPlanes, pDest, pixelCount, lookups);
+    }
+}
+
+// gray plane
+
+static void computeGrayPlaneScalar(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], uint8_t* pDest, const int64_t pixelCount)
+{
+    for (int64_t i = 0; i < pixelCount; ++i)
+    {
+        Pixel pixel;
+        pixel.rgba.b = pPlanes[0][i];
+        pixel.rgba.g = pPlanes[1][i];
+        pixel.rgba.r = pPlanes[2][i];
+        pixel.rgba.a = 0;
+
+        pDest[i] = ComputeGrayBrightness(pixel);
+    }
+}
+
+// lumas of the lower 8 bytes as epi32, the products are added in the order of ComputeGrayBrightness so that the floats round the same
+SIMD_TARGET_AVX2 static inline __m256i computeGrayEPI32(const __m128i blues, const __m128i greens, const __m128i reds)
+{
+    const __m256 blue = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(blues));
+    const __m256 green = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(greens));
+    const __m256 red = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(reds));
+
+    __m256 gray = _mm256_add_ps(_mm256_mul_ps(red, _mm256_set1_ps(0.299f)), _mm256_mul_ps(green, _mm256_set1_ps(0.587f)));
+    gray = _mm256_add_ps(gray, _mm256_mul_ps(blue, _mm256_set1_ps(0.114f)));
+    gray = _mm256_min_ps(gray, _mm256_set1_ps(MAX_BRIGHTNESS_F));
+
+    return _mm256_cvttps_epi32(gray);
+}
+
+SIMD_TARGET_AVX2 static inline __m256i computeGrayEPI32(const uint8_t* pBlue, const uint8_t* pGreen, const uint8_t* pRed)
+{
+    return computeGrayEPI32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pBlue)),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pGreen)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pRed)));
+}
+
+SIMD_TARGET_AVX2 static void computeGrayPlaneAVX2(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], uint8_t* pDest, const int64_t pixelCount)
+{
+    const uint8_t* const pBlue = pPlanes[0];
+    const uint8_t* const pGreen = pPlanes[1];
+    const uint8_t* const pRed = pPlanes[2];
+
+    int64_t i = 0;
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        // 4 x 8 lumas pack like 4 x 2 pixels
+        const __m256i grays = packPixelsEPI32(computeGrayEPI32(pBlue + i, pGreen + i, pRed + i), computeGrayEPI32(pBlue + i + 8, pGreen + i + 8, pRed + i + 8),
+            computeGrayEPI32(pBlue + i + 16, pGreen + i + 16, pRed + i + 16), computeGrayEPI32(pBlue + i + 24, pGreen + i + 24, pRed + i + 24));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), grays);
+    }
+
+    _mm256_zeroupper();
+
+    const uint8_t* const pTailPlanes[MAX_CHANNEL_COUNT] = { pBlue + i, pGreen + i, pRed + i, pPlanes[3] + i };
+    computeGrayPlaneScalar(pTailPlanes, pDest + i, pixelCount - i);
+}
+
+void ComputeGrayPlaneSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], uint8_t* pDest, const int64_t pixelCount)
+{
+    assert(pPlanes != nullptr);
+    assert(pDest != nullptr);
+    assert(pixelCount >= 0);
+
+    if (IsAVX2Supported())
+    {
+        computeGrayPlaneAVX2(pPlanes, pDest, pixelCount);
+    }
+    else
+    {
+        computeGrayPlaneScalar(pPlanes, pDest, pixelCount);
+    }
+}
+
+// fused chain. an operator transforms one pixel for the scalar loop and a block of 32 for the vector loop,
+// OperatorChain inlines the operators one after another so that every pixel is loaded and stored once whatever the stages
+
+// 32 lumas of a block, 4 x 8 lumas pack like 4 x 2 pixels
+SIMD_TARGET_AVX2 static inline __m256i computeGrayBlockEPI8(const PixelBlock& block)
+{
+    const __m128i blues01 = _mm256_castsi256_si128(block.Blue);
+    const __m128i greens01 = _mm256_castsi256_si128(block.Green);
+    const __m128i reds01 = _mm256_castsi256_si128(block.Red);
+    const __m128i blues23 = _mm256_extracti128_si256(block.Blue, 1);
+    const __m128i greens23 = _mm256_extracti128_si256(block.Green, 1);
+    const __m128i reds23 = _mm256_extracti128_si256(block.Red, 1);
+
+    return packPixelsEPI32(computeGrayEPI32(blues01, greens01, reds01),
+        computeGrayEPI32(_mm_srli_si128(blues01, 8), _mm_srli_si128(greens01, 8), _mm_srli_si128(reds01, 8)),
+        computeGrayEPI32(blues23, greens23, reds23),
+        computeGrayEPI32(_mm_srli_si128(blues23, 8), _mm_srli_si128(greens23, 8), _mm_srli_si128(reds23, 8)));
+}
+
+struct GrayScaleOperator
+{
+    static inline void Apply(Pixel& pixel, const FusedChainTables&, Pixel*, const int64_t)
+    {
+        const uint8_t grayBrightness = ComputeGrayBrightness(pixel);
+
+        pixel.rgba.b = grayBrightness;
+        pixel.rgba.g = grayBrightness;
+        pixel.rgba.r = grayBrightness;
+    }
+
+    SIMD_TARGET_AVX2 static inline void Apply(PixelBlock& block, const FusedChainTables&, Pixel*, const int64_t)
+    {
+        block.Blue = computeGrayBlockEPI8(block);
+        block.Green = block.Blue;
+        block.Red = block.Blue;
+    }
+};
+
+// bSINGLE_CHANNEL when the colors of the pixels are equal and share the lookup, the blue one serves all three
+template<int LOOKUP, bool bSINGLE_CHANNEL>
+struct LookupOperator
+{
+    static inline void Apply(Pixel& pixel, const FusedChainTables& tables, Pixel*, const int64_t)
+    {
+        const PlaneLookup* const lookups = tables.Lookups[LOOKUP];
+
+        if (bSINGLE_CHANNEL)
+        {
+            const uint8_t value = lookups[0].Table[pixel.rgba.b];
+
+            pixel.rgba.b = value;
+            pixel.rgba.g = value;
+            pixel.rgba.r = value;
+
+            return;
+        }
+
+        pixel.rgba.b = lookups[0].Table[pixel.rgba.b];
+        pixel.rgba.g = lookups[1].Table[pixel.rgba.g];
+        pixel.rgba.r = lookups[2].Table[pixel.rgba.r];
+    }
+
+    SIMD_TARGET_AVX2 static inline void Apply(PixelBlock& block, const FusedChainTables& tables, Pixel*, const int64_t)
+    {
+        const PlaneLookup* const lookups = tables.Lookups[LOOKUP];
+
+        if (bSINGLE_CHANNEL)
+        {
+            block.Blue = lookUpEPI8(block.Blue, lookups[0]);
+            block.Green = block.Blue;
+            block.Red = block.Blue;
+
+            return;
+        }
+
+        block.Blue = lookUpEPI8(block.Blue, lookups[0]);
+        block.Green = lookUpEPI8(block.Green, lookups[1]);
+        block.Red = lookUpEPI8(block.Red, lookups[2]);
+    }
+};
+
+// the pixels as they are at this point go to the buffered image
+struct StoreBufferedOperator
+{
+    static inline void Apply(Pixel& pixel, const FusedChainTables&, Pixel* pBuffered, const int64_t index)
+    {
+        pBuffered[index] = pixel;
+    }
+
+    SIMD_TARGET_AVX2 static inline void Apply(PixelBlock& block, const FusedChainTables&, Pixel* pBuffered, const int64_t index)
+    {
+        storePixelBlockEPI8(pBuffered + index, block);
+    }
+};
+
+template<typename... Operators>
+struct OperatorChain;
+
+template<>
+struct OperatorChain<>
+{
+    static inline void Apply(Pixel&, const FusedChainTables&, Pixel*, const int64_t)
+    {
+
+    }
+
+    SIMD_TARGET_AVX2 static inline void Apply(PixelBlock&, const FusedChainTables&, Pixel*, const int64_t)
+    {
+
+    }
+};
+
+template<typename Operator, typename... RestOperators>
+struct OperatorChain<Operator, RestOperators...>
+{
+    static inline void Apply(Pixel& pixel, const FusedChainTables& tables, Pixel* pBuffered, const int64_t index)
+    {
+        Operator::Apply(pixel, tables, pBuffered, index);
+        OperatorChain<RestOperators...>::Apply(pixel, tables, pBuffered, index);
+    }
+
+    SIMD_TARGET_AVX2 static inline void Apply(PixelBlock& block, const FusedChainTables& tables, Pixel* pBuffered, const int64_t index)
+    {
+        Operator::Apply(block, tables, pBuffered, index);
+        OperatorChain<RestOperators...>::Apply(block, tables, pBuffered, index);
+    }
+};
+
+// one and three channel images have no alpha, their pixels come out opaque
+template<int CHANNEL_COUNT, typename... Operators>
+struct FusedChain
+{
+    static void ExecuteScalar(const Pixel* pSrc, Pixel* pBuffered, Pixel* pResult, const int64_t pixelCount, const FusedChainTables& tables)
+    {
+        constexpr bool bHasAlpha = CHANNEL_COUNT == 2 || CHANNEL_COUNT == MAX_CHANNEL_COUNT;
+
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            Pixel pixel = pSrc[i];
+            if (!bHasAlpha)
+            {
+                pixel.rgba.a = UINT8_MAX;
+            }
+
+            OperatorChain<Operators...>::Apply(pixel, tables, pBuffered, i);
+
+            pResult[i] = pixel;
+        }
+    }
+
+    SIMD_TARGET_AVX2 static void ExecuteAVX2(const Pixel* pSrc, Pixel* pBuffered, Pixel* pResult, const int64_t pixelCount, const FusedChainTables& tables)
+    {
+        constexpr bool bHasAlpha = CHANNEL_COUNT == 2 || CHANNEL_COUNT == MAX_CHANNEL_COUNT;
+
+        int64_t i = 0;
+        for (; i + 32 <= pixelCount; i += 32)
+        {
+            PixelBlock block;
+            loadPixelBlockEPI8(pSrc + i, block);
+            if (!bHasAlpha)
+            {
+                block.Alpha = _mm256_set1_epi8(static_cast<char>(UINT8_MAX));
+            }
+
+            OperatorChain<Operators...>::Apply(block, tables, pBuffered, i);
+
+            storePixelBlockEPI8(pResult + i, block);
+        }
+
+        _mm256_zeroupper();
+
+        ExecuteScalar(pSrc + i, pBuffered != nullptr ? pBuffered + i : nullptr, pResult + i, pixelCount - i, tables);
+    }
+};
+
+template<int CHANNEL_COUNT, typename... Operators>
+static FusedChainKernel selectFusedChain(const bool bSIMD)
+{
+    if (bSIMD && IsAVX2Supported())
+    {
+        return &FusedChain<CHANNEL_COUNT, Operators...>::ExecuteAVX2;
+    }
+
+    return &FusedChain<CHANNEL_COUNT, Operators...>::ExecuteScalar;
+}
+
+// HeadOperators run before the lookups, the gray scale or nothing
+template<int CHANNEL_COUNT, bool bSINGLE_CHANNEL, typename... HeadOperators>
+static FusedChainKernel selectFusedStages(const bool bRemap, const bool bBuffered, const bool bSIMD)
+{
+    using RemapOperator = LookupOperator<FUSED_LOOKUP_REMAP, bSINGLE_CHANNEL>;
+    using AdjustmentOperator = LookupOperator<FUSED_LOOKUP_ADJUSTMENT, bSINGLE_CHANNEL>;
+
+    // nothing is kept in between, the adjustment lookups already hold the remap
+    if (!bBuffered)
+    {
+        return selectFusedChain<CHANNEL_COUNT, HeadOperators..., AdjustmentOperator>(bSIMD);
+    }
+
+    if (!bRemap)
+    {
+        return selectFusedChain<CHANNEL_COUNT, HeadOperators..., StoreBufferedOperator, AdjustmentOperator>(bSIMD);
+    }
+
+    return selectFusedChain<CHANNEL_COUNT, HeadOperators..., RemapOperator, StoreBufferedOperator, AdjustmentOperator>(bSIMD);
+}
+
+// one and two channel images are gray, their colors are equal from the start
+template<int CHANNEL_COUNT>
+static FusedChainKernel selectGrayFusedChain(const bool bRemap, const bool bBuffered, const bool bUniformLookups, const bool bSIMD)
+{
+    if (bUniformLookups)
+    {
+        return selectFusedStages<CHANNEL_COUNT, true>(bRemap, bBuffered, bSIMD);
+    }
+
+    return selectFusedStages<CHANNEL_COUNT, false>(bRemap, bBuffered, bSIMD);
+}
+
+template<int CHANNEL_COUNT>
+static FusedChainKernel selectColorFusedChain(const bool bGrayScale, const bool bRemap, const bool bBuffered, const bool bUniformLookups, const bool bSIMD)
+{
+    if (!bGrayScale)
+    {
+        return selectFusedStages<CHANNEL_COUNT, false>(bRemap, bBuffered, bSIMD);
+    }
+
+    if (bUniformLookups)
+    {
+        return selectFusedStages<CHANNEL_COUNT, true, GrayScaleOperator>(bRemap, bBuffered, bSIMD);
+    }
+
+    return selectFusedStages<CHANNEL_COUNT, false, GrayScaleOperator>(bRemap, bBuffered, bSIMD);
+}
+
+FusedChainKernel SelectFusedChainKernel(const int channelCount, const bool bGrayScale, const bool bRemap, const bool bBuffered, const bool bUniformLookups, const bool bSIMD)
+{
+    switch (channelCount)
+    {
+    case 1:
+        return selectGrayFusedChain<1>(bRemap, bBuffered, bUniformLookups, bSIMD);
+
+    case 2:
+        return selectGrayFusedChain<2>(bRemap, bBuffered, bUniformLookups, bSIMD);
+
+    case 3:
+        return selectColorFusedChain<3>(bGrayScale, bRemap, bBuffered, bUniformLookups, bSIMD);
+
+    case 4:
+        return selectColorFusedChain<4>(bGrayScale, bRemap, bBuffered, bUniformLookups, bSIMD);
+
+    default:
+        assert(false);
+        break;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Image.h"
+
+// vectorized powf(x, y) is built from Cephes style logf / expf polynomials.
+// for x in [0, 1] and y in [0.04, 25] the relative error against the double precision pow is
+// below SIMD_POW_MAX_RELATIVE_ERROR_F, so the quantized 8 bit result differs from the scalar path by at most 1
+constexpr float SIMD_POW_MAX_RELATIVE_ERROR_F = 1e-5f;
+
+bool IsAVX2Supported();
+
+// brightness * ratio -> clamp [0, 1] -> pow(gamma), alpha channel is left untouched
+void ModifyBrightnessSIMD(PixelF* pPixels, const int64_t pixelCount, const float brightnessRatio, const float gammaScaler);
+
+// stb channel order (gray, gray alpha, rgb, rgba) -> bgra, one kernel per channel count
+void ExpandToBGRA(const uint8_t* pSrc, Pixel* pDest, const int64_t pixelCount, const int channelCount);
+
+// clahe interpolation of a run of pixels between two tile centers.
+// the tables hold COLOR_COUNT lookups of each tile, already blended vertically and scaled by CLAHE_WEIGHT_ONE,
+// pWeights the weight of the right tile per pixel. gray sources read the first table only
+void InterpolateTileLookupsSIMD(const Pixel* pSrc, Pixel* pDest, const int64_t pixelCount, const uint32_t* pLeftTables, const uint32_t* pRightTables, const int32_t* pWeights, const bool bGrayScale);
+
+// separable filter passes, see ExecuteBoxBlur / ExecuteGaussianBlur.
+// a row pass reads width + 2 * radius pixels from pPaddedSrc with the border pixels already repeated.
+// a column pass reads ppPaddedRows[y] to ppPaddedRows[y + 2 * radius] for output row y, the pointers repeat the border rows.
+// the weights of a convolution are symmetric around pWeights[radius].
+// pSums holds outView.Width * MAX_CHANNEL_COUNT sums, pScratch (width + 2 * radius) float pixels for a row and
+// (2 * radius + 1) * outView.Width for the columns
+void BoxFilterRowSIMD(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const int radius);
+void BoxFilterColumnsSIMD(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const int radius, uint32_t* pSums);
+void ConvolveRowSIMD(const Pixel* pPaddedSrc, Pixel* pDest, const int width, const float* pWeights, const int radius, PixelF* pScratch);
+void ConvolveColumnsSIMD(const Pixel* const* ppPaddedRows, const MutableImageView& outView, const float* pWeights, const int radius, PixelF* pScratch);
+
+// src + amount * (src - blurred), alpha is left untouched
+void SharpenSIMD(const Pixel* pSrc, const Pixel* pBlurred, Pixel* pDest, const int64_t pixelCount, const float amount);
+
+// bgra <-> b, g, r, a planes of a run of pixels, 32 pixels per 4 x 4 transpose of 64 bit groups
+void SplitToPlanesSIMD(const Pixel* pSrc, uint8_t* const pOutPlanes[MAX_CHANNEL_COUNT], const int64_t pixelCount);
+void MergeFromPlanesSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount);
+
+// 8 bit lookup table as 16 entry pshufb tables, 32 lookups per 8 + 8 shuffles instead of a load per byte.
+// row k of each half holds entries 16k to 16k + 15 xored with the previous row, the shuffles of a half add up to the entry
+struct PlaneLookup
+{
+    alignas(16) uint8_t ShuffleTables[TABLE_SIZE / 16][16];
+
+    uint8_t Table[TABLE_SIZE];
+};
+
+void BuildPlaneLookup(PlaneLookup& outLookup, const uint8_t lookupTable[TABLE_SIZE]);
+
+// looked up color planes interleaved with the alpha plane as it is
+void StoreLookedUpPlanesSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], Pixel* pDest, const int64_t pixelCount, const PlaneLookup lookups[COLOR_COUNT]);
+
+// luma of the color planes, the same as ComputeGrayBrightness
+void ComputeGrayPlaneSIMD(const uint8_t* const pPlanes[MAX_CHANNEL_COUNT], uint8_t* pDest, const int64_t pixelCount);
+
+enum EFusedLookup
+{
+    FUSED_LOOKUP_REMAP,
+    FUSED_LOOKUP_ADJUSTMENT,
+    FUSED_LOOKUP_COUNT
+};
+
+struct FusedChainTables
+{
+    PlaneLookup Lookups[FUSED_LOOKUP_COUNT][COLOR_COUNT];
+};
+
+// gray scale -> remap -> buffered -> adjustment as a single loop, the operators are composed at compile time.
+// pBuffered is nullptr when nothing is kept before the adjustment, pResult may be pSrc
+using FusedChainKernel = void (*)(const Pixel* pSrc, Pixel* pBuffered, Pixel* pResult, const int64_t pixelCount, const FusedChainTables& tables);
+
+// the instantiation for the channel count and the stages. without buffered pixels the adjustment lookups have to hold the remap.
+// bUniformLookups when the three colors share every lookup, gray pixels then look up a single channel.
+// one and three channel results are opaque, the scalar loop runs when bSIMD is false or the cpu has no avx2
+FusedChainKernel SelectFusedChainKernel(const int channelCount, const bool bGrayScale, const bool bRemap, const bool bBuffered, const bool bUniformLookups, const bool bSIMD);
@@ -2,35 +2,90 @@
 
 constexpr float DEFAULT_BRIGHTNESS_RATIO_F = 1.f;
 constexpr float DEFAULLT_GAMMA_SCALER_F = 1.f;
+constexpr float DEFAULT_FILTER_RADIUS_F = 2.f;
+constexpr float DEFAULT_SHARPEN_AMOUNT_F = 1.f;
 
 ImageProcessor::ImageProcessor()
     : mOriginalImage()
-    , mBufferedImage()
-    , mNormalizedPixels(nullptr)
-    , mResultImage()
+    , mDisplayedImage()
+    , mDisplayedStages()
+    , mProfileZones()
+    , mLastProfileRefreshTime()
+    , mbRefinementPending(false)
+    , mLastAdjustmentTime()
+    , mDisplayWidth(0)
+    , mDisplayHeight(0)
+    , mbAdjusting(false)
+    , mFilterRadius(DEFAULT_FILTER_RADIUS_F)
+    , mSharpenAmount(DEFAULT_SHARPEN_AMOUNT_F)
     , mBrightnessRatio(DEFAULT_BRIGHTNESS_RATIO_F)
     , mGammaScaler(DEFAULT_BRIGHTNESS_RATIO_F)
     , mFlags({ 0, })
     , mDirtyFlags({ 0, })
+    , mRefImagePath()
+    , mLatestSerial(0)
+    , mLatestUpstreamSerial(0)
+    , mUpstreamKey(0)
+    , mRequestMutex()
+    , mRequestCondition()
+    , mpPendingRequest()
+    , mbStopping(false)
+    , mResultMailbox()
+    , mStageGraph(static_cast<size_t>(DEFAULT_STAGE_MEMORY_BUDGET_MB) * 1024 * 1024)
+    , mFilteredImageStage("filtered image", mStageGraph)
+    , mRemapTableStage("remap table", mStageGraph)
+    , mClaheLookupsStage("clahe lookups", mStageGraph)
+    , mAdjustmentTableStage("adjustment table", mStageGraph)
+    , mBufferedImageStage("buffered image", mStageGraph)
+    , mResultImageStage("result image", mStageGraph)
+    , mPreviewLevelStage("preview level", mStageGraph)
+    , mSourceKey(0)
+    , mpSourceImage(nullptr)
+    , mRemapTableKey(0)
+    , mpRemapTable(nullptr)
+    , mpClaheLookups(nullptr)
+    , mAdjustmentTableKey(0)
+    , mpAdjustmentTable(nullptr)
+    , mSourceVersion(0)
+    , mMatchingCaches()
+    , mWorker()
 {
     ImPlot::CreateContext();
+
+    // every member the worker touches is constructed by now
+    mWorker = std::thread(&ImageProcessor::runWorker, this);
 }
 
 ImageProcessor::~ImageProcessor()
 {
-    ImPlot::DestroyContext();
+    {
+        std::lock_guard<std::mutex> lock(mRequestMutex);
 
-    delete[] mNormalizedPixels;
+        mbStopping = true;
+
+        // the request in flight stops at its next strip
+        ++mLatestSerial;
+        ++mLatestUpstreamSerial;
+    }
+    mRequestCondition.notify_one();
+
+    mWorker.join();
+
+    ImPlot::DestroyContext();
 }
 
-Image& ImageProcessor::GetProcessedImage()
+const Image& ImageProcessor::GetProcessedImage() const
 {
-    return mResultImage;
+    // the original until the first result arrives
+    return !mDisplayedImage.IsEmpty() ? mDisplayedImage : mOriginalImage;
 }
 
 void ImageProcessor::Update()
 {
-    if (!mDirtyFlags.flags)
+    PROFILE_SCOPE("ImageProcessor::Update");
+
+    const bool bDirty = mDirtyFlags.flags != EUIConstant::NONE;
+    if (!bDirty && !mbRefinementPending)
     {
         return;
     }
@@ -38,62 +93,98 @@ void ImageProcessor::Update()
     if (mDirtyFlags.bits.restoring)
     {
         restoreDefaultAdjustment();
+    }
+
+    if (mOriginalImage.IsEmpty())
+    {
+        mDirtyFlags.flags = EUIConstant::NONE;
+        mbRefinementPending = false;
 
         return;
     }
 
-    if (mDirtyFlags.partition.mode | mDirtyFlags.partition.histogramProcessing)
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    UIFlags otherDirtyFlags = mDirtyFlags;
+    otherDirtyFlags.partition.adjustment = 0;
+
+    // slider ticks only change the adjustment, the level closest to the display is enough until input rests
+    const bool bAdjustmentOnly = mDirtyFlags.partition.adjustment != 0 && otherDirtyFlags.flags == EUIConstant::NONE;
+    if (bAdjustmentOnly && mbAdjusting)
     {
-        mBufferedImage = mOriginalImage;
-        if (mFlags.bits.grayScale)
+        mLastAdjustmentTime = now;
+
+        // the pending refinement is stale, it restarts from the new parameters once input rests
+        postRequest(true);
+        mbRefinementPending = true;
+
+        mDirtyFlags.flags = EUIConstant::NONE;
+
+        return;
+    }
+
+    if (!bDirty && mbAdjusting && now - mLastAdjustmentTime < std::chrono::milliseconds(PREVIEW_REFINE_IDLE_MS))
+    {
+        return;
+    }
+
+    // a dialog can not be opened from the worker, the reference is chosen before the request is posted
+    const bool bMatching = (mFlags.flags & MASK_HISTOGRAM_PROCESSING) == EUIConstant::HISTOGRAM_PROCESSING_MATCHING;
+    if (bMatching && mDirtyFlags.partition.histogramProcessing)
+    {
+        FileDialog& fileDialog = *FileDialog::GetInstance();
+        if (!fileDialog.TryOpenFileDialog(mRefImagePath, EFileDialogConstant::DEFAULT_PATH_LEN))
         {
-            convertToGrayScale(mBufferedImage);
+            mFlags.partition.histogramProcessing = false;
         }
+    }
 
-        switch (mFlags.flags & MASK_HISTOGRAM_PROCESSING)
-        {
-        case EUIConstant::HISTOGRAM_PROCESSING_EQUALIZATION:
-            executeEqualization();
-            break;
+    postRequest(false);
 
-        case EUIConstant::HISTOGRAM_PROCESSING_MATCHING:
-            executeHistogramMatching();
-            break;
+    mDirtyFlags.flags = EUIConstant::NONE;
+    mbRefinementPending = false;
+}
 
-        default:
-            // no action
-            break;
-        }
+bool ImageProcessor::PickUpResult()
+{
+    std::unique_ptr<ProcessingResult> pResult = mResultMailbox.Take();
+    if (pResult == nullptr)
+    {
+        return false;
     }
 
-    ProcessingFunc processingFuncs[] = {
-        &ImageProcessor::normalize,
-        &ImageProcessor::modifyBrightness,
-        &ImageProcessor::storeResult
-    };
+    // finished just before another image was registered
+    if (mOriginalImage.IsEmpty() || pResult->SourceVersion != mOriginalImage.GetVersion())
+    {
+        return false;
+    }
 
-    for (int i = 0; i < sizeof(processingFuncs) / sizeof(ProcessingFunc); ++i)
+    // a newer request decides on its own whether the reference is readable
+    if (pResult->bRemapFailed && pResult->Serial == mLatestSerial.load())
     {
-        (this->*processingFuncs[i])();
+        mFlags.partition.histogramProcessing = false;
     }
 
-    mDirtyFlags.flags = EUIConstant::NONE;
+    mDisplayedImage = std::move(pResult->ResultImage);
+    mDisplayedStages = std::move(pResult->Stages);
+
+    return true;
 }
 
 void ImageProcessor::RegisterImage(Image&& other)
 {
     mOriginalImage = std::move(other);
-    mBufferedImage = mOriginalImage;
-
-    delete[] mNormalizedPixels;
 
-    mNormalizedPixels = new PixelF[mOriginalImage.Width * mOriginalImage.Height];
+    // the worker clears its stages when the next request comes with the new source
+    mDisplayedImage = Image();
+    mbRefinementPending = false;
 
     const UIFlags tmpFlags = mFlags;
     mFlags.flags = EUIConstant::NONE;
     mFlags.partition.hardwareAcceleration = tmpFlags.partition.hardwareAcceleration;
 
     restoreDefaultAdjustment();
+    mDirtyFlags.bits.restoring = true;
 }
 
 void ImageProcessor::DrawControlPanel()
@@ -102,7 +193,9 @@ void ImageProcessor::DrawControlPanel()
     {
         if (ImPlot::BeginPlot("Histogram"))
         {
-            const Histogram hist = mResultImage.GetHistogram();
+            // cached by the worker before the result was posted
+            Histogram hist;
+            GetProcessedImage().GetHistogram(hist);
 
             ImPlot::SetupAxes("Brightness", "Frequency", 0, ImPlotAxisFlags_AutoFit);
 
@@ -121,9 +214,9 @@ void ImageProcessor::DrawControlPanel()
         ImGui::SeparatorText("Hardware Acceleration");
         ImGui::BeginGroup();
         {
-            ImGui::CheckboxFlags("SIMD", &mFlags.flags, EUIConstant::HW_SIMD);
+            mDirtyFlags.partition.hardwareAcceleration += ImGui::CheckboxFlags("SIMD", &mFlags.flags, EUIConstant::HW_SIMD);
             ImGui::SameLine();
-            ImGui::CheckboxFlags("CUDA", &mFlags.flags, EUIConstant::HW_CUDA);
+            mDirtyFlags.partition.hardwareAcceleration += ImGui::CheckboxFlags("CUDA", &mFlags.flags, EUIConstant::HW_CUDA);
         }
         ImGui::EndGroup();
 
@@ -140,6 +233,7 @@ void ImageProcessor::DrawControlPanel()
             UIFlags nextFlags = mFlags;
             nextFlags.bits.equalization = false;
             nextFlags.bits.matching = false;
+            nextFlags.bits.clahe = false;
 
             mDirtyFlags.partition.histogramProcessing += ImGui::RadioButton("None", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
             ImGui::SameLine();
@@ -150,6 +244,42 @@ void ImageProcessor::DrawControlPanel()
             nextFlags.bits.equalization = false;
             nextFlags.bits.matching = true;
             mDirtyFlags.partition.histogramProcessing += ImGui::RadioButton("Macthing(Choose image to match if dialogbox open)", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+
+            nextFlags.bits.matching = false;
+            nextFlags.bits.clahe = true;
+            mDirtyFlags.partition.histogramProcessing += ImGui::RadioButton("CLAHE", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+        }
+        ImGui::EndGroup();
+
+        ImGui::SeparatorText("Filter");
+        ImGui::BeginGroup();
+        {
+            UIFlags nextFlags = mFlags;
+            nextFlags.bits.gaussianBlur = false;
+            nextFlags.bits.boxBlur = false;
+            nextFlags.bits.unsharpMask = false;
+
+            mDirtyFlags.partition.filter += ImGui::RadioButton("No Filter", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+            ImGui::SameLine();
+
+            nextFlags.bits.gaussianBlur = true;
+            mDirtyFlags.partition.filter += ImGui::RadioButton("Gaussian Blur", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+            ImGui::SameLine();
+
+            nextFlags.bits.gaussianBlur = false;
+            nextFlags.bits.boxBlur = true;
+            mDirtyFlags.partition.filter += ImGui::RadioButton("Box Blur", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+            ImGui::SameLine();
+
+            nextFlags.bits.boxBlur = false;
+            nextFlags.bits.unsharpMask = true;
+            mDirtyFlags.partition.filter += ImGui::RadioButton("Unsharp Mask", reinterpret_cast<int*>(&mFlags), nextFlags.flags);
+
+            ImGui::Text("Radius");
+            mDirtyFlags.partition.filter += ImGui::SliderFloat("[0.5, 50] px", &mFilterRadius, 0.5f, 50.f, "%.1f");
+
+            ImGui::Text("Sharpen Amount");
+            mDirtyFlags.partition.filter += ImGui::SliderFloat("[0, 4]", &mSharpenAmount, 0.f, 4.f, "%.2f");
         }
         ImGui::EndGroup();
 
@@ -160,199 +290,692 @@ void ImageProcessor::DrawControlPanel()
 
             ImGui::Text("Brightness");
             mDirtyFlags.partition.adjustment += ImGui::SliderFloat("[0, 2] * 100%", &mBrightnessRatio, 0, 2.f, "%.2f");
+            mbAdjusting = ImGui::IsItemActive();
 
             ImGui::Text("Gamma");
             mDirtyFlags.partition.adjustment += ImGui::SliderFloat("[0.04, 25]", &mGammaScaler, 0.04f, 25.f, "%.3f");
+            mbAdjusting = mbAdjusting || ImGui::IsItemActive();
         }
         ImGui::EndGroup();
+
+        drawStageStatistics();
+        drawPoolStatistics();
+        drawProfilerStatistics();
     }
     ImGui::End();
 }
 
-void ImageProcessor::restoreDefaultAdjustment()
+void ImageProcessor::SetDisplaySize(const int width, const int height)
 {
-    mResultImage = mBufferedImage;
+    assert(width >= 0);
+    assert(height >= 0);
 
-    mDirtyFlags.flags = EUIConstant::NONE;
+    mDisplayWidth = width;
+    mDisplayHeight = height;
+}
 
+void ImageProcessor::restoreDefaultAdjustment()
+{
     mBrightnessRatio = DEFAULT_BRIGHTNESS_RATIO_F;
     mGammaScaler = DEFAULT_BRIGHTNESS_RATIO_F;
 }
 
-void ImageProcessor::executeEqualization()
+void ImageProcessor::postRequest(const bool bPreview)
 {
-    Histogram hist = mBufferedImage.GetHistogram();
+    assert(!mOriginalImage.IsEmpty());
 
-    const int pixelCount = mBufferedImage.Width * mBufferedImage.Height;
+    // requests are only posted from the ui thread
+    const uint64_t serial = mLatestSerial.load() + 1;
 
-    if (mFlags.bits.cuda)
-    {
+    const uint32_t histogramProcessing = mFlags.flags & MASK_HISTOGRAM_PROCESSING;
+
+    // the reference is only read while matching
+    const std::string refImagePath = histogramProcessing == EUIConstant::HISTOGRAM_PROCESSING_MATCHING ? std::string(mRefImagePath) : std::string();
 
+    StageKey upstreamKey;
+    upstreamKey.Add(mOriginalImage.GetVersion()).Add(mFlags.bits.grayScale).Add(histogramProcessing).Add(mFlags.bits.cuda).Add(refImagePath);
+
+    // the filter sliders only matter while a filter is set
+    const uint32_t filter = mFlags.flags & MASK_FILTER;
+    if (filter != EUIConstant::NONE)
+    {
+        upstreamKey.Add(filter).Add(mFilterRadius).Add(mSharpenAmount);
     }
-    else
+
+    // slider ticks keep the pass that fills the buffered image running, the previews are made from it
+    const bool bUpstreamChanged = upstreamKey.GetValue() != mUpstreamKey;
+    mUpstreamKey = upstreamKey.GetValue();
+
+    const uint64_t upstreamSerial = bUpstreamChanged ? serial : mLatestUpstreamSerial.load();
+
+    std::unique_ptr<ProcessingRequest> pRequest(new ProcessingRequest{
+        serial,
+        CancellationToken{ &mLatestSerial, serial },
+        CancellationToken{ &mLatestUpstreamSerial, upstreamSerial },
+        mOriginalImage,
+        mFlags,
+        mFilterRadius,
+        mSharpenAmount,
+        mBrightnessRatio,
+        mGammaScaler,
+        refImagePath,
+        bPreview,
+        mDisplayWidth,
+        mDisplayHeight
+    });
+
     {
-        equalizeHistogram(hist, pixelCount);
+        std::lock_guard<std::mutex> lock(mRequestMutex);
 
-        for (int i = 0; i < pixelCount; ++i)
+        // the queued request has not started and is dropped, the one in flight stops at its next strip
+        mpPendingRequest = std::move(pRequest);
+        mLatestSerial.store(serial);
+        mLatestUpstreamSerial.store(upstreamSerial);
+    }
+    mRequestCondition.notify_one();
+}
+
+void ImageProcessor::runWorker()
+{
+    Profiler::GetInstance()->SetThreadName("image processor");
+
+    while (true)
+    {
+        std::unique_ptr<ProcessingRequest> pRequest;
         {
-            Pixel& pixel = mBufferedImage.pRawPixels[i];
-            for (int color = 0; color < COLOR_COUNT; ++color)
+            std::unique_lock<std::mutex> lock(mRequestMutex);
+
+            mRequestCondition.wait(lock, [this]() { return mbStopping || mpPendingRequest != nullptr; });
+            if (mbStopping)
             {
-                pixel.subPixels[color] = hist.frequencyTables[color][pixel.subPixels[color]];
+                return;
             }
+
+            pRequest = std::move(mpPendingRequest);
         }
+
+        processRequest(*pRequest);
+    }
+}
+
+void ImageProcessor::processRequest(const ProcessingRequest& request)
+{
+    PROFILE_SCOPE("ImageProcessor::processRequest");
+
+    // every cached output belongs to the previous source
+    if (request.SourceImage.GetVersion() != mSourceVersion)
+    {
+        mpSourceImage = nullptr;
+        mpRemapTable = nullptr;
+        mpClaheLookups = nullptr;
+        mpAdjustmentTable = nullptr;
+        mStageGraph.Clear();
+
+        mSourceVersion = request.SourceImage.GetVersion();
     }
+
+    std::unique_ptr<ProcessingResult> pResult(new ProcessingResult());
+    pResult->Serial = request.Serial;
+    pResult->SourceVersion = mSourceVersion;
+    pResult->bRemapFailed = false;
+
+    bool bCompleted = true;
+
+    // the stages are called directly so that each one can be inlined, false stops at the first cancelled one
+    mStageGraph.BeginUpdate();
+    {
+        bCompleted = updateFilteredImage(request)
+            && updateRemapTable(request, *pResult)
+            && updateAdjustmentTable(request)
+            && (request.bPreview ? storePreview(request, *pResult) : storeResult(request, *pResult));
+    }
+    mStageGraph.EndUpdate();
+
+    // a newer request is pending, nothing of this one is shown
+    if (!bCompleted)
+    {
+        return;
+    }
+
+    // counted here so that the histogram panel finds it cached
+    Histogram hist;
+    pResult->ResultImage.GetHistogram(hist);
+
+    for (const StageNodeBase* pNode : mStageGraph.GetNodes())
+    {
+        pResult->Stages.push_back({ pNode->GetName(), pNode->GetHitCount(), pNode->GetMissCount(), pNode->GetCachedCount(), pNode->GetCachedBytes() });
+    }
+
+    mResultMailbox.Post(std::move(pResult));
 }
 
-void ImageProcessor::equalizeHistogram(Histogram& outHistogram, const int pixelCount)
+bool ImageProcessor::updateFilteredImage(const ProcessingRequest& request)
 {
-    uint32_t cumulativeSum[COLOR_COUNT] = { 0, };
-    for (int i = 0; i <= MAX_BRIGHTNESS; ++i)
+    PROFILE_SCOPE("ImageProcessor::updateFilteredImage");
+
+    mSourceKey = request.SourceImage.GetVersion();
+    mpSourceImage = &request.SourceImage;
+
+    const uint32_t filter = request.Flags.flags & MASK_FILTER;
+    if (filter == EUIConstant::NONE)
+    {
+        return true;
+    }
+
+    StageKey key;
+    key.Add(request.SourceImage.GetVersion()).Add(filter).Add(request.FilterRadius);
+
+    if (filter == EUIConstant::FILTER_UNSHARP_MASK)
     {
-        for (int color = 0; color < COLOR_COUNT; ++color)
+        key.Add(request.SharpenAmount);
+    }
+
+    // a neighborhood pass over the whole source, not cancellable in between
+    mpSourceImage = mFilteredImageStage.Get(key.GetValue(), [this, &request](Image& outImage)
         {
-            cumulativeSum[color] += outHistogram.frequencyTables[color][i];
+            executeFilter(outImage, request);
 
-            const float newIntensity = roundf(MAX_BRIGHTNESS_F * cumulativeSum[color] / pixelCount);
+            return true;
+        });
+    mSourceKey = key.GetValue();
 
-            outHistogram.frequencyTables[color][i] = static_cast<uint8_t>(newIntensity);
-        }
+    return !request.UpstreamCancellation.IsCancelled();
+}
+
+void ImageProcessor::executeFilter(Image& outImage, const ProcessingRequest& request)
+{
+    const Image& srcImage = request.SourceImage;
+
+    outImage = Image(srcImage.Width, srcImage.Height, srcImage.ChannelCount);
+
+    switch (request.Flags.flags & MASK_FILTER)
+    {
+    case EUIConstant::FILTER_GAUSSIAN_BLUR:
+        ExecuteGaussianBlur(srcImage.GetView(), outImage.GetMutableView(), request.FilterRadius);
+        break;
+
+    case EUIConstant::FILTER_BOX_BLUR:
+        ExecuteBoxBlur(srcImage.GetView(), outImage.GetMutableView(), static_cast<int>(request.FilterRadius + 0.5f));
+        break;
+
+    case EUIConstant::FILTER_UNSHARP_MASK:
+        ExecuteUnsharpMask(srcImage.GetView(), outImage.GetMutableView(), request.FilterRadius, request.SharpenAmount);
+        break;
+
+    default:
+        assert(false);
+        break;
     }
 }
 
-void ImageProcessor::executeHistogramMatching()
+bool ImageProcessor::updateRemapTable(const ProcessingRequest& request, ProcessingResult& outResult)
 {
-    if (mDirtyFlags.partition.histogramProcessing)
+    PROFILE_SCOPE("ImageProcessor::updateRemapTable");
+
+    mRemapTableKey = 0;
+    mpRemapTable = nullptr;
+    mpClaheLookups = nullptr;
+
+    const uint32_t histogramProcessing = request.Flags.flags & MASK_HISTOGRAM_PROCESSING;
+    if (histogramProcessing == EUIConstant::NONE)
     {
-        FileDialog& fileDialog = *FileDialog::GetInstance();
-        if (!fileDialog.TryOpenFileDialog(mRefImagePath, EFileDialogConstant::DEFAULT_PATH_LEN))
+        return true;
+    }
+
+    const bool bMatching = histogramProcessing == EUIConstant::HISTOGRAM_PROCESSING_MATCHING;
+    const bool bGrayScale = request.Flags.bits.grayScale;
+
+    StageKey key;
+    key.Add(mSourceKey).Add(bGrayScale).Add(histogramProcessing).Add(request.Flags.bits.cuda);
+
+    // local lookups per tile instead of a single remap table, applied when the buffered image is made
+    if (histogramProcessing == EUIConstant::HISTOGRAM_PROCESSING_CLAHE)
+    {
+        mpClaheLookups = mClaheLookupsStage.Get(key.GetValue(), [this, bGrayScale](ClaheLookups& outLookups)
+            {
+                BuildClaheLookups(outLookups, mpSourceImage->GetView(), bGrayScale, DEFAULT_CLAHE_TILE_COUNT, DEFAULT_CLAHE_CLIP_LIMIT_F);
+
+                return true;
+            });
+        mRemapTableKey = key.GetValue();
+
+        return !request.UpstreamCancellation.IsCancelled();
+    }
+
+    if (bMatching)
+    {
+        DecodedImageCache::SourceStamp refStamp;
+        if (!DecodedImageCache::TryGetSourceStamp(request.RefImagePath.c_str(), refStamp))
         {
-            mDirtyFlags.partition.histogramProcessing = true;
-            mFlags.partition.histogramProcessing = false;
+            outResult.bRemapFailed = true;
 
-            return;
+            return true;
         }
+
+        key.Add(refStamp.FullPath).Add(refStamp.FileSize).Add(refStamp.ModifiedTime);
     }
 
-    Image refImage(mRefImagePath);
-    if (mFlags.bits.grayScale)
+    // the histogram is a global dependency, it is counted to the end even when cancelled
+    mpRemapTable = mRemapTableStage.Get(key.GetValue(), [this, &request, bMatching](Histogram& outLookup)
+        {
+            return bMatching ? executeHistogramMatching(outLookup, request) : executeEqualization(outLookup, request);
+        });
+
+    if (mpRemapTable == nullptr)
     {
-        convertToGrayScale(refImage);
+        outResult.bRemapFailed = bMatching;
+
+        return true;
     }
 
-    Histogram refEqualizedHist = refImage.GetHistogram();
+    mRemapTableKey = key.GetValue();
 
-    equalizeHistogram(refEqualizedHist, refImage.Width * refImage.Height);
+    return !request.UpstreamCancellation.IsCancelled();
+}
 
-    const int pixelCount = mBufferedImage.Width * mBufferedImage.Height;
+bool ImageProcessor::executeEqualization(Histogram& outLookup, const ProcessingRequest& request)
+{
+    if (request.Flags.bits.cuda)
+    {
+        return false;
+    }
+    else
+    {
+        BuildEqualizationLookup(outLookup, *mpSourceImage, request.Flags.bits.grayScale);
+    }
 
-    Histogram equalizedHist = mBufferedImage.GetHistogram();
-    equalizeHistogram(equalizedHist, pixelCount);
+    return true;
+}
 
-    Histogram inverseLookup = { 0, };
-    for (int i = 0; i <= MAX_BRIGHTNESS; ++i)
+bool ImageProcessor::executeHistogramMatching(Histogram& outLookup, const ProcessingRequest& request)
+{
+    const bool bGrayScale = request.Flags.bits.grayScale;
+    MatchingCache& cache = mMatchingCaches[bGrayScale];
+
+    DecodedImageCache::SourceStamp refStamp;
+    if (!DecodedImageCache::TryGetSourceStamp(request.RefImagePath.c_str(), refStamp))
+    {
+        return false;
+    }
+
+    const bool bRefChanged = !cache.bRefValid
+        || refStamp.FullPath != cache.RefStamp.FullPath
+        || refStamp.FileSize != cache.RefStamp.FileSize
+        || refStamp.ModifiedTime != cache.RefStamp.ModifiedTime;
+
+    if (bRefChanged)
     {
-        for (int color = 0; color < COLOR_COUNT; ++color)
+        cache.bRefValid = false;
+
+        Image refImage = DecodedImageCache::GetInstance()->Load(request.RefImagePath.c_str());
+        if (refImage.IsEmpty())
         {
-            int k = MAX_BRIGHTNESS;
-            while (refEqualizedHist.frequencyTables[color][k] > equalizedHist.frequencyTables[color][i])
-            {
-                --k;
-            }
+            return false;
+        }
+
+        // gray scale is applied on the fly, a mapped reference is never copied
+        ComputeChainHistogram(refImage, bGrayScale, cache.RefEqualizedHist);
+        EqualizeHistogram(cache.RefEqualizedHist, refImage.GetPixelCount());
+
+        cache.RefStamp = refStamp;
+        cache.bRefValid = true;
+    }
+
+    BuildMatchingLookup(outLookup, *mpSourceImage, bGrayScale, cache.RefEqualizedHist);
+
+    return true;
+}
+
+bool ImageProcessor::updateAdjustmentTable(const ProcessingRequest& request)
+{
+    PROFILE_SCOPE("ImageProcessor::updateAdjustmentTable");
+
+    StageKey key;
+    key.Add(request.BrightnessRatio).Add(request.GammaScaler).Add(request.Flags.partition.hardwareAcceleration);
+
+    mpAdjustmentTable = mAdjustmentTableStage.Get(key.GetValue(), [this, &request](AdjustmentTable& outTable)
+        {
+            normalize(outTable.Pixels);
+            modifyBrightness(outTable.Pixels, request);
+            outTable.bIdentity = IsIdentityAdjustment(outTable.Pixels);
+
+            return true;
+        });
+    mAdjustmentTableKey = key.GetValue();
+
+    return true;
+}
+
+void ImageProcessor::normalize(PixelF outTable[EImageConstant::TABLE_SIZE])
+{
+    NormalizeTable(outTable);
+}
+
+void ImageProcessor::modifyBrightness(PixelF outTable[EImageConstant::TABLE_SIZE], const ProcessingRequest& request)
+{
+    if (request.Flags.bits.cuda)
+    {
+
+    }
+    else if (request.Flags.bits.simd)
+    {
+        ModifyBrightnessSIMD(outTable, TABLE_SIZE, request.BrightnessRatio, request.GammaScaler);
+    }
+    else
+    {
+        ModifyBrightness(outTable, TABLE_SIZE, request.BrightnessRatio, request.GammaScaler);
+    }
+}
+
+uint64_t ImageProcessor::getBufferedKey(const ProcessingRequest& request) const
+{
+    StageKey bufferedKey;
+    bufferedKey.Add(mSourceKey).Add(request.Flags.bits.grayScale).Add(mRemapTableKey);
+
+    return bufferedKey.GetValue();
+}
+
+bool ImageProcessor::storeResult(const ProcessingRequest& request, ProcessingResult& outResult)
+{
+    PROFILE_SCOPE("ImageProcessor::storeResult");
+
+    assert(mpAdjustmentTable != nullptr);
+
+    const uint64_t bufferedKey = getBufferedKey(request);
+
+    StageKey resultKey;
+    resultKey.Add(bufferedKey).Add(mAdjustmentTableKey);
+
+    const Image* const pCachedImage = mResultImageStage.Find(resultKey.GetValue());
+    if (pCachedImage != nullptr)
+    {
+        outResult.ResultImage = *pCachedImage;
+
+        return true;
+    }
+
+    const Image& srcImage = *mpSourceImage;
+
+    // without gray scale and remapping the buffered image is the original, shared instead of copied
+    const bool bGrayScale = request.Flags.bits.grayScale && srcImage.ChannelCount > 2;
+    const bool bBufferedIsOriginal = !bGrayScale && mpRemapTable == nullptr && mpClaheLookups == nullptr;
+
+    const Image* pBufferedImage = mBufferedImageStage.Find(bufferedKey);
+    if (pBufferedImage == nullptr && bBufferedIsOriginal)
+    {
+        pBufferedImage = &mBufferedImageStage.Insert(bufferedKey, Image(srcImage));
+    }
+
+    // the interpolation reads neighbouring tiles, it is a pass of its own before the adjustment
+    if (pBufferedImage == nullptr && mpClaheLookups != nullptr)
+    {
+        Image bufferedImage(srcImage.Width, srcImage.Height, srcImage.ChannelCount);
+        ApplyClaheLookups(srcImage.GetView(), bufferedImage.GetMutableView(), request.Flags.bits.grayScale, *mpClaheLookups);
+
+        pBufferedImage = &mBufferedImageStage.Insert(bufferedKey, std::move(bufferedImage));
+    }
+
+    ProcessingChain chain;
+    chain.bGrayScale = false;
+    chain.bSIMD = request.Flags.bits.simd;
+    chain.pRemapTable = nullptr;
+    chain.pNormalizedTable = mpAdjustmentTable->Pixels;
+    chain.pSrcPlanes = nullptr;
+    chain.pCancellation = &request.Cancellation;
+
+    Image resultImage;
 
-            if (k < 0)
+    // slider drags only run the adjustment pass over the cached buffered image
+    if (pBufferedImage != nullptr)
+    {
+        if (mpAdjustmentTable->bIdentity)
+        {
+            resultImage = *pBufferedImage;
+        }
+        else
+        {
+            // split on the first drag, the planes stay with the cached image for the following ones.
+            // only the vectorized pass reads them
+            PlanarImageView bufferedPlanes;
+            if (ADJUSTMENT_PREFERRED_LAYOUT == PIXEL_LAYOUT_PLANAR && chain.bSIMD)
             {
-                inverseLookup.frequencyTables[color][i] = 0;
+                bufferedPlanes = pBufferedImage->GetPlanarView();
+                chain.pSrcPlanes = &bufferedPlanes;
             }
-            else
+
+            if (!ExecuteChainInStrips(*pBufferedImage, nullptr, resultImage, chain))
             {
-                inverseLookup.frequencyTables[color][i] = k;
+                return false;
             }
         }
     }
-
-    for (int i = 0; i < pixelCount; ++i)
+    else
     {
-        Pixel& pixel = mBufferedImage.pRawPixels[i];
-        for (int color = 0; color < COLOR_COUNT; ++color)
+        // the whole chain strip by strip, the remap table has been resolved by updateRemapTable
+        chain.bGrayScale = request.Flags.bits.grayScale;
+        chain.pRemapTable = mpRemapTable;
+        chain.pCancellation = &request.UpstreamCancellation;
+
+        // a partially written buffered image is never cached
+        Image bufferedImage;
+        if (!ExecuteChainInStrips(srcImage, &bufferedImage, resultImage, chain))
         {
-            pixel.subPixels[color] = inverseLookup.frequencyTables[color][pixel.subPixels[color]];
+            return false;
         }
+
+        mBufferedImageStage.Insert(bufferedKey, std::move(bufferedImage));
     }
+
+    outResult.ResultImage = mResultImageStage.Insert(resultKey.GetValue(), std::move(resultImage));
+
+    return true;
 }
 
-void ImageProcessor::normalize()
+bool ImageProcessor::storePreview(const ProcessingRequest& request, ProcessingResult& outResult)
 {
-    for (int i = 0; i < mBufferedImage.Width * mBufferedImage.Height; ++i)
+    PROFILE_SCOPE("ImageProcessor::storePreview");
+
+    assert(mpAdjustmentTable != nullptr);
+
+    // smallest level that still covers the display
+    int level = 0;
+    int levelWidth = mpSourceImage->Width;
+    int levelHeight = mpSourceImage->Height;
+    while (request.DisplayWidth > 0 && request.DisplayHeight > 0
+        && levelWidth / 2 >= request.DisplayWidth && levelHeight / 2 >= request.DisplayHeight)
     {
-        const Pixel& pixel = mBufferedImage.pRawPixels[i];
+        levelWidth /= 2;
+        levelHeight /= 2;
+        ++level;
+    }
 
-        PixelF& normalizedPixel = mNormalizedPixels[i];
-        for (int color = 0; color < COLOR_COUNT; ++color)
-        {
-            normalizedPixel.subPixels[color] = pixel.subPixels[color] * NORMALIZER_F;
-        }
+    const Image* const pLevelImage = level > 0 ? findPreviewLevel(request, level) : nullptr;
+
+    // the image is not larger than the display or nothing is buffered yet, the full resolution result instead
+    if (pLevelImage == nullptr)
+    {
+        return storeResult(request, outResult);
     }
+
+    Image previewImage(pLevelImage->Width, pLevelImage->Height, pLevelImage->ChannelCount);
+    StoreAdjustedImage(*pLevelImage, previewImage, mpAdjustmentTable->Pixels, request.Flags.bits.simd);
+
+    outResult.ResultImage = std::move(previewImage);
+
+    return true;
 }
 
-void ImageProcessor::modifyBrightness()
+const Image* ImageProcessor::findPreviewLevel(const ProcessingRequest& request, const int level)
 {
-    if (mFlags.bits.cuda)
-    {
+    assert(level > 0);
 
+    const uint64_t bufferedKey = getBufferedKey(request);
+
+    // the full resolution pass keeps the buffered image, the preview only reads it
+    const Image* pLevelImage = mBufferedImageStage.Find(bufferedKey);
+    if (pLevelImage == nullptr)
+    {
+        return nullptr;
     }
-    else if (mFlags.bits.simd)
+
+    // every level on the way is touched so that the next tick finds them all
+    for (int i = 1; i <= level; ++i)
     {
+        StageKey levelKey;
+        levelKey.Add(bufferedKey).Add(i);
+
+        const Image* const pCachedImage = mPreviewLevelStage.Find(levelKey.GetValue());
+        if (pCachedImage != nullptr)
+        {
+            pLevelImage = pCachedImage;
+
+            continue;
+        }
+
+        Image levelImage;
+        DownsampleByHalf(pLevelImage->GetView(), levelImage);
 
+        pLevelImage = &mPreviewLevelStage.Insert(levelKey.GetValue(), std::move(levelImage));
     }
-    else
+
+    return pLevelImage;
+}
+
+void ImageProcessor::drawStageStatistics()
+{
+    ImGui::SeparatorText("Stages");
+
+    if (ImGui::BeginTable("Stage Statistics", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
     {
-        for (int i = 0; i < mBufferedImage.Width * mBufferedImage.Height; ++i)
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("Hit");
+        ImGui::TableSetupColumn("Miss");
+        ImGui::TableSetupColumn("Cached");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableHeadersRow();
+
+        // snapshot of the worker's graph taken with the displayed result
+        for (const StageStatistics& stage : mDisplayedStages)
         {
-            PixelF& pixel = mNormalizedPixels[i];
+            ImGui::TableNextRow();
 
-            for (int color = 0; color < COLOR_COUNT; ++color)
-            {
-                const float newIntensity = clampNormalizedBrightness(pixel.subPixels[color] * mBrightnessRatio);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stage.Name);
 
-                pixel.subPixels[color] = powf(newIntensity, mGammaScaler);
-            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(stage.HitCount));
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(stage.MissCount));
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", stage.CachedCount);
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stage.CachedBytes / (1024.0 * 1024.0));
         }
+
+        ImGui::EndTable();
     }
 }
 
-void ImageProcessor::storeResult()
+void ImageProcessor::drawPoolStatistics()
 {
-    for (int i = 0; i < mBufferedImage.Width * mBufferedImage.Height; ++i)
+    ImGui::SeparatorText("Pixel Buffers");
     {
-        const PixelF& pixel = mNormalizedPixels[i];
+        PixelBufferPool& pool = *PixelBufferPool::GetInstance();
 
-        Pixel& resultPixel = mResultImage.pRawPixels[i];
-        for (int color = 0; color < COLOR_COUNT; ++color)
+        // takes effect for buffers allocated afterwards
+        bool bLargePages = pool.IsLargePagesEnabled();
+        if (ImGui::Checkbox("Large Pages", &bLargePages))
         {
-            resultPixel.subPixels[color] = static_cast<uint8_t>(pixel.subPixels[color] * UNNORMALIZER_F);
+            pool.SetLargePagesEnabled(bLargePages);
         }
+
+        PixelBufferPool::Statistics stats;
+        pool.GetStatistics(stats);
+
+        ImGui::Text("live: %.1f MB, idle: %.1f MB, large pages: %.1f MB",
+            stats.LiveBytes / (1024.0 * 1024.0), stats.IdleBytes / (1024.0 * 1024.0), stats.LargePageBytes / (1024.0 * 1024.0));
+        ImGui::Text("acquired: %llu, reused: %llu, system: %llu",
+            static_cast<unsigned long long>(stats.AcquireCount),
+            static_cast<unsigned long long>(stats.ReuseCount),
+            static_cast<unsigned long long>(stats.SystemAllocationCount));
     }
 }
 
-void ImageProcessor::convertToGrayScale(Image& outImage)
+void ImageProcessor::drawProfilerStatistics()
 {
-    if (outImage.ChannelCount <= 2)
+    ImGui::SeparatorText("Profiler");
     {
-        return;
-    }
+        Profiler& profiler = *Profiler::GetInstance();
 
-    for (int i = 0; i < outImage.Width * outImage.Height; ++i)
-    {
-        Pixel& pixel = outImage.pRawPixels[i];
+        bool bEnabled = Profiler::IsEnabled();
+        if (ImGui::Checkbox("Enabled", &bEnabled))
+        {
+            profiler.SetEnabled(bEnabled);
+        }
 
-        // luma coding
-        const float newIntensity = clampBrightness(pixel.rgba.r * 0.299f + pixel.rgba.g * 0.587f + pixel.rgba.b * 0.114f);
-        const uint8_t grayBrightness = static_cast<uint8_t>(newIntensity);
+        ImGui::SameLine();
+        if (ImGui::Button("Clear"))
+        {
+            profiler.Clear();
+            mProfileZones.clear();
+        }
+
+        // headless runs write the same file with --profile, see BatchMain
+        ImGui::SameLine();
+        if (ImGui::Button("Export Trace"))
+        {
+            profiler.WriteChromeTrace("profile.json");
+        }
 
-        for (int color = 0; color < COLOR_COUNT; ++color)
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (bEnabled && now - mLastProfileRefreshTime >= std::chrono::milliseconds(PROFILER_REFRESH_MS))
         {
-            pixel.subPixels[color] = grayBrightness;
+            profiler.Summarize(static_cast<int64_t>(PROFILER_WINDOW_MS) * 1000 * 1000, mProfileZones);
+            mLastProfileRefreshTime = now;
+        }
+
+        if (ImGui::BeginTable("Profiler Statistics", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Total ms");
+            ImGui::TableSetupColumn("Max ms");
+            ImGui::TableSetupColumn("GB/s");
+            ImGui::TableSetupColumn("Allocs");
+            ImGui::TableHeadersRow();
+
+            // per second, the slowest first
+            for (const Profiler::ZoneStatistics& zone : mProfileZones)
+            {
+                ImGui::TableNextRow();
+
+                ImGui::TableNextColumn();
+                ImGui::Text(zone.Kind == PROFILE_EVENT_TASK ? "%s (tasks)" : "%s", zone.pName);
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(zone.Count));
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", zone.TotalNanoseconds * 1e-6);
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", zone.MaxNanoseconds * 1e-6);
+
+                // bytes per nanosecond, blank when the scope declares none
+                ImGui::TableNextColumn();
+                if (zone.TouchedBytes > 0 && zone.TotalNanoseconds > 0)
+                {
+                    ImGui::Text("%.2f", static_cast<double>(zone.TouchedBytes) / zone.TotalNanoseconds);
+                }
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(zone.AllocationCount));
+            }
+
+            ImGui::EndTable();
         }
     }
 }
@@ -8,12 +8,32 @@
 #include <implot.h>
 
 #include <cmath>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Debug.h"
 #include "Image.h"
+#include "DecodedImageCache.h"
+#include "ImageProcessingHelper.h"
+#include "ImageProcessingHelperSIMD.h"
 #include "ComHelper.h"
 
 #include "FileDialog.h"
+#include "StageGraph.h"
+#include "PixelBufferPool.h"
+#include "LatestMailbox.h"
+#include "Profiler.h"
+
+inline size_t GetStageByteCount(const ClaheLookups& lookups)
+{
+    return sizeof(ClaheLookups) + sizeof(Histogram) * lookups.TileLookups.size();
+}
 
 class ImageProcessor final
 {
@@ -25,12 +45,21 @@ public:
     ImageProcessor& operator=(const ImageProcessor& other) = delete;
     ImageProcessor& operator=(ImageProcessor&& other) = delete;
 
-    Image& GetProcessedImage();
+    // the latest result picked up, the original until the first one arrives
+    const Image& GetProcessedImage() const;
+
+    // posts a request to the worker when the controls changed, never waits for processing
     void Update();
 
+    // takes the newest result from the worker, false when there is none since the last call
+    bool PickUpResult();
+
     void RegisterImage(Image&& other);
     void DrawControlPanel();
 
+    // client size of the window, picks the preview level while a slider is dragged
+    void SetDisplaySize(const int width, const int height);
+
 private:
     enum EUIConstant
     {
@@ -46,9 +75,16 @@ private:
         // Histogram Processing
         HISTOGRAM_PROCESSING_EQUALIZATION = 1 << 3,
         HISTOGRAM_PROCESSING_MATCHING = 1 << 4,
+        HISTOGRAM_PROCESSING_CLAHE = 1 << 5,
+
+        // Filter
+        FILTER_GAUSSIAN_BLUR = 1 << 6,
+        FILTER_BOX_BLUR = 1 << 7,
+        FILTER_UNSHARP_MASK = 1 << 8,
 
         // Mask
-        MASK_HISTOGRAM_PROCESSING = HISTOGRAM_PROCESSING_EQUALIZATION | HISTOGRAM_PROCESSING_MATCHING
+        MASK_HISTOGRAM_PROCESSING = HISTOGRAM_PROCESSING_EQUALIZATION | HISTOGRAM_PROCESSING_MATCHING | HISTOGRAM_PROCESSING_CLAHE,
+        MASK_FILTER = FILTER_GAUSSIAN_BLUR | FILTER_BOX_BLUR | FILTER_UNSHARP_MASK
     };
 
     union UIFlags
@@ -65,90 +101,221 @@ private:
             // Histogram Processing
             uint32_t equalization : 1;
             uint32_t matching : 1;
+            uint32_t clahe : 1;
+
+            // Filter
+            uint32_t gaussianBlur : 1;
+            uint32_t boxBlur : 1;
+            uint32_t unsharpMask : 1;
 
             // Adjustment
             uint32_t restoring : 1;
-            uint32_t reserved : 26;
+            uint32_t reserved : 22;
         } bits;
 
         struct
         {
             uint32_t hardwareAcceleration : 2;
             uint32_t mode : 1;
-            uint32_t histogramProcessing : 2;
+            uint32_t histogramProcessing : 3;
+            uint32_t filter : 3;
             uint32_t restoring : 1;
-            uint32_t adjustment : 26;
+            uint32_t adjustment : 22;
         } partition;
 
         uint32_t flags;
     };
     static_assert(sizeof(UIFlags) == 4, "UIFlags should be 4 bytes");
 
-    using ProcessingFunc = void (ImageProcessor::*)();
+    enum EPreviewConstant
+    {
+        // input has to rest this long before the full resolution result replaces the preview
+        PREVIEW_REFINE_IDLE_MS = 150
+    };
+
+    enum EProfilerPanelConstant
+    {
+        // the table sums the scopes that ended within the window and is refreshed at the interval so that it stays readable
+        PROFILER_WINDOW_MS = 1000,
+        PROFILER_REFRESH_MS = 500
+    };
+
+    // everything the worker reads, copied on the ui thread so that the controls never race with processing
+    struct ProcessingRequest
+    {
+        uint64_t Serial;
+
+        // any newer request makes the adjusted output useless
+        CancellationToken Cancellation;
+
+        // the buffered image is still needed by newer requests until one changes its inputs
+        CancellationToken UpstreamCancellation;
+
+        // shares the pixels of the original
+        Image SourceImage;
+
+        UIFlags Flags;
+        float FilterRadius;
+        float SharpenAmount;
+        float BrightnessRatio;
+        float GammaScaler;
+        std::string RefImagePath;
+
+        // a slider is held, the level closest to the display is enough
+        bool bPreview;
+        int DisplayWidth;
+        int DisplayHeight;
+    };
+
+    struct StageStatistics
+    {
+        const char* Name;
+        uint64_t HitCount;
+        uint64_t MissCount;
+        int CachedCount;
+        size_t CachedBytes;
+    };
+
+    struct ProcessingResult
+    {
+        uint64_t Serial;
+        uint64_t SourceVersion;
+
+        // the histogram is cached before it is posted, the ui thread never counts pixels
+        Image ResultImage;
+
+        // the reference could not be read, the result is without histogram processing
+        bool bRemapFailed;
+
+        std::vector<StageStatistics> Stages;
+    };
+
+    // reference equalized histogram per gray scale mode, so that toggling gray scale skips the decode
+    struct MatchingCache
+    {
+        DecodedImageCache::SourceStamp RefStamp;
+        bool bRefValid;
+        Histogram RefEqualizedHist;
+    };
+
+    // brightness, gamma applied to every 8 bit input once instead of every pixel
+    struct AdjustmentTable
+    {
+        PixelF Pixels[EImageConstant::TABLE_SIZE];
+
+        // defaults, the result shares the pixels of the buffered image
+        bool bIdentity;
+    };
 
 private:
+    // ui thread, the worker only sees the snapshots of a request
     Image mOriginalImage;
+    Image mDisplayedImage;
+    std::vector<StageStatistics> mDisplayedStages;
+    std::vector<Profiler::ZoneStatistics> mProfileZones;
+    std::chrono::steady_clock::time_point mLastProfileRefreshTime;
+
+    bool mbRefinementPending;
+    std::chrono::steady_clock::time_point mLastAdjustmentTime;
 
-    Image mBufferedImage;
-    PixelF* mNormalizedPixels;
+    int mDisplayWidth;
+    int mDisplayHeight;
 
-    Image mResultImage;
+    // a brightness or gamma slider is held
+    bool mbAdjusting;
 
     UIFlags mFlags;
     UIFlags mDirtyFlags;
 
     char mRefImagePath[EFileDialogConstant::DEFAULT_PATH_LEN];
 
+    // sigma of the gaussian blur and unsharp mask, radius of the box blur
+    float mFilterRadius;
+    float mSharpenAmount;
+
     float mBrightnessRatio;
     float mGammaScaler;
 
+    // serial of the newest request, the worker polls it to cancel the one in flight
+    std::atomic<uint64_t> mLatestSerial;
+
+    // serial of the newest request with other source, filter, gray scale, histogram processing or reference
+    std::atomic<uint64_t> mLatestUpstreamSerial;
+    uint64_t mUpstreamKey;
+
+    // one pending request, a newer one replaces it before the worker has started it
+    std::mutex mRequestMutex;
+    std::condition_variable mRequestCondition;
+    std::unique_ptr<ProcessingRequest> mpPendingRequest;
+    bool mbStopping;
+
+    LatestMailbox<ProcessingResult> mResultMailbox;
+
+    // worker thread from here on
+    // every stage output is keyed by its parameters and inputs, only stages downstream of a change recompute
+    // source -> filtered image (filter, radius, amount), stands in for the source of every later stage
+    // source -> remap table (gray scale, histogram processing, reference) or clahe tile lookups (gray scale)
+    //        -> buffered image (gray scale, remap table or tile lookups)
+    // adjustment table (brightness, gamma) + buffered image -> result image
+    // buffered image -> preview levels, adjusted instead of the result while a slider is held
+    StageGraph mStageGraph;
+    StageNode<Image> mFilteredImageStage;
+    StageNode<Histogram> mRemapTableStage;
+    StageNode<ClaheLookups> mClaheLookupsStage;
+    StageNode<AdjustmentTable> mAdjustmentTableStage;
+    StageNode<Image> mBufferedImageStage;
+    StageNode<Image> mResultImageStage;
+
+    // mip levels of the buffered image keyed by (buffered image, level), level 0 is the buffered image itself
+    StageNode<Image> mPreviewLevelStage;
+
+    // outputs of the current request, 0 / nullptr when the stage is off.
+    // the source is the request's own image when no filter is set, keyed by its version then
+    uint64_t mSourceKey;
+    const Image* mpSourceImage;
+    uint64_t mRemapTableKey;
+    const Histogram* mpRemapTable;
+    const ClaheLookups* mpClaheLookups;
+    uint64_t mAdjustmentTableKey;
+    const AdjustmentTable* mpAdjustmentTable;
+
+    // the graph is cleared when a request comes with another source
+    uint64_t mSourceVersion;
+
+    // indexed by gray scale
+    MatchingCache mMatchingCaches[2];
+
+    // started last, joined first
+    std::thread mWorker;
+
 private:
     void restoreDefaultAdjustment();
 
-    template<typename T>
-    T clamp(T value, T min, T max) const;
+    void postRequest(const bool bPreview);
 
-    template<typename T>
-    T clampBrightness(T value) const;
+    void runWorker();
+    void processRequest(const ProcessingRequest& request);
 
-    template<typename T>
-    T clampNormalizedBrightness(T value) const;
+    bool updateFilteredImage(const ProcessingRequest& request);
+    void executeFilter(Image& outImage, const ProcessingRequest& request);
 
-    void convertToGrayScale(Image& outImage);
+    bool updateRemapTable(const ProcessingRequest& request, ProcessingResult& outResult);
+    bool executeEqualization(Histogram& outLookup, const ProcessingRequest& request);
+    bool executeHistogramMatching(Histogram& outLookup, const ProcessingRequest& request);
 
-    void executeEqualization();
-    void equalizeHistogram(Histogram& outHistogram, const int pixelCount);
-    void executeHistogramMatching();
+    bool updateAdjustmentTable(const ProcessingRequest& request);
+    void normalize(PixelF outTable[EImageConstant::TABLE_SIZE]);
+    void modifyBrightness(PixelF outTable[EImageConstant::TABLE_SIZE], const ProcessingRequest& request);
 
-    void normalize();
-    void modifyBrightness();
-    void storeResult();
-};
+    uint64_t getBufferedKey(const ProcessingRequest& request) const;
 
-template<typename T>
-inline T ImageProcessor::clamp(T value, T min, T max) const
-{
-    if (value < min)
-    {
-        return min;
-    }
+    bool storeResult(const ProcessingRequest& request, ProcessingResult& outResult);
 
-    if (value > max)
-    {
-        return max;
-    }
-
-    return value;
-}
+    // false when the image is not larger than the display, the full resolution result is as cheap
+    bool storePreview(const ProcessingRequest& request, ProcessingResult& outResult);
+    const Image* findPreviewLevel(const ProcessingRequest& request, const int level);
 
-template<typename T>
-inline T ImageProcessor::clampBrightness(T value) const
-{
-    return clamp(value, MIN_BRIGHTNESS_F, MAX_BRIGHTNESS_F);
-}
-
-template<typename T>
-inline T ImageProcessor::clampNormalizedBrightness(T value) const
-{
-    return clamp(value, NORMALIZED_MIN_F, NORMALIZED_MAX_F);
-}
+    void drawStageStatistics();
+    void drawPoolStatistics();
+    void drawProfilerStatistics();
+};
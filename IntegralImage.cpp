@@ -0,0 +1,226 @@
+#include "IntegralImage.h"
+
+#include <algorithm>
+
+#include "PixelBufferPool.h"
+#include "TaskScheduler.h"
+
+IntegralImage::IntegralImage()
+    : mWidth(0)
+    , mHeight(0)
+    , mStripCount(0)
+    , mpEntries(nullptr)
+    , mpCarryRows(nullptr)
+{
+
+}
+
+IntegralImage::~IntegralImage()
+{
+    Clear();
+}
+
+void IntegralImage::Build(const ImageView& srcView)
+{
+    assert(srcView.pPixels != nullptr);
+    assert(srcView.Width > 0);
+    assert(srcView.Height > 0);
+
+    Clear();
+
+    mWidth = srcView.Width;
+    mHeight = srcView.Height;
+    mStripCount = (mHeight + INTEGRAL_STRIP_ROW_COUNT - 1) / INTEGRAL_STRIP_ROW_COUNT;
+
+    const int64_t stride = static_cast<int64_t>(mWidth) + 1;
+
+    PixelBufferPool& pool = *PixelBufferPool::GetInstance();
+    mpEntries = pool.AcquireArray<Entry>(stride * (mHeight + 1));
+    mpCarryRows = pool.AcquireArray<Entry>(stride * mStripCount);
+
+    std::fill(mpEntries, mpEntries + stride, Entry());
+    std::fill(mpCarryRows, mpCarryRows + stride, Entry());
+
+    // row prefix sums added to the row above within the strip, every strip is independent
+    TaskScheduler::GetInstance()->ParallelFor(0, mStripCount, 1, [&](const int64_t beginStrip, const int64_t endStrip)
+        {
+            for (int64_t strip = beginStrip; strip < endStrip; ++strip)
+            {
+                const int beginRow = static_cast<int>(strip) * INTEGRAL_STRIP_ROW_COUNT;
+                const int endRow = std::min(beginRow + INTEGRAL_STRIP_ROW_COUNT, mHeight);
+
+                for (int y = beginRow; y < endRow; ++y)
+                {
+                    const Pixel* const pSrc = srcView.GetRow(y);
+                    Entry* const pRow = mpEntries + (y + 1) * stride;
+
+                    pRow[0] = Entry();
+
+                    uint64_t sumB = 0;
+                    uint64_t sumG = 0;
+                    uint64_t sumR = 0;
+                    uint64_t squaredSumB = 0;
+                    uint64_t squaredSumG = 0;
+                    uint64_t squaredSumR = 0;
+
+                    if (y == beginRow)
+                    {
+                        for (int x = 0; x < mWidth; ++x)
+                        {
+                            const Pixel pixel = pSrc[x];
+
+                            sumB += pixel.rgba.b;
+                            sumG += pixel.rgba.g;
+                            sumR += pixel.rgba.r;
+                            squaredSumB += pixel.rgba.b * pixel.rgba.b;
+                            squaredSumG += pixel.rgba.g * pixel.rgba.g;
+                            squaredSumR += pixel.rgba.r * pixel.rgba.r;
+
+                            Entry& entry = pRow[x + 1];
+                            entry.Sums[0] = sumB;
+                            entry.Sums[1] = sumG;
+                            entry.Sums[2] = sumR;
+                            entry.SquaredSums[0] = squaredSumB;
+                            entry.SquaredSums[1] = squaredSumG;
+                            entry.SquaredSums[2] = squaredSumR;
+                        }
+
+                        continue;
+                    }
+
+                    const Entry* const pAbove = pRow - stride;
+                    for (int x = 0; x < mWidth; ++x)
+                    {
+                        const Pixel pixel = pSrc[x];
+
+                        sumB += pixel.rgba.b;
+                        sumG += pixel.rgba.g;
+                        sumR += pixel.rgba.r;
+                        squaredSumB += pixel.rgba.b * pixel.rgba.b;
+                        squaredSumG += pixel.rgba.g * pixel.rgba.g;
+                        squaredSumR += pixel.rgba.r * pixel.rgba.r;
+
+                        const Entry& above = pAbove[x + 1];
+                        Entry& entry = pRow[x + 1];
+                        entry.Sums[0] = above.Sums[0] + sumB;
+                        entry.Sums[1] = above.Sums[1] + sumG;
+                        entry.Sums[2] = above.Sums[2] + sumR;
+                        entry.SquaredSums[0] = above.SquaredSums[0] + squaredSumB;
+                        entry.SquaredSums[1] = above.SquaredSums[1] + squaredSumG;
+                        entry.SquaredSums[2] = above.SquaredSums[2] + squaredSumR;
+                    }
+                }
+            }
+        });
+
+    // carry rows from the last row of every strip, mStripCount rows instead of another pass over the table
+    const int64_t columnsPerTask = std::max<int64_t>(1, DEFAULT_GRAIN_PIXEL_COUNT / std::max(1, mStripCount));
+    TaskScheduler::GetInstance()->ParallelFor(0, stride, columnsPerTask, [&](const int64_t beginColumn, const int64_t endColumn)
+        {
+            for (int strip = 1; strip < mStripCount; ++strip)
+            {
+                const Entry* const pPreviousCarry = mpCarryRows + (strip - 1) * stride;
+                const Entry* const pLastRow = mpEntries + static_cast<int64_t>(strip) * INTEGRAL_STRIP_ROW_COUNT * stride;
+                Entry* const pCarry = mpCarryRows + strip * stride;
+
+                for (int64_t x = beginColumn; x < endColumn; ++x)
+                {
+                    for (int color = 0; color < COLOR_COUNT; ++color)
+                    {
+                        pCarry[x].Sums[color] = pPreviousCarry[x].Sums[color] + pLastRow[x].Sums[color];
+                        pCarry[x].SquaredSums[color] = pPreviousCarry[x].SquaredSums[color] + pLastRow[x].SquaredSums[color];
+                    }
+                }
+            }
+        });
+}
+
+void IntegralImage::Build(const Image& srcImage)
+{
+    Build(srcImage.GetView());
+}
+
+void IntegralImage::Clear()
+{
+    PixelBufferPool& pool = *PixelBufferPool::GetInstance();
+
+    if (mpEntries != nullptr)
+    {
+        pool.Release(mpEntries);
+        mpEntries = nullptr;
+    }
+
+    if (mpCarryRows != nullptr)
+    {
+        pool.Release(mpCarryRows);
+        mpCarryRows = nullptr;
+    }
+
+    mWidth = 0;
+    mHeight = 0;
+    mStripCount = 0;
+}
+
+void IntegralImage::GetRegionSums(const int x, const int y, const int width, const int height, RegionSums& outSums) const
+{
+    assert(width >= 0);
+    assert(height >= 0);
+
+    outSums = RegionSums();
+
+    const int left = std::max(x, 0);
+    const int top = std::max(y, 0);
+    const int right = std::min(x + width, mWidth);
+    const int bottom = std::min(y + height, mHeight);
+
+    if (left >= right || top >= bottom)
+    {
+        return;
+    }
+
+    Entry topLeft;
+    Entry topRight;
+    Entry bottomLeft;
+    Entry bottomRight;
+    loadEntry(left, top, topLeft);
+    loadEntry(right, top, topRight);
+    loadEntry(left, bottom, bottomLeft);
+    loadEntry(right, bottom, bottomRight);
+
+    // wraps around in between, the result is exact
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        outSums.Sums[color] = bottomRight.Sums[color] - topRight.Sums[color] - bottomLeft.Sums[color] + topLeft.Sums[color];
+        outSums.SquaredSums[color] = bottomRight.SquaredSums[color] - topRight.SquaredSums[color] - bottomLeft.SquaredSums[color] + topLeft.SquaredSums[color];
+    }
+
+    outSums.PixelCount = static_cast<int64_t>(right - left) * (bottom - top);
+}
+
+void IntegralImage::GetRegionStatistics(const int x, const int y, const int width, const int height, RegionStatistics& outStatistics) const
+{
+    RegionSums sums;
+    GetRegionSums(x, y, width, height, sums);
+
+    outStatistics = RegionStatistics();
+    outStatistics.PixelCount = sums.PixelCount;
+
+    if (sums.PixelCount == 0)
+    {
+        return;
+    }
+
+    const double pixelCount = static_cast<double>(sums.PixelCount);
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        const double mean = sums.Sums[color] / pixelCount;
+
+        outStatistics.Means[color] = mean;
+
+        // E[x^2] - E[x]^2, cancellation may leave a tiny negative
+        outStatistics.Variances[color] = std::max(0.0, sums.SquaredSums[color] / pixelCount - mean * mean);
+    }
+
+    // bgr, same weights as ComputeGrayBrightness
+    outStatistics.Brightness = outStatistics.Means[2] * 0.299 + outStatistics.Means[1] * 0.587 + outStatistics.Means[0] * 0.114;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+#include "Image.h"
+
+enum EIntegralImageConstant
+{
+    // rows summed by one task, every strip starts from zero
+    INTEGRAL_STRIP_ROW_COUNT = 64
+};
+
+// summed area tables of the color channels and of their squares, alpha is ignored.
+// sum, mean and variance of any rectangle take four lookups whatever its size, so local statistics
+// over a window around every pixel cost O(1) per pixel. 64 bit entries do not overflow, at the price of 48 bytes per pixel
+class IntegralImage final
+{
+public:
+    struct RegionSums
+    {
+        int64_t PixelCount;
+        uint64_t Sums[COLOR_COUNT];
+        uint64_t SquaredSums[COLOR_COUNT];
+    };
+
+    struct RegionStatistics
+    {
+        int64_t PixelCount;
+        double Means[COLOR_COUNT];
+        double Variances[COLOR_COUNT];
+
+        // luma of the means, e.g. for auto exposure
+        double Brightness;
+    };
+
+public:
+    IntegralImage();
+    ~IntegralImage();
+    IntegralImage(const IntegralImage& other) = delete;
+    IntegralImage(IntegralImage&& other) = delete;
+    IntegralImage& operator=(const IntegralImage& other) = delete;
+    IntegralImage& operator=(IntegralImage&& other) = delete;
+
+    // one parallel pass over the source, the previous tables are replaced
+    void Build(const ImageView& srcView);
+    void Build(const Image& srcImage);
+
+    void Clear();
+
+    inline int GetWidth() const;
+    inline int GetHeight() const;
+    inline bool IsEmpty() const;
+
+    // half open rectangle [x, x + width) x [y, y + height) clipped to the image, all zero when nothing is left
+    void GetRegionSums(const int x, const int y, const int width, const int height, RegionSums& outSums) const;
+    void GetRegionStatistics(const int x, const int y, const int width, const int height, RegionStatistics& outStatistics) const;
+
+private:
+    struct Entry
+    {
+        uint64_t Sums[COLOR_COUNT];
+        uint64_t SquaredSums[COLOR_COUNT];
+    };
+
+private:
+    int mWidth;
+    int mHeight;
+    int mStripCount;
+
+    // (mWidth + 1) x (mHeight + 1), entry (x, y) sums [0, x) x [top of the strip of row y - 1, y).
+    // row 0 and column 0 are zero
+    Entry* mpEntries;
+
+    // mStripCount x (mWidth + 1), carry row s sums [0, x) x [0, s * INTEGRAL_STRIP_ROW_COUNT).
+    // strip entry + carry row is the entry of the whole table, the strips need not wait for each other
+    Entry* mpCarryRows;
+
+private:
+    // entry (x, y) of the whole table, [0, x) x [0, y)
+    inline void loadEntry(const int x, const int y, Entry& outEntry) const;
+};
+
+inline int IntegralImage::GetWidth() const
+{
+    return mWidth;
+}
+
+inline int IntegralImage::GetHeight() const
+{
+    return mHeight;
+}
+
+inline bool IntegralImage::IsEmpty() const
+{
+    return mpEntries == nullptr;
+}
+
+inline void IntegralImage::loadEntry(const int x, const int y, Entry& outEntry) const
+{
+    assert(x >= 0 && x <= mWidth);
+    assert(y >= 0 && y <= mHeight);
+
+    if (y == 0)
+    {
+        outEntry = Entry();
+
+        return;
+    }
+
+    const int64_t stride = static_cast<int64_t>(mWidth) + 1;
+    const Entry& stripEntry = mpEntries[y * stride + x];
+    const Entry& carryEntry = mpCarryRows[(y - 1) / INTEGRAL_STRIP_ROW_COUNT * stride + x];
+
+    for (int color = 0; color < COLOR_COUNT; ++color)
+    {
+        outEntry.Sums[color] = stripEntry.Sums[color] + carryEntry.Sums[color];
+        outEntry.SquaredSums[color] = stripEntry.SquaredSums[color] + carryEntry.SquaredSums[color];
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// single slot handoff from one producer to one consumer, a new value replaces the one that has not been taken.
+// lock free, neither side ever waits for the other
+template<typename T>
+class LatestMailbox final
+{
+public:
+    LatestMailbox();
+    ~LatestMailbox();
+    LatestMailbox(const LatestMailbox& other) = delete;
+    LatestMailbox(LatestMailbox&& other) = delete;
+    LatestMailbox& operator=(const LatestMailbox& other) = delete;
+    LatestMailbox& operator=(LatestMailbox&& other) = delete;
+
+    // the replaced value is destroyed on the posting thread
+    void Post(std::unique_ptr<T> value);
+
+    // nullptr when nothing has been posted since the last take
+    std::unique_ptr<T> Take();
+
+private:
+    std::atomic<T*> mpSlot;
+};
+
+template<typename T>
+LatestMailbox<T>::LatestMailbox()
+    : mpSlot(nullptr)
+{
+
+}
+
+template<typename T>
+LatestMailbox<T>::~LatestMailbox()
+{
+    delete mpSlot.load(std::memory_order_acquire);
+}
+
+template<typename T>
+void LatestMailbox<T>::Post(std::unique_ptr<T> value)
+{
+    // release publishes the value, acquire sees the replaced one before deleting it
+    T* const pReplaced = mpSlot.exchange(value.release(), std::memory_order_acq_rel);
+
+    delete pReplaced;
+}
+
+template<typename T>
+std::unique_ptr<T> LatestMailbox<T>::Take()
+{
+    // cheap load first, the exchange is a locked write on every call otherwise
+    if (mpSlot.load(std::memory_order_relaxed) == nullptr)
+    {
+        return nullptr;
+    }
+
+    return std::unique_ptr<T>(mpSlot.exchange(nullptr, std::memory_order_acq_rel));
+}
@@ -0,0 +1,125 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+    : mhFile(INVALID_HANDLE_VALUE)
+    , mhMapping(nullptr)
+#else
+    : mFileDescriptor(-1)
+#endif
+    , mpData(nullptr)
+    , mSize(0)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+    assert(path != nullptr);
+
+    Close();
+
+#ifdef _WIN32
+    mhFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mhFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mhFile, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Close();
+
+        return false;
+    }
+
+    mhMapping = CreateFileMappingA(mhFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mhMapping == nullptr)
+    {
+        Close();
+
+        return false;
+    }
+
+    mpData = static_cast<const uint8_t*>(MapViewOfFile(mhMapping, FILE_MAP_READ, 0, 0, 0));
+    mSize = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    mFileDescriptor = open(path, O_RDONLY);
+    if (mFileDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(mFileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+    {
+        Close();
+
+        return false;
+    }
+
+    void* const pData = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_SHARED, mFileDescriptor, 0);
+    mpData = pData != MAP_FAILED ? static_cast<const uint8_t*>(pData) : nullptr;
+    mSize = static_cast<uint64_t>(fileStatus.st_size);
+#endif
+
+    if (mpData == nullptr)
+    {
+        Close();
+
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (mpData != nullptr)
+    {
+        UnmapViewOfFile(mpData);
+    }
+
+    if (mhMapping != nullptr)
+    {
+        CloseHandle(mhMapping);
+        mhMapping = nullptr;
+    }
+
+    if (mhFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mhFile);
+        mhFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mpData != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(mpData), static_cast<size_t>(mSize));
+    }
+
+    if (mFileDescriptor >= 0)
+    {
+        close(mFileDescriptor);
+        mFileDescriptor = -1;
+    }
+#endif
+
+    mpData = nullptr;
+    mSize = 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+// read only view of a whole file
+class MappedFile final
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile& operator=(MappedFile&& other) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    inline const uint8_t* GetData() const;
+    inline uint64_t GetSize() const;
+
+private:
+#ifdef _WIN32
+    // HANDLE, Windows.h stays out of the header
+    void* mhFile;
+    void* mhMapping;
+#else
+    int mFileDescriptor;
+#endif
+
+    const uint8_t* mpData;
+    uint64_t mSize;
+};
+
+inline const uint8_t* MappedFile::GetData() const
+{
+    return mpData;
+}
+
+inline uint64_t MappedFile::GetSize() const
+{
+    return mSize;
+}
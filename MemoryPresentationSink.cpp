@@ -0,0 +1,30 @@
+#include "MemoryPresentationSink.h"
+
+MemoryPresentationSink::MemoryPresentationSink()
+    : PresentationSink()
+    , mFrame()
+{
+
+}
+
+bool MemoryPresentationSink::resize(const int width, const int height)
+{
+    mFrame = Image(width, height, MAX_CHANNEL_COUNT);
+
+    return true;
+}
+
+bool MemoryPresentationSink::map(const DirtyRect& /*dirtyRect*/, MutableImageView& outView)
+{
+    assert(!mFrame.IsEmpty());
+
+    // sole holder of the pixels, no copy on write
+    outView = mFrame.GetMutableView();
+
+    return true;
+}
+
+void MemoryPresentationSink::unmap(const DirtyRect& /*dirtyRect*/)
+{
+
+}
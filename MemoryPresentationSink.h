@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PresentationSink.h"
+
+// headless sink that keeps the frame in an image, for the benchmark and for checking what a frame uploads
+class MemoryPresentationSink final : public PresentationSink
+{
+public:
+    MemoryPresentationSink();
+    virtual ~MemoryPresentationSink() = default;
+    MemoryPresentationSink(const MemoryPresentationSink& other) = delete;
+    MemoryPresentationSink(MemoryPresentationSink&& other) = delete;
+    MemoryPresentationSink& operator=(const MemoryPresentationSink& other) = delete;
+    MemoryPresentationSink& operator=(MemoryPresentationSink&& other) = delete;
+
+    // empty until the first frame
+    inline const Image& GetFrame() const;
+
+protected:
+    virtual bool resize(const int width, const int height) override;
+    virtual bool map(const DirtyRect& dirtyRect, MutableImageView& outView) override;
+    virtual void unmap(const DirtyRect& dirtyRect) override;
+
+private:
+    Image mFrame;
+};
+
+inline const Image& MemoryPresentationSink::GetFrame() const
+{
+    return mFrame;
+}
@@ -0,0 +1,347 @@
+#include "PixelBufferPool.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "Profiler.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+enum EPixelBufferPoolInternalConstant
+{
+    // a larger idle buffer is taken when it wastes at most 1 / 4 of itself
+    REUSE_SLACK_DIVISOR = 4
+};
+
+static size_t getPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    // VirtualAlloc reserves in units of the allocation granularity
+    return systemInfo.dwAllocationGranularity;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static size_t getLargePageSize()
+{
+#ifdef _WIN32
+    return GetLargePageMinimum();
+#else
+    // transparent huge pages on x64
+    return 2 * 1024 * 1024;
+#endif
+}
+
+static size_t roundUp(const size_t value, const size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+#ifdef _WIN32
+static bool tryEnableLockMemoryPrivilege()
+{
+    HANDLE hToken = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+    {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool bEnabled = false;
+    if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+    {
+        // succeeds without assigning when the account does not hold the privilege
+        bEnabled = AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+    }
+
+    CloseHandle(hToken);
+
+    return bEnabled;
+}
+#endif
+
+PixelBufferPool::PixelBufferPool()
+    : mMutex()
+    , mIdleBlocks()
+    , mLiveBlocks()
+    , mIdleLimitBytes(static_cast<size_t>(DEFAULT_POOL_IDLE_LIMIT_MB) * 1024 * 1024)
+    , mLargePageBytes(getLargePageSize())
+    , mbLargePagesEnabled(false)
+    , mReleaseSerial(0)
+    , mStatistics()
+{
+
+}
+
+PixelBufferPool* PixelBufferPool::GetInstance()
+{
+    // never destroyed, images in other statics may release their pixels after it would have been
+    static PixelBufferPool* const staticInstance = new PixelBufferPool();
+
+    return staticInstance;
+}
+
+void* PixelBufferPool::Acquire(const size_t byteCount)
+{
+    assert(byteCount > 0);
+
+    // counted for the scope of the calling thread, reused buffers included
+    PROFILE_COUNT_ALLOCATION(byteCount);
+
+    const size_t capacity = roundUpCapacity(byteCount);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ++mStatistics.AcquireCount;
+
+    // smallest idle buffer that fits without wasting too much
+    auto iter = mIdleBlocks.lower_bound(capacity);
+    if (iter != mIdleBlocks.end() && iter->first - iter->first / REUSE_SLACK_DIVISOR <= capacity)
+    {
+        void* const pBuffer = iter->second.first;
+        const Block block = iter->second.second;
+
+        mIdleBlocks.erase(iter);
+        mLiveBlocks.emplace(pBuffer, block);
+
+        mStatistics.IdleBytes -= block.Capacity;
+        mStatistics.LiveBytes += block.Capacity;
+        ++mStatistics.ReuseCount;
+
+        return pBuffer;
+    }
+
+    Block block;
+    void* pBuffer = allocateBlock(capacity, block);
+    if (pBuffer == nullptr)
+    {
+        // out of address space or commit, give the idle buffers back and try once more
+        trimTo(0);
+
+        pBuffer = allocateBlock(capacity, block);
+        if (pBuffer == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+    }
+
+    mLiveBlocks.emplace(pBuffer, block);
+
+    mStatistics.LiveBytes += block.Capacity;
+    ++mStatistics.SystemAllocationCount;
+    if (block.bLargePages)
+    {
+        mStatistics.LargePageBytes += block.Capacity;
+    }
+
+    return pBuffer;
+}
+
+void PixelBufferPool::Release(void* pBuffer)
+{
+    if (pBuffer == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto iter = mLiveBlocks.find(pBuffer);
+    assert(iter != mLiveBlocks.end());
+
+    Block block = iter->second;
+    block.ReleaseSerial = ++mReleaseSerial;
+
+    mLiveBlocks.erase(iter);
+    mIdleBlocks.emplace(block.Capacity, std::make_pair(pBuffer, block));
+
+    mStatistics.LiveBytes -= block.Capacity;
+    mStatistics.IdleBytes += block.Capacity;
+
+    if (mStatistics.IdleBytes > mIdleLimitBytes)
+    {
+        trimTo(mIdleLimitBytes);
+    }
+}
+
+bool PixelBufferPool::SetLargePagesEnabled(const bool bEnabled)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!bEnabled)
+    {
+        mbLargePagesEnabled = false;
+
+        return true;
+    }
+
+#ifdef _WIN32
+    if (mLargePageBytes == 0 || !tryEnableLockMemoryPrivilege())
+    {
+        return false;
+    }
+#endif
+
+    mbLargePagesEnabled = true;
+
+    return true;
+}
+
+void PixelBufferPool::SetIdleLimit(const size_t byteCount)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mIdleLimitBytes = byteCount;
+    trimTo(mIdleLimitBytes);
+}
+
+void PixelBufferPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    trimTo(0);
+}
+
+void PixelBufferPool::GetStatistics(Statistics& outStatistics) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    outStatistics = mStatistics;
+}
+
+size_t PixelBufferPool::roundUpCapacity(const size_t byteCount) const
+{
+    if (byteCount <= SMALL_PIXEL_BUFFER_BYTES)
+    {
+        return roundUp(byteCount, PIXEL_BUFFER_ALIGNMENT);
+    }
+
+    // octave of the request split into equal steps, similar sizes land in the same class
+    size_t octave = SMALL_PIXEL_BUFFER_BYTES;
+    while (octave * 2 < byteCount)
+    {
+        octave *= 2;
+    }
+
+    const size_t step = octave / PIXEL_BUFFER_CLASSES_PER_OCTAVE;
+
+    return roundUp(byteCount, step);
+}
+
+void* PixelBufferPool::allocateBlock(const size_t byteCount, Block& outBlock)
+{
+    outBlock.Capacity = byteCount;
+    outBlock.bHeap = byteCount <= SMALL_PIXEL_BUFFER_BYTES;
+    outBlock.bLargePages = false;
+    outBlock.ReleaseSerial = 0;
+
+    if (outBlock.bHeap)
+    {
+#ifdef _WIN32
+        return _aligned_malloc(byteCount, PIXEL_BUFFER_ALIGNMENT);
+#else
+        void* pBuffer = nullptr;
+
+        return posix_memalign(&pBuffer, PIXEL_BUFFER_ALIGNMENT, byteCount) == 0 ? pBuffer : nullptr;
+#endif
+    }
+
+    // pages are aligned far beyond 64 bytes
+    if (mbLargePagesEnabled && byteCount >= mLargePageBytes)
+    {
+        const size_t largeCapacity = roundUp(byteCount, mLargePageBytes);
+
+#ifdef _WIN32
+        void* const pBuffer = VirtualAlloc(nullptr, largeCapacity, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+        void* pBuffer = mmap(nullptr, largeCapacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pBuffer == MAP_FAILED)
+        {
+            pBuffer = nullptr;
+        }
+        else
+        {
+            madvise(pBuffer, largeCapacity, MADV_HUGEPAGE);
+        }
+#endif
+
+        // physically contiguous large pages run out with fragmentation, normal pages still work
+        if (pBuffer != nullptr)
+        {
+            outBlock.Capacity = largeCapacity;
+            outBlock.bLargePages = true;
+
+            return pBuffer;
+        }
+    }
+
+    const size_t pageCapacity = roundUp(byteCount, getPageSize());
+    outBlock.Capacity = pageCapacity;
+
+#ifdef _WIN32
+    return VirtualAlloc(nullptr, pageCapacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* const pBuffer = mmap(nullptr, pageCapacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return pBuffer != MAP_FAILED ? pBuffer : nullptr;
+#endif
+}
+
+void PixelBufferPool::freeBlock(void* pBuffer, const Block& block)
+{
+    if (block.bHeap)
+    {
+#ifdef _WIN32
+        _aligned_free(pBuffer);
+#else
+        free(pBuffer);
+#endif
+
+        return;
+    }
+
+#ifdef _WIN32
+    VirtualFree(pBuffer, 0, MEM_RELEASE);
+#else
+    munmap(pBuffer, block.Capacity);
+#endif
+}
+
+void PixelBufferPool::trimTo(const size_t idleLimitBytes)
+{
+    while (mStatistics.IdleBytes > idleLimitBytes)
+    {
+        auto oldest = mIdleBlocks.begin();
+        for (auto iter = mIdleBlocks.begin(); iter != mIdleBlocks.end(); ++iter)
+        {
+            if (iter->second.second.ReleaseSerial < oldest->second.second.ReleaseSerial)
+            {
+                oldest = iter;
+            }
+        }
+
+        const Block block = oldest->second.second;
+        freeBlock(oldest->second.first, block);
+
+        mStatistics.IdleBytes -= block.Capacity;
+        if (block.bLargePages)
+        {
+            mStatistics.LargePageBytes -= block.Capacity;
+        }
+
+        mIdleBlocks.erase(oldest);
+    }
+}
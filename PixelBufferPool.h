@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+enum EPixelBufferPoolConstant
+{
+    // cache line, also enough for avx 512 loads
+    PIXEL_BUFFER_ALIGNMENT = 64,
+
+    // smaller buffers come from the aligned heap, larger ones from whole pages
+    SMALL_PIXEL_BUFFER_BYTES = 64 * 1024,
+
+    // size classes per power of two, a buffer is at most 1 / 8 larger than requested
+    PIXEL_BUFFER_CLASSES_PER_OCTAVE = 8,
+
+    DEFAULT_POOL_IDLE_LIMIT_MB = 1024
+};
+
+// size bucketed pool of 64 byte aligned buffers for pixels and intermediate images.
+// released buffers stay committed and touched, so acquiring one of a similar size again
+// neither calls the system allocator nor page faults.
+class PixelBufferPool final
+{
+public:
+    struct Statistics
+    {
+        uint64_t AcquireCount;
+        uint64_t ReuseCount;
+        uint64_t SystemAllocationCount;
+
+        size_t LiveBytes;
+        size_t IdleBytes;
+        size_t LargePageBytes;
+    };
+
+public:
+    static PixelBufferPool* GetInstance();
+
+    // uninitialized, never nullptr
+    void* Acquire(const size_t byteCount);
+    void Release(void* pBuffer);
+
+    template<typename T>
+    inline T* AcquireArray(const int64_t count);
+
+    // large pages for buffers of at least one large page.
+    // false when the os refuses, e.g. the account lacks the lock pages in memory privilege
+    bool SetLargePagesEnabled(const bool bEnabled);
+    inline bool IsLargePagesEnabled() const;
+
+    // idle buffers above the limit are returned to the system oldest first
+    void SetIdleLimit(const size_t byteCount);
+    void Trim();
+
+    void GetStatistics(Statistics& outStatistics) const;
+
+private:
+    struct Block
+    {
+        size_t Capacity;
+        bool bHeap;
+        bool bLargePages;
+
+        // release order, trimming frees the oldest idle block first
+        uint64_t ReleaseSerial;
+    };
+
+private:
+    mutable std::mutex mMutex;
+
+    // capacity -> idle buffer
+    std::multimap<size_t, std::pair<void*, Block>> mIdleBlocks;
+    std::unordered_map<void*, Block> mLiveBlocks;
+
+    size_t mIdleLimitBytes;
+    size_t mLargePageBytes;
+    bool mbLargePagesEnabled;
+
+    uint64_t mReleaseSerial;
+    Statistics mStatistics;
+
+private:
+    PixelBufferPool();
+    ~PixelBufferPool() = default;
+    PixelBufferPool(const PixelBufferPool& other) = delete;
+    PixelBufferPool(PixelBufferPool&& other) = delete;
+    PixelBufferPool& operator=(const PixelBufferPool& other) = delete;
+    PixelBufferPool& operator=(PixelBufferPool&& other) = delete;
+
+    size_t roundUpCapacity(const size_t byteCount) const;
+
+    void* allocateBlock(const size_t byteCount, Block& outBlock);
+    void freeBlock(void* pBuffer, const Block& block);
+
+    // mMutex held
+    void trimTo(const size_t idleLimitBytes);
+};
+
+template<typename T>
+inline T* PixelBufferPool::AcquireArray(const int64_t count)
+{
+    assert(count > 0);
+
+    return static_cast<T*>(Acquire(sizeof(T) * static_cast<size_t>(count)));
+}
+
+inline bool PixelBufferPool::IsLargePagesEnabled() const
+{
+    return mbLargePagesEnabled;
+}
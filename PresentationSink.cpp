@@ -0,0 +1,141 @@
+#include "PresentationSink.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "TaskScheduler.h"
+
+PresentationSink::PresentationSink()
+    : mWidth(0)
+    , mHeight(0)
+    , mPresentedVersion(0)
+    , mOpenRect()
+    , mbFrameOpen(false)
+    , mStatistics()
+{
+
+}
+
+bool PresentationSink::Present(const ImageView& frame, const uint64_t version, const DirtyRect& dirtyRect)
+{
+    assert(frame.pPixels != nullptr);
+    assert(version != 0);
+    assert(!mbFrameOpen);
+
+    ++mStatistics.FrameCount;
+
+    // repaints of an unchanged result
+    if (version == mPresentedVersion && frame.Width == mWidth && frame.Height == mHeight)
+    {
+        ++mStatistics.SkipCount;
+
+        return true;
+    }
+
+    DirtyRect rect;
+    if (!prepare(frame.Width, frame.Height, dirtyRect, rect))
+    {
+        return false;
+    }
+
+    if (rect.IsEmpty())
+    {
+        mPresentedVersion = version;
+        ++mStatistics.SkipCount;
+
+        return true;
+    }
+
+    MutableImageView storageView;
+    if (!map(rect, storageView))
+    {
+        return false;
+    }
+
+    const int rectWidth = rect.Right - rect.Left;
+    const int rowsPerTask = std::max(1, DEFAULT_GRAIN_PIXEL_COUNT / rectWidth);
+
+    // rows of a large frame in parallel, a single core does not saturate the copy
+    TaskScheduler::GetInstance()->ParallelFor(rect.Top, rect.Bottom, rowsPerTask, [&](const int64_t beginRow, const int64_t endRow)
+        {
+            for (int64_t y = beginRow; y < endRow; ++y)
+            {
+                memcpy(storageView.GetRow(static_cast<int>(y)) + rect.Left, frame.GetRow(static_cast<int>(y)) + rect.Left, rectWidth * sizeof(Pixel));
+            }
+        });
+
+    unmap(rect);
+
+    mPresentedVersion = version;
+    ++mStatistics.UploadCount;
+    mStatistics.CopiedBytes += static_cast<uint64_t>(rectWidth) * (rect.Bottom - rect.Top) * sizeof(Pixel);
+
+    return true;
+}
+
+bool PresentationSink::BeginFrame(const int width, const int height, const DirtyRect& dirtyRect, MutableImageView& outView)
+{
+    assert(!mbFrameOpen);
+
+    ++mStatistics.FrameCount;
+
+    if (!prepare(width, height, dirtyRect, mOpenRect))
+    {
+        return false;
+    }
+
+    if (!map(mOpenRect, outView))
+    {
+        return false;
+    }
+
+    mbFrameOpen = true;
+
+    return true;
+}
+
+void PresentationSink::EndFrame(const uint64_t version)
+{
+    assert(mbFrameOpen);
+    assert(version != 0);
+
+    unmap(mOpenRect);
+
+    mbFrameOpen = false;
+    mPresentedVersion = version;
+
+    ++mStatistics.DirectCount;
+}
+
+bool PresentationSink::prepare(const int width, const int height, const DirtyRect& dirtyRect, DirtyRect& outRect)
+{
+    assert(width > 0);
+    assert(height > 0);
+
+    if (width != mWidth || height != mHeight)
+    {
+        mWidth = 0;
+        mHeight = 0;
+        mPresentedVersion = 0;
+
+        if (!resize(width, height))
+        {
+            return false;
+        }
+
+        mWidth = width;
+        mHeight = height;
+
+        // the previous frame is gone with the old storage
+        outRect = MakeFullDirtyRect(width, height);
+
+        return true;
+    }
+
+    outRect.Left = std::max(dirtyRect.Left, 0);
+    outRect.Top = std::max(dirtyRect.Top, 0);
+    outRect.Right = std::min(dirtyRect.Right, width);
+    outRect.Bottom = std::min(dirtyRect.Bottom, height);
+
+    return true;
+}
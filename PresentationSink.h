@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+#include "Image.h"
+
+// half open rectangle of a frame that changed since the previous version
+struct DirtyRect
+{
+    int Left;
+    int Top;
+    int Right;
+    int Bottom;
+
+    inline bool IsEmpty() const;
+};
+
+inline DirtyRect MakeFullDirtyRect(const int width, const int height)
+{
+    return DirtyRect{ 0, 0, width, height };
+}
+
+// receives versioned frames and keeps the last one in its storage, e.g. a gpu texture.
+// a frame with the presented version is not copied again, otherwise only the dirty rows are
+class PresentationSink
+{
+public:
+    struct Statistics
+    {
+        uint64_t FrameCount;
+        uint64_t SkipCount;
+        uint64_t UploadCount;
+        uint64_t CopiedBytes;
+
+        // written by the producer between BeginFrame and EndFrame, nothing copied
+        uint64_t DirectCount;
+    };
+
+public:
+    PresentationSink();
+    virtual ~PresentationSink() = default;
+    PresentationSink(const PresentationSink& other) = delete;
+    PresentationSink(PresentationSink&& other) = delete;
+    PresentationSink& operator=(const PresentationSink& other) = delete;
+    PresentationSink& operator=(PresentationSink&& other) = delete;
+
+    // false when the storage could not be written, the frame is presented again next time
+    bool Present(const ImageView& frame, const uint64_t version, const DirtyRect& dirtyRect);
+
+    // the producer writes the next frame straight into the storage instead of an image that is copied afterwards.
+    // the view covers the whole frame, only the rows of dirtyRect have to be written
+    bool BeginFrame(const int width, const int height, const DirtyRect& dirtyRect, MutableImageView& outView);
+    void EndFrame(const uint64_t version);
+
+    // 0 until the first frame
+    inline uint64_t GetPresentedVersion() const;
+    inline const Statistics& GetStatistics() const;
+
+protected:
+    // storage of a frame with another size, every row is dirty afterwards
+    virtual bool resize(const int width, const int height) = 0;
+
+    // view of the whole storage, rows outside of dirtyRect keep the previous frame
+    virtual bool map(const DirtyRect& dirtyRect, MutableImageView& outView) = 0;
+    virtual void unmap(const DirtyRect& dirtyRect) = 0;
+
+private:
+    int mWidth;
+    int mHeight;
+    uint64_t mPresentedVersion;
+
+    // set between BeginFrame and EndFrame
+    DirtyRect mOpenRect;
+    bool mbFrameOpen;
+
+    Statistics mStatistics;
+
+private:
+    // clipped to the frame, the whole frame after a resize
+    bool prepare(const int width, const int height, const DirtyRect& dirtyRect, DirtyRect& outRect);
+};
+
+inline bool DirtyRect::IsEmpty() const
+{
+    return Left >= Right || Top >= Bottom;
+}
+
+inline uint64_t PresentationSink::GetPresentedVersion() const
+{
+    return mPresentedVersion;
+}
+
+inline const PresentationSink::Statistics& PresentationSink::GetStatistics() const
+{
+    return mStatistics;
+}
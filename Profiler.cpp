@@ -0,0 +1,381 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// the calling thread's place in the profiler, registered on its first event
+struct ProfilerThreadState
+{
+    int ThreadIndex;
+    void* pBuffer;
+
+    int Depth;
+    const char* ZoneNames[PROFILER_MAX_DEPTH];
+
+    // running totals, a scope records the difference
+    uint32_t AllocationCount;
+    uint64_t AllocatedBytes;
+
+    char Name[PROFILER_THREAD_NAME_LENGTH];
+};
+
+static thread_local ProfilerThreadState staticThreadState = { -1, nullptr, 0, { nullptr, }, 0, 0, { '\0', } };
+
+std::atomic<bool> Profiler::staticEnabled(false);
+
+static int64_t getSteadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// json string of a scope or thread name, the names are literals so only quotes and backslashes are expected
+static void writeJsonString(FILE* pFile, const char* pText)
+{
+    fputc('"', pFile);
+    for (const char* p = pText; *p != '\0'; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            fputc('\\', pFile);
+        }
+        else if (static_cast<unsigned char>(*p) < 0x20)
+        {
+            continue;
+        }
+
+        fputc(*p, pFile);
+    }
+    fputc('"', pFile);
+}
+
+Profiler::Profiler()
+    : mEpochNanoseconds(getSteadyNanoseconds())
+    , mClearedNanoseconds(0)
+    , mThreadCount(0)
+    , mpThreadBuffers()
+    , mNameMutex()
+    , mThreadNames()
+{
+    for (std::atomic<ThreadBuffer*>& pBuffer : mpThreadBuffers)
+    {
+        pBuffer.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Profiler* Profiler::GetInstance()
+{
+    // never destroyed, threads of other statics may end their scopes after it would have been
+    static Profiler* const staticInstance = new Profiler();
+
+    return staticInstance;
+}
+
+void Profiler::SetEnabled(const bool bEnabled)
+{
+    staticEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* pName)
+{
+    assert(pName != nullptr);
+
+    ProfilerThreadState& state = staticThreadState;
+
+    strncpy(state.Name, pName, PROFILER_THREAD_NAME_LENGTH - 1);
+    state.Name[PROFILER_THREAD_NAME_LENGTH - 1] = '\0';
+
+    // already registered, the name would otherwise be copied on the first event
+    if (state.ThreadIndex >= 0)
+    {
+        std::lock_guard<std::mutex> lock(mNameMutex);
+        memcpy(mThreadNames[state.ThreadIndex], state.Name, PROFILER_THREAD_NAME_LENGTH);
+    }
+}
+
+int64_t Profiler::GetNowNanoseconds() const
+{
+    return getSteadyNanoseconds() - mEpochNanoseconds;
+}
+
+void Profiler::Clear()
+{
+    mClearedNanoseconds.store(GetNowNanoseconds(), std::memory_order_relaxed);
+}
+
+void Profiler::Collect(std::vector<Event>& outEvents) const
+{
+    outEvents.clear();
+
+    const int threadCount = mThreadCount.load(std::memory_order_acquire);
+    for (int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        collectThread(threadIndex, 0, outEvents);
+    }
+}
+
+void Profiler::Summarize(const int64_t windowNanoseconds, std::vector<ZoneStatistics>& outStatistics) const
+{
+    assert(windowNanoseconds > 0);
+
+    outStatistics.clear();
+
+    std::vector<Event> events;
+
+    const int64_t minEndNanoseconds = GetNowNanoseconds() - windowNanoseconds;
+    const int threadCount = mThreadCount.load(std::memory_order_acquire);
+    for (int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        collectThread(threadIndex, minEndNanoseconds, events);
+    }
+
+    for (const Event& event : events)
+    {
+        // the same literal may have a copy per translation unit, the names are compared
+        auto iter = std::find_if(outStatistics.begin(), outStatistics.end(), [&event](const ZoneStatistics& zone)
+            {
+                return zone.Kind == event.Kind && strcmp(zone.pName, event.pName) == 0;
+            });
+
+        if (iter == outStatistics.end())
+        {
+            ZoneStatistics zone = {};
+            zone.pName = event.pName;
+            zone.Kind = event.Kind;
+
+            outStatistics.push_back(zone);
+            iter = outStatistics.end() - 1;
+        }
+
+        const int64_t duration = event.EndNanoseconds - event.BeginNanoseconds;
+
+        ++iter->Count;
+        iter->TotalNanoseconds += duration;
+        iter->MaxNanoseconds = std::max(iter->MaxNanoseconds, duration);
+        iter->TouchedBytes += event.TouchedBytes;
+        iter->AllocationCount += event.AllocationCount;
+        iter->AllocatedBytes += event.AllocatedBytes;
+    }
+
+    std::sort(outStatistics.begin(), outStatistics.end(), [](const ZoneStatistics& lhs, const ZoneStatistics& rhs)
+        {
+            return lhs.TotalNanoseconds > rhs.TotalNanoseconds;
+        });
+}
+
+bool Profiler::WriteChromeTrace(const char* pPath) const
+{
+    assert(pPath != nullptr);
+
+    std::vector<Event> events;
+    Collect(events);
+
+    FILE* pFile = fopen(pPath, "wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", pFile);
+
+    const int threadCount = mThreadCount.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(mNameMutex);
+
+        for (int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+        {
+            char fallbackName[PROFILER_THREAD_NAME_LENGTH];
+            snprintf(fallbackName, sizeof(fallbackName), "thread %d", threadIndex);
+
+            fprintf(pFile, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", threadIndex);
+            writeJsonString(pFile, mThreadNames[threadIndex][0] != '\0' ? mThreadNames[threadIndex] : fallbackName);
+            fputs("}},\n", pFile);
+        }
+    }
+
+    // complete events in microseconds, nesting is recovered from the times per thread
+    for (const Event& event : events)
+    {
+        fputs("{\"ph\":\"X\",\"name\":", pFile);
+        writeJsonString(pFile, event.pName);
+        fprintf(pFile, ",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu,\"allocations\":%u,\"allocated_bytes\":%llu}},\n",
+            event.Kind == PROFILE_EVENT_TASK ? "task" : "scope",
+            event.ThreadIndex,
+            event.BeginNanoseconds / 1000.0,
+            (event.EndNanoseconds - event.BeginNanoseconds) / 1000.0,
+            static_cast<unsigned long long>(event.TouchedBytes),
+            event.AllocationCount,
+            static_cast<unsigned long long>(event.AllocatedBytes));
+    }
+
+    // closes the array without a trailing comma
+    fputs("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"ImageProcessingPractice\"}}\n]}\n", pFile);
+
+    const bool bWritten = ferror(pFile) == 0;
+
+    return fclose(pFile) == 0 && bWritten;
+}
+
+const char* Profiler::GetCurrentZoneName() const
+{
+    const ProfilerThreadState& state = staticThreadState;
+    if (state.Depth <= 0)
+    {
+        return "ParallelFor";
+    }
+
+    return state.ZoneNames[std::min(state.Depth, static_cast<int>(PROFILER_MAX_DEPTH)) - 1];
+}
+
+void Profiler::beginScope(const char* pName, ScopeBegin& outBegin)
+{
+    ProfilerThreadState& state = staticThreadState;
+
+    if (state.Depth < PROFILER_MAX_DEPTH)
+    {
+        state.ZoneNames[state.Depth] = pName;
+    }
+    ++state.Depth;
+
+    outBegin.AllocationCount = state.AllocationCount;
+    outBegin.AllocatedBytes = state.AllocatedBytes;
+    outBegin.Nanoseconds = GetNowNanoseconds();
+}
+
+void Profiler::endScope(const char* pName, const EProfileEventKind kind, const uint64_t touchedBytes, const ScopeBegin& begin)
+{
+    const int64_t endNanoseconds = GetNowNanoseconds();
+
+    ProfilerThreadState& state = staticThreadState;
+
+    assert(state.Depth > 0);
+    --state.Depth;
+
+    int threadIndex;
+    ThreadBuffer* const pBuffer = getThreadBuffer(threadIndex);
+    if (pBuffer == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t index = pBuffer->ClaimedCount.load(std::memory_order_relaxed);
+
+    pBuffer->ClaimedCount.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot& slot = pBuffer->Slots[index % PROFILER_RING_EVENT_COUNT];
+    slot.pName.store(pName, std::memory_order_relaxed);
+    slot.KindAndDepth.store(static_cast<uint32_t>(kind) << 16 | static_cast<uint32_t>(state.Depth), std::memory_order_relaxed);
+    slot.AllocationCount.store(state.AllocationCount - begin.AllocationCount, std::memory_order_relaxed);
+    slot.BeginNanoseconds.store(begin.Nanoseconds, std::memory_order_relaxed);
+    slot.EndNanoseconds.store(endNanoseconds, std::memory_order_relaxed);
+    slot.TouchedBytes.store(touchedBytes, std::memory_order_relaxed);
+    slot.AllocatedBytes.store(state.AllocatedBytes - begin.AllocatedBytes, std::memory_order_relaxed);
+
+    pBuffer->CommittedCount.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::countAllocation(const size_t byteCount)
+{
+    ProfilerThreadState& state = staticThreadState;
+
+    ++state.AllocationCount;
+    state.AllocatedBytes += byteCount;
+}
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer(int& outThreadIndex)
+{
+    ProfilerThreadState& state = staticThreadState;
+    if (state.pBuffer != nullptr)
+    {
+        outThreadIndex = state.ThreadIndex;
+
+        return static_cast<ThreadBuffer*>(state.pBuffer);
+    }
+
+    // the only allocation of the thread, the buffer outlives it so that its events can still be exported
+    std::lock_guard<std::mutex> lock(mNameMutex);
+
+    const int threadIndex = mThreadCount.load(std::memory_order_relaxed);
+    if (threadIndex >= PROFILER_MAX_THREAD_COUNT)
+    {
+        return nullptr;
+    }
+
+    ThreadBuffer* const pBuffer = new ThreadBuffer();
+    pBuffer->ClaimedCount.store(0, std::memory_order_relaxed);
+    pBuffer->CommittedCount.store(0, std::memory_order_relaxed);
+
+    memcpy(mThreadNames[threadIndex], state.Name, PROFILER_THREAD_NAME_LENGTH);
+    mpThreadBuffers[threadIndex].store(pBuffer, std::memory_order_relaxed);
+    mThreadCount.store(threadIndex + 1, std::memory_order_release);
+
+    state.ThreadIndex = threadIndex;
+    state.pBuffer = pBuffer;
+
+    outThreadIndex = threadIndex;
+
+    return pBuffer;
+}
+
+void Profiler::collectThread(const int threadIndex, const int64_t minEndNanoseconds, std::vector<Event>& outEvents) const
+{
+    const ThreadBuffer* const pBuffer = mpThreadBuffers[threadIndex].load(std::memory_order_relaxed);
+    assert(pBuffer != nullptr);
+
+    const int64_t clearedNanoseconds = mClearedNanoseconds.load(std::memory_order_relaxed);
+
+    const uint64_t committedCount = pBuffer->CommittedCount.load(std::memory_order_acquire);
+    const uint64_t firstIndex = committedCount > PROFILER_RING_EVENT_COUNT ? committedCount - PROFILER_RING_EVENT_COUNT : 0;
+
+    // newest first, the events end in order so the scan stops at the first one outside of the window
+    const size_t previousSize = outEvents.size();
+    uint64_t index = committedCount;
+    while (index > firstIndex)
+    {
+        --index;
+
+        const Slot& slot = pBuffer->Slots[index % PROFILER_RING_EVENT_COUNT];
+
+        Event event;
+        event.pName = slot.pName.load(std::memory_order_relaxed);
+        event.EndNanoseconds = slot.EndNanoseconds.load(std::memory_order_relaxed);
+        if (event.EndNanoseconds < minEndNanoseconds)
+        {
+            ++index;
+            break;
+        }
+
+        const uint32_t kindAndDepth = slot.KindAndDepth.load(std::memory_order_relaxed);
+        event.Kind = static_cast<EProfileEventKind>(kindAndDepth >> 16);
+        event.Depth = static_cast<int>(kindAndDepth & 0xFFFF);
+        event.ThreadIndex = threadIndex;
+        event.BeginNanoseconds = slot.BeginNanoseconds.load(std::memory_order_relaxed);
+        event.TouchedBytes = slot.TouchedBytes.load(std::memory_order_relaxed);
+        event.AllocationCount = slot.AllocationCount.load(std::memory_order_relaxed);
+        event.AllocatedBytes = slot.AllocatedBytes.load(std::memory_order_relaxed);
+
+        outEvents.push_back(event);
+    }
+
+    // slots claimed again while they were copied may be torn, they are the oldest ones
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t claimedCount = pBuffer->ClaimedCount.load(std::memory_order_relaxed);
+    const uint64_t validIndex = claimedCount > PROFILER_RING_EVENT_COUNT ? claimedCount - PROFILER_RING_EVENT_COUNT : 0;
+
+    // outEvents holds the indices committedCount - 1 down to index
+    const uint64_t copiedCount = committedCount - index;
+    const uint64_t validCount = committedCount > validIndex ? std::min(copiedCount, committedCount - validIndex) : 0;
+    outEvents.resize(previousSize + static_cast<size_t>(validCount));
+
+    auto iter = std::remove_if(outEvents.begin() + previousSize, outEvents.end(), [clearedNanoseconds](const Event& event)
+        {
+            return event.BeginNanoseconds < clearedNanoseconds;
+        });
+    outEvents.erase(iter, outEvents.end());
+
+    std::reverse(outEvents.begin() + previousSize, outEvents.end());
+}
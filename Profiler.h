@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// 0 compiles every PROFILE_ macro away
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+enum EProfilerConstant
+{
+    // events kept per thread, the oldest are overwritten
+    PROFILER_RING_EVENT_COUNT = 1 << 15,
+
+    // threads beyond are not recorded
+    PROFILER_MAX_THREAD_COUNT = 128,
+
+    PROFILER_MAX_DEPTH = 64,
+    PROFILER_THREAD_NAME_LENGTH = 32
+};
+
+enum EProfileEventKind
+{
+    PROFILE_EVENT_SCOPE,
+
+    // a range of a ParallelFor, named after the scope that started the loop
+    PROFILE_EVENT_TASK
+};
+
+// scoped timers written to a ring per thread, read by the control panel and the chrome trace export.
+// a disabled profiler costs a relaxed load per scope, a recorded scope two clock reads and a few stores,
+// nothing is allocated after the first event of a thread
+class Profiler final
+{
+public:
+    struct Event
+    {
+        // string literal of the scope
+        const char* pName;
+        EProfileEventKind Kind;
+        int ThreadIndex;
+        int Depth;
+
+        // since the profiler was created
+        int64_t BeginNanoseconds;
+        int64_t EndNanoseconds;
+
+        // bytes read and written as declared by the scope, 0 when unknown
+        uint64_t TouchedBytes;
+
+        // pixel buffers acquired by the thread within the scope, nested scopes included
+        uint32_t AllocationCount;
+        uint64_t AllocatedBytes;
+    };
+
+    struct ZoneStatistics
+    {
+        const char* pName;
+        EProfileEventKind Kind;
+
+        uint64_t Count;
+        int64_t TotalNanoseconds;
+        int64_t MaxNanoseconds;
+        uint64_t TouchedBytes;
+        uint64_t AllocationCount;
+        uint64_t AllocatedBytes;
+    };
+
+public:
+    static Profiler* GetInstance();
+
+    inline static bool IsEnabled();
+    void SetEnabled(const bool bEnabled);
+
+    // shown for the events of the calling thread, e.g. "worker 3"
+    void SetThreadName(const char* pName);
+
+    int64_t GetNowNanoseconds() const;
+
+    // events that began before are no longer collected
+    void Clear();
+
+    // recorded events of every thread, per thread in the order they ended
+    void Collect(std::vector<Event>& outEvents) const;
+
+    // totals per scope name of the events that ended within the last windowNanoseconds, the slowest first
+    void Summarize(const int64_t windowNanoseconds, std::vector<ZoneStatistics>& outStatistics) const;
+
+    // chrome://tracing or perfetto json of the collected events, false when the file can not be written
+    bool WriteChromeTrace(const char* pPath) const;
+
+    // innermost scope of the calling thread, "ParallelFor" outside of any
+    const char* GetCurrentZoneName() const;
+
+    inline static void CountAllocation(const size_t byteCount);
+
+private:
+    friend class ProfileScope;
+
+    struct Slot
+    {
+        // the fields are atomic so that a reader may race the owner, torn events are discarded
+        std::atomic<const char*> pName;
+        std::atomic<uint32_t> KindAndDepth;
+        std::atomic<uint32_t> AllocationCount;
+        std::atomic<int64_t> BeginNanoseconds;
+        std::atomic<int64_t> EndNanoseconds;
+        std::atomic<uint64_t> TouchedBytes;
+        std::atomic<uint64_t> AllocatedBytes;
+    };
+
+    // written by its thread only. ClaimedCount goes up before a slot is overwritten and CommittedCount after,
+    // a reader keeps the slots that were not claimed again while it copied them
+    struct ThreadBuffer
+    {
+        std::atomic<uint64_t> ClaimedCount;
+        std::atomic<uint64_t> CommittedCount;
+        Slot Slots[PROFILER_RING_EVENT_COUNT];
+    };
+
+    // scope state kept in the ProfileScope on the stack
+    struct ScopeBegin
+    {
+        int64_t Nanoseconds;
+        uint32_t AllocationCount;
+        uint64_t AllocatedBytes;
+    };
+
+private:
+    static std::atomic<bool> staticEnabled;
+
+    const int64_t mEpochNanoseconds;
+    std::atomic<int64_t> mClearedNanoseconds;
+
+    std::atomic<int> mThreadCount;
+    std::atomic<ThreadBuffer*> mpThreadBuffers[PROFILER_MAX_THREAD_COUNT];
+
+    mutable std::mutex mNameMutex;
+    char mThreadNames[PROFILER_MAX_THREAD_COUNT][PROFILER_THREAD_NAME_LENGTH];
+
+private:
+    Profiler();
+    ~Profiler() = default;
+    Profiler(const Profiler& other) = delete;
+    Profiler(Profiler&& other) = delete;
+    Profiler& operator=(const Profiler& other) = delete;
+    Profiler& operator=(Profiler&& other) = delete;
+
+    void beginScope(const char* pName, ScopeBegin& outBegin);
+    void endScope(const char* pName, const EProfileEventKind kind, const uint64_t touchedBytes, const ScopeBegin& begin);
+
+    void countAllocation(const size_t byteCount);
+
+    // nullptr once PROFILER_MAX_THREAD_COUNT threads are registered
+    ThreadBuffer* getThreadBuffer(int& outThreadIndex);
+
+    // events of one thread that ended at or after minEndNanoseconds
+    void collectThread(const int threadIndex, const int64_t minEndNanoseconds, std::vector<Event>& outEvents) const;
+};
+
+class ProfileScope final
+{
+public:
+    inline ProfileScope(const char* pName, const EProfileEventKind kind, const uint64_t touchedBytes);
+    inline ~ProfileScope();
+    ProfileScope(const ProfileScope& other) = delete;
+    ProfileScope(ProfileScope&& other) = delete;
+    ProfileScope& operator=(const ProfileScope& other) = delete;
+    ProfileScope& operator=(ProfileScope&& other) = delete;
+
+private:
+    const char* mpName;
+    EProfileEventKind mKind;
+    uint64_t mTouchedBytes;
+
+    bool mbActive;
+    Profiler::ScopeBegin mBegin;
+};
+
+inline bool Profiler::IsEnabled()
+{
+    return staticEnabled.load(std::memory_order_relaxed);
+}
+
+inline void Profiler::CountAllocation(const size_t byteCount)
+{
+    if (IsEnabled())
+    {
+        GetInstance()->countAllocation(byteCount);
+    }
+}
+
+inline ProfileScope::ProfileScope(const char* pName, const EProfileEventKind kind, const uint64_t touchedBytes)
+    : mpName(pName)
+    , mKind(kind)
+    , mTouchedBytes(touchedBytes)
+    , mbActive(Profiler::IsEnabled())
+{
+    assert(pName != nullptr);
+
+    if (mbActive)
+    {
+        Profiler::GetInstance()->beginScope(mpName, mBegin);
+    }
+}
+
+inline ProfileScope::~ProfileScope()
+{
+    if (mbActive)
+    {
+        Profiler::GetInstance()->endScope(mpName, mKind, mTouchedBytes, mBegin);
+    }
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+
+// name has to be a string literal or outlive the profiler
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)((name), PROFILE_EVENT_SCOPE, 0)
+#define PROFILE_SCOPE_BYTES(name, touchedBytes) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)((name), PROFILE_EVENT_SCOPE, static_cast<uint64_t>(touchedBytes))
+#define PROFILE_TASK(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)((name), PROFILE_EVENT_TASK, 0)
+#define PROFILE_CURRENT_ZONE_NAME() (Profiler::GetInstance()->GetCurrentZoneName())
+#define PROFILE_COUNT_ALLOCATION(byteCount) Profiler::CountAllocation(byteCount)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_SCOPE_BYTES(name, touchedBytes)
+#define PROFILE_TASK(name)
+#define PROFILE_CURRENT_ZONE_NAME() ("ParallelFor")
+#define PROFILE_COUNT_ALLOCATION(byteCount)
+
+#endif
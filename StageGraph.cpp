@@ -0,0 +1,156 @@
+#include "StageGraph.h"
+
+#include <algorithm>
+
+StageKey::StageKey()
+    : mValue(14695981039346656037ull)
+{
+
+}
+
+StageKey& StageKey::Add(const std::string& value)
+{
+    const uint64_t length = value.size();
+
+    addBytes(&length, sizeof(length));
+    addBytes(value.data(), value.size());
+
+    return *this;
+}
+
+void StageKey::addBytes(const void* pData, const size_t byteCount)
+{
+    const uint8_t* const pBytes = static_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < byteCount; ++i)
+    {
+        mValue ^= pBytes[i];
+        mValue *= 1099511628211ull;
+    }
+}
+
+StageNodeBase::StageNodeBase(const char* name, StageGraph& graph)
+    : mName(name)
+    , mGraph(graph)
+    , mHitCount(0)
+    , mMissCount(0)
+    , mEntryInfos()
+    , mCachedBytes(0)
+{
+    assert(name != nullptr);
+
+    mGraph.registerNode(this);
+}
+
+StageNodeBase::~StageNodeBase()
+{
+    mGraph.unregisterNode(this);
+}
+
+int StageNodeBase::findEntry(const uint64_t key) const
+{
+    for (int i = 0; i < static_cast<int>(mEntryInfos.size()); ++i)
+    {
+        if (mEntryInfos[i].Key == key)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void StageNodeBase::touchEntry(const int index)
+{
+    mEntryInfos[index].LastUseGeneration = mGraph.GetGeneration();
+}
+
+void StageNodeBase::addEntry(const uint64_t key, const size_t byteCount)
+{
+    EntryInfo info;
+    info.Key = key;
+    info.LastUseGeneration = mGraph.GetGeneration();
+    info.ByteCount = byteCount;
+
+    mEntryInfos.push_back(info);
+    mCachedBytes += byteCount;
+}
+
+void StageNodeBase::eraseEntry(const int index)
+{
+    assert(index >= 0 && index < static_cast<int>(mEntryInfos.size()));
+
+    mCachedBytes -= mEntryInfos[index].ByteCount;
+    mEntryInfos.erase(mEntryInfos.begin() + index);
+}
+
+StageGraph::StageGraph(const size_t memoryBudgetBytes)
+    : mMemoryBudgetBytes(memoryBudgetBytes)
+    , mGeneration(0)
+    , mNodes()
+{
+
+}
+
+void StageGraph::BeginUpdate()
+{
+    ++mGeneration;
+}
+
+void StageGraph::EndUpdate()
+{
+    size_t cachedBytes = 0;
+    for (const StageNodeBase* pNode : mNodes)
+    {
+        cachedBytes += pNode->GetCachedBytes();
+    }
+
+    while (cachedBytes > mMemoryBudgetBytes)
+    {
+        // least recently used entry over all nodes, outputs of this update are pinned
+        StageNodeBase* pOldestNode = nullptr;
+        int oldestIndex = -1;
+        uint64_t oldestGeneration = mGeneration;
+
+        for (StageNodeBase* pNode : mNodes)
+        {
+            for (int i = 0; i < static_cast<int>(pNode->mEntryInfos.size()); ++i)
+            {
+                if (pNode->mEntryInfos[i].LastUseGeneration < oldestGeneration)
+                {
+                    pOldestNode = pNode;
+                    oldestIndex = i;
+                    oldestGeneration = pNode->mEntryInfos[i].LastUseGeneration;
+                }
+            }
+        }
+
+        if (pOldestNode == nullptr)
+        {
+            break;
+        }
+
+        cachedBytes -= pOldestNode->mEntryInfos[oldestIndex].ByteCount;
+        pOldestNode->eraseEntry(oldestIndex);
+    }
+}
+
+void StageGraph::Clear()
+{
+    for (StageNodeBase* pNode : mNodes)
+    {
+        while (!pNode->mEntryInfos.empty())
+        {
+            pNode->eraseEntry(static_cast<int>(pNode->mEntryInfos.size()) - 1);
+        }
+    }
+}
+
+void StageGraph::registerNode(StageNodeBase* pNode)
+{
+    mNodes.push_back(pNode);
+}
+
+void StageGraph::unregisterNode(StageNodeBase* pNode)
+{
+    mNodes.erase(std::remove(mNodes.begin(), mNodes.end(), pNode), mNodes.end());
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Image.h"
+
+enum EStageGraphConstant
+{
+    DEFAULT_STAGE_MEMORY_BUDGET_MB = 512
+};
+
+// identity of a stage output, the parameters of the stage and the keys of its inputs folded with FNV-1a
+class StageKey final
+{
+public:
+    StageKey();
+
+    template<typename T>
+    StageKey& Add(const T& value);
+    StageKey& Add(const std::string& value);
+
+    inline uint64_t GetValue() const;
+
+private:
+    uint64_t mValue;
+
+private:
+    void addBytes(const void* pData, const size_t byteCount);
+};
+
+class StageGraph;
+
+// hit / miss counters and the cached entries of one stage, the outputs are held by StageNode<T>
+class StageNodeBase
+{
+    friend StageGraph;
+
+public:
+    StageNodeBase(const char* name, StageGraph& graph);
+    virtual ~StageNodeBase();
+    StageNodeBase(const StageNodeBase& other) = delete;
+    StageNodeBase(StageNodeBase&& other) = delete;
+    StageNodeBase& operator=(const StageNodeBase& other) = delete;
+    StageNodeBase& operator=(StageNodeBase&& other) = delete;
+
+    inline const char* GetName() const;
+    inline uint64_t GetHitCount() const;
+    inline uint64_t GetMissCount() const;
+    inline int GetCachedCount() const;
+    inline size_t GetCachedBytes() const;
+
+protected:
+    struct EntryInfo
+    {
+        uint64_t Key;
+        uint64_t LastUseGeneration;
+        size_t ByteCount;
+    };
+
+protected:
+    const char* mName;
+    StageGraph& mGraph;
+
+    uint64_t mHitCount;
+    uint64_t mMissCount;
+
+    // parallel to the outputs of StageNode<T>
+    std::vector<EntryInfo> mEntryInfos;
+    size_t mCachedBytes;
+
+protected:
+    int findEntry(const uint64_t key) const;
+    void touchEntry(const int index);
+    void addEntry(const uint64_t key, const size_t byteCount);
+
+    virtual void eraseEntry(const int index);
+};
+
+// outputs of one stage keyed by StageKey, several keys stay cached so that toggling back is a hit
+template<typename T>
+class StageNode final : public StageNodeBase
+{
+public:
+    StageNode(const char* name, StageGraph& graph);
+    virtual ~StageNode() = default;
+
+    // cached output or nullptr, counts a hit or a miss
+    T* Find(const uint64_t key);
+
+    // compute(T& outValue) runs on a miss only, nullptr when it fails
+    template<typename ComputeFunc>
+    T* Get(const uint64_t key, ComputeFunc compute);
+
+    T& Insert(const uint64_t key, T&& value);
+
+private:
+    // stable addresses, the current outputs are referenced until they are evicted
+    std::vector<std::unique_ptr<T>> mValues;
+
+private:
+    virtual void eraseEntry(const int index) override;
+};
+
+// memory budget over the nodes, entries that were not used by the current update are evicted oldest first
+class StageGraph final
+{
+    friend StageNodeBase;
+
+public:
+    StageGraph(const size_t memoryBudgetBytes);
+    ~StageGraph() = default;
+    StageGraph(const StageGraph& other) = delete;
+    StageGraph(StageGraph&& other) = delete;
+    StageGraph& operator=(const StageGraph& other) = delete;
+    StageGraph& operator=(StageGraph&& other) = delete;
+
+    void BeginUpdate();
+    void EndUpdate();
+
+    // drops every cached output, e.g. when the source image changes
+    void Clear();
+
+    inline uint64_t GetGeneration() const;
+    inline size_t GetMemoryBudget() const;
+    inline const std::vector<StageNodeBase*>& GetNodes() const;
+
+private:
+    size_t mMemoryBudgetBytes;
+    uint64_t mGeneration;
+
+    std::vector<StageNodeBase*> mNodes;
+
+private:
+    void registerNode(StageNodeBase* pNode);
+    void unregisterNode(StageNodeBase* pNode);
+};
+
+template<typename T>
+inline size_t GetStageByteCount(const T& value)
+{
+    return sizeof(value);
+}
+
+inline size_t GetStageByteCount(const Image& image)
+{
+    return sizeof(Image) + sizeof(Pixel) * static_cast<size_t>(image.GetPixelCount());
+}
+
+template<typename T>
+StageKey& StageKey::Add(const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "stage parameters are hashed by their bytes");
+
+    addBytes(&value, sizeof(T));
+
+    return *this;
+}
+
+inline uint64_t StageKey::GetValue() const
+{
+    return mValue;
+}
+
+inline const char* StageNodeBase::GetName() const
+{
+    return mName;
+}
+
+inline uint64_t StageNodeBase::GetHitCount() const
+{
+    return mHitCount;
+}
+
+inline uint64_t StageNodeBase::GetMissCount() const
+{
+    return mMissCount;
+}
+
+inline int StageNodeBase::GetCachedCount() const
+{
+    return static_cast<int>(mEntryInfos.size());
+}
+
+inline size_t StageNodeBase::GetCachedBytes() const
+{
+    return mCachedBytes;
+}
+
+template<typename T>
+StageNode<T>::StageNode(const char* name, StageGraph& graph)
+    : StageNodeBase(name, graph)
+    , mValues()
+{
+
+}
+
+template<typename T>
+T* StageNode<T>::Find(const uint64_t key)
+{
+    const int index = findEntry(key);
+    if (index < 0)
+    {
+        ++mMissCount;
+
+        return nullptr;
+    }
+
+    ++mHitCount;
+    touchEntry(index);
+
+    return mValues[index].get();
+}
+
+template<typename T>
+template<typename ComputeFunc>
+T* StageNode<T>::Get(const uint64_t key, ComputeFunc compute)
+{
+    T* pValue = Find(key);
+    if (pValue != nullptr)
+    {
+        return pValue;
+    }
+
+    std::unique_ptr<T> value(new T());
+    if (!compute(*value))
+    {
+        return nullptr;
+    }
+
+    return &Insert(key, std::move(*value));
+}
+
+template<typename T>
+T& StageNode<T>::Insert(const uint64_t key, T&& value)
+{
+    const int index = findEntry(key);
+    if (index >= 0)
+    {
+        eraseEntry(index);
+    }
+
+    const size_t byteCount = GetStageByteCount(value);
+
+    mValues.emplace_back(new T(std::move(value)));
+    addEntry(key, byteCount);
+
+    return *mValues.back();
+}
+
+template<typename T>
+void StageNode<T>::eraseEntry(const int index)
+{
+    assert(index >= 0 && index < static_cast<int>(mValues.size()));
+
+    mValues.erase(mValues.begin() + index);
+
+    StageNodeBase::eraseEntry(index);
+}
+
+inline uint64_t StageGraph::GetGeneration() const
+{
+    return mGeneration;
+}
+
+inline size_t StageGraph::GetMemoryBudget() const
+{
+    return mMemoryBudgetBytes;
+}
+
+inline const std::vector<StageNodeBase*>& StageGraph::GetNodes() const
+{
+    return mNodes;
+}
@@ -0,0 +1,301 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "StreamingImage.h"
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+enum EStreamingImageConstant
+{
+    PNM_MAX_VALUE = 255
+};
+
+// header fields are separated by whitespace and '#' comments run to the end of the line
+static bool tryReadHeaderValue(FILE* pFile, int& outValue)
+{
+    int c = fgetc(pFile);
+    while (c != EOF)
+    {
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+            {
+                c = fgetc(pFile);
+            }
+        }
+        else if (!isspace(c))
+        {
+            break;
+        }
+
+        c = fgetc(pFile);
+    }
+
+    if (c == EOF || !isdigit(c))
+    {
+        return false;
+    }
+
+    int64_t value = 0;
+    while (c != EOF && isdigit(c))
+    {
+        value = value * 10 + (c - '0');
+        if (value > INT32_MAX)
+        {
+            return false;
+        }
+
+        c = fgetc(pFile);
+    }
+
+    // exactly one whitespace after the last field, the raster follows
+    if (c != EOF && !isspace(c))
+    {
+        return false;
+    }
+
+    outValue = static_cast<int>(value);
+
+    return true;
+}
+
+ImageRowReader::ImageRowReader()
+    : mpFile(nullptr)
+    , mFirstRowPosition()
+    , mWidth(0)
+    , mHeight(0)
+    , mChannelCount(0)
+    , mNextRow(0)
+    , mRowBuffer()
+{
+
+}
+
+ImageRowReader::~ImageRowReader()
+{
+    Close();
+}
+
+bool ImageRowReader::Open(const char* path)
+{
+    assert(path != nullptr);
+
+    Close();
+
+    mpFile = fopen(path, "rb");
+    if (mpFile == nullptr)
+    {
+        return false;
+    }
+
+    char magic[2];
+    int maxValue = 0;
+    if (fread(magic, 1, sizeof(magic), mpFile) != sizeof(magic) || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')
+        || !tryReadHeaderValue(mpFile, mWidth)
+        || !tryReadHeaderValue(mpFile, mHeight)
+        || !tryReadHeaderValue(mpFile, maxValue)
+        || mWidth <= 0 || mHeight <= 0 || maxValue != PNM_MAX_VALUE
+        || fgetpos(mpFile, &mFirstRowPosition) != 0)
+    {
+        Close();
+
+        return false;
+    }
+
+    mChannelCount = magic[1] == '5' ? 1 : 3;
+    mNextRow = 0;
+
+    return true;
+}
+
+void ImageRowReader::Close()
+{
+    if (mpFile != nullptr)
+    {
+        fclose(mpFile);
+        mpFile = nullptr;
+    }
+
+    mWidth = 0;
+    mHeight = 0;
+    mChannelCount = 0;
+    mNextRow = 0;
+}
+
+bool ImageRowReader::Rewind()
+{
+    assert(mpFile != nullptr);
+
+    if (fsetpos(mpFile, &mFirstRowPosition) != 0)
+    {
+        return false;
+    }
+
+    mNextRow = 0;
+
+    return true;
+}
+
+int ImageRowReader::ReadRows(Pixel* pOutPixels, const int rowCount)
+{
+    assert(mpFile != nullptr);
+    assert(pOutPixels != nullptr);
+    assert(rowCount > 0);
+
+    const int readRowCount = std::min(rowCount, mHeight - mNextRow);
+    if (readRowCount <= 0)
+    {
+        return 0;
+    }
+
+    const int64_t pixelCount = static_cast<int64_t>(mWidth) * readRowCount;
+    const size_t byteCount = static_cast<size_t>(pixelCount * mChannelCount);
+
+    mRowBuffer.resize(byteCount);
+    if (fread(mRowBuffer.data(), 1, byteCount, mpFile) != byteCount)
+    {
+        return 0;
+    }
+
+    const uint8_t* pData = mRowBuffer.data();
+    if (mChannelCount == 1)
+    {
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            Pixel& pixel = pOutPixels[i];
+            pixel.rgba.r = pData[i];
+            pixel.rgba.g = pData[i];
+            pixel.rgba.b = pData[i];
+            pixel.rgba.a = UINT8_MAX;
+        }
+    }
+    else
+    {
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            const uint8_t* const pSubPixels = pData + i * 3;
+
+            Pixel& pixel = pOutPixels[i];
+            pixel.rgba.r = pSubPixels[0];
+            pixel.rgba.g = pSubPixels[1];
+            pixel.rgba.b = pSubPixels[2];
+            pixel.rgba.a = UINT8_MAX;
+        }
+    }
+
+    mNextRow += readRowCount;
+
+    return readRowCount;
+}
+
+ImageRowWriter::ImageRowWriter()
+    : mpFile(nullptr)
+    , mWidth(0)
+    , mHeight(0)
+    , mChannelCount(0)
+    , mWrittenRowCount(0)
+    , mRowBuffer()
+{
+
+}
+
+ImageRowWriter::~ImageRowWriter()
+{
+    Close();
+}
+
+bool ImageRowWriter::Open(const char* path, const int width, const int height, const int channelCount)
+{
+    assert(path != nullptr);
+    assert(width > 0);
+    assert(height > 0);
+    assert(channelCount > 0 && channelCount <= MAX_CHANNEL_COUNT);
+
+    Close();
+
+    mpFile = fopen(path, "wb");
+    if (mpFile == nullptr)
+    {
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mChannelCount = channelCount <= 2 ? 1 : 3;
+    mWrittenRowCount = 0;
+
+    return fprintf(mpFile, "P%c\n%d %d\n%d\n", mChannelCount == 1 ? '5' : '6', mWidth, mHeight, PNM_MAX_VALUE) > 0;
+}
+
+bool ImageRowWriter::Close()
+{
+    if (mpFile == nullptr)
+    {
+        return true;
+    }
+
+    const bool bSucceeded = mWrittenRowCount == mHeight && ferror(mpFile) == 0;
+
+    const bool bClosed = fclose(mpFile) == 0;
+    mpFile = nullptr;
+
+    return bSucceeded && bClosed;
+}
+
+bool ImageRowWriter::WriteRows(const Pixel* pPixels, const int rowCount)
+{
+    assert(mpFile != nullptr);
+    assert(pPixels != nullptr);
+    assert(mWrittenRowCount + rowCount <= mHeight);
+
+    const int64_t pixelCount = static_cast<int64_t>(mWidth) * rowCount;
+    const size_t byteCount = static_cast<size_t>(pixelCount * mChannelCount);
+
+    mRowBuffer.resize(byteCount);
+
+    uint8_t* const pData = mRowBuffer.data();
+    if (mChannelCount == 1)
+    {
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            pData[i] = pPixels[i].rgba.r;
+        }
+    }
+    else
+    {
+        for (int64_t i = 0; i < pixelCount; ++i)
+        {
+            uint8_t* const pSubPixels = pData + i * 3;
+
+            const Pixel pixel = pPixels[i];
+            pSubPixels[0] = pixel.rgba.r;
+            pSubPixels[1] = pixel.rgba.g;
+            pSubPixels[2] = pixel.rgba.b;
+        }
+    }
+
+    if (fwrite(pData, 1, byteCount, mpFile) != byteCount)
+    {
+        return false;
+    }
+
+    mWrittenRowCount += rowCount;
+
+    return true;
+}
+
+bool IsStreamableExtension(const char* path)
+{
+    const char* const pExtension = strrchr(path, '.');
+    if (pExtension == nullptr)
+    {
+        return false;
+    }
+
+    std::string extension(pExtension);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const char c) { return static_cast<char>(tolower(c)); });
+
+    return extension == ".pgm" || extension == ".ppm" || extension == ".pnm";
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "Image.h"
+
+// row streaming for images that do not fit in memory.
+// binary PGM (P5) / PPM (P6) with 8 bit samples, stb can only decode and encode whole frames
+class ImageRowReader final
+{
+public:
+    ImageRowReader();
+    ~ImageRowReader();
+    ImageRowReader(const ImageRowReader& other) = delete;
+    ImageRowReader(ImageRowReader&& other) = delete;
+    ImageRowReader& operator=(const ImageRowReader& other) = delete;
+    ImageRowReader& operator=(ImageRowReader&& other) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    // back to the first row for another pass
+    bool Rewind();
+
+    // bgra pixels, returns the number of rows read
+    int ReadRows(Pixel* pOutPixels, const int rowCount);
+
+    inline int GetWidth() const;
+    inline int GetHeight() const;
+    inline int GetChannelCount() const;
+
+private:
+    FILE* mpFile;
+    fpos_t mFirstRowPosition;
+
+    int mWidth;
+    int mHeight;
+    int mChannelCount;
+    int mNextRow;
+
+    std::vector<uint8_t> mRowBuffer;
+};
+
+class ImageRowWriter final
+{
+public:
+    ImageRowWriter();
+    ~ImageRowWriter();
+    ImageRowWriter(const ImageRowWriter& other) = delete;
+    ImageRowWriter(ImageRowWriter&& other) = delete;
+    ImageRowWriter& operator=(const ImageRowWriter& other) = delete;
+    ImageRowWriter& operator=(ImageRowWriter&& other) = delete;
+
+    // one or two channels are written as PGM, three or four as PPM without alpha
+    bool Open(const char* path, const int width, const int height, const int channelCount);
+
+    // false when the file could not be written completely
+    bool Close();
+
+    bool WriteRows(const Pixel* pPixels, const int rowCount);
+
+private:
+    FILE* mpFile;
+
+    int mWidth;
+    int mHeight;
+    int mChannelCount;
+    int mWrittenRowCount;
+
+    std::vector<uint8_t> mRowBuffer;
+};
+
+bool IsStreamableExtension(const char* path);
+
+inline int ImageRowReader::GetWidth() const
+{
+    return mWidth;
+}
+
+inline int ImageRowReader::GetHeight() const
+{
+    return mHeight;
+}
+
+inline int ImageRowReader::GetChannelCount() const
+{
+    return mChannelCount;
+}
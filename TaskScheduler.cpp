@@ -0,0 +1,236 @@
+#include "TaskScheduler.h"
+
+#include <cstdio>
+#include <algorithm>
+
+#include "Profiler.h"
+
+// queue of the worker running on this thread and its scheduler, nullptr outside of any
+static thread_local const TaskScheduler* staticWorkerScheduler = nullptr;
+static thread_local int staticWorkerQueueIndex = -1;
+
+static int getDefaultWorkerCount()
+{
+    const unsigned int hardwareThreadCount = std::thread::hardware_concurrency();
+
+    return hardwareThreadCount > 1 ? static_cast<int>(hardwareThreadCount) - 1 : 0;
+}
+
+TaskScheduler::TaskScheduler()
+    : TaskScheduler(getDefaultWorkerCount())
+{
+
+}
+
+TaskScheduler::TaskScheduler(const int workerCount)
+    : mWorkers()
+    , mQueues()
+    , mQueuedRangeCount(0)
+    , mSleepMutex()
+    , mWakeCondition()
+    , mbStopping(false)
+{
+    assert(workerCount >= 0);
+
+    // the last queue is shared by external threads
+    mQueues = std::vector<WorkQueue>(workerCount + 1);
+
+    mWorkers.reserve(workerCount);
+    for (int i = 0; i < workerCount; ++i)
+    {
+        mWorkers.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mbStopping = true;
+    }
+    mWakeCondition.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+TaskScheduler* TaskScheduler::GetInstance()
+{
+    static TaskScheduler staticInstance;
+
+    return &staticInstance;
+}
+
+int TaskScheduler::GetThreadCount() const
+{
+    return static_cast<int>(mWorkers.size()) + 1;
+}
+
+void TaskScheduler::ParallelFor(const int64_t begin, const int64_t end, const int64_t grainSize, const RangeFunc& func)
+{
+    assert(begin <= end);
+    assert(grainSize > 0);
+
+    // nothing to share, the caller walks the grains itself
+    if (end - begin <= grainSize || mWorkers.empty())
+    {
+        for (int64_t rangeBegin = begin; rangeBegin < end; rangeBegin += grainSize)
+        {
+            func(rangeBegin, std::min(rangeBegin + grainSize, end));
+        }
+
+        return;
+    }
+
+    Job job;
+    job.pFunc = &func;
+    job.GrainSize = grainSize;
+    job.pZoneName = PROFILE_CURRENT_ZONE_NAME();
+    job.RemainingCount = end - begin;
+
+    const int queueIndex = getQueueIndex();
+
+    execute(queueIndex, { &job, begin, end });
+
+    // help with whatever is queued until the rest of this job, possibly stolen, is finished
+    while (job.RemainingCount.load(std::memory_order_acquire) > 0)
+    {
+        Range range;
+        if (tryAcquire(queueIndex, range))
+        {
+            execute(queueIndex, range);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskScheduler::workerLoop(const int queueIndex)
+{
+    staticWorkerScheduler = this;
+    staticWorkerQueueIndex = queueIndex;
+
+    char threadName[PROFILER_THREAD_NAME_LENGTH];
+    snprintf(threadName, sizeof(threadName), "worker %d", queueIndex);
+    Profiler::GetInstance()->SetThreadName(threadName);
+
+    while (true)
+    {
+        Range range;
+        if (tryAcquire(queueIndex, range))
+        {
+            execute(queueIndex, range);
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWakeCondition.wait(lock, [this]() { return mbStopping || mQueuedRangeCount.load() > 0; });
+
+        if (mbStopping)
+        {
+            return;
+        }
+    }
+}
+
+int TaskScheduler::getQueueIndex() const
+{
+    // workers of another scheduler are external threads here
+    return staticWorkerScheduler == this ? staticWorkerQueueIndex : static_cast<int>(mWorkers.size());
+}
+
+void TaskScheduler::push(const int queueIndex, const Range& range)
+{
+    WorkQueue& queue = mQueues[queueIndex];
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Ranges.push_back(range);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        ++mQueuedRangeCount;
+    }
+    mWakeCondition.notify_one();
+}
+
+bool TaskScheduler::tryPop(const int queueIndex, Range& outRange)
+{
+    WorkQueue& queue = mQueues[queueIndex];
+
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    if (queue.Ranges.empty())
+    {
+        return false;
+    }
+
+    // lifo for the owner, the most recently split piece is still in cache
+    outRange = queue.Ranges.back();
+    queue.Ranges.pop_back();
+
+    --mQueuedRangeCount;
+
+    return true;
+}
+
+bool TaskScheduler::trySteal(const int thiefIndex, Range& outRange)
+{
+    const int queueCount = static_cast<int>(mQueues.size());
+    for (int i = 1; i < queueCount; ++i)
+    {
+        WorkQueue& queue = mQueues[(thiefIndex + i) % queueCount];
+
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Ranges.empty())
+        {
+            continue;
+        }
+
+        // fifo for thieves, the oldest piece is the largest
+        outRange = queue.Ranges.front();
+        queue.Ranges.pop_front();
+
+        --mQueuedRangeCount;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool TaskScheduler::tryAcquire(const int queueIndex, Range& outRange)
+{
+    if (mQueuedRangeCount.load(std::memory_order_relaxed) == 0)
+    {
+        return false;
+    }
+
+    return tryPop(queueIndex, outRange) || trySteal(queueIndex, outRange);
+}
+
+void TaskScheduler::execute(const int queueIndex, Range range)
+{
+    Job& job = *range.pJob;
+
+    // keep splitting, the upper halves become available for stealing
+    while (range.End - range.Begin > job.GrainSize)
+    {
+        const int64_t middle = range.Begin + (range.End - range.Begin) / 2;
+
+        push(queueIndex, { &job, middle, range.End });
+        range.End = middle;
+    }
+
+    {
+        PROFILE_TASK(job.pZoneName);
+
+        (*job.pFunc)(range.Begin, range.End);
+    }
+
+    job.RemainingCount.fetch_sub(range.End - range.Begin, std::memory_order_acq_rel);
+}
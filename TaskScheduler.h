@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+enum ETaskSchedulerConstant
+{
+    // pixels per task, large enough to hide the scheduling cost, small enough to balance
+    DEFAULT_GRAIN_PIXEL_COUNT = 1 << 16
+};
+
+// work stealing scheduler, every worker owns a deque of ranges.
+// a range larger than the grain is split in half, one half is pushed to the bottom of the owner's deque and
+// idle workers steal from the top, which holds the largest pieces.
+// the thread calling ParallelFor helps until its own ranges are done, so nested calls do not dead lock.
+class TaskScheduler final
+{
+public:
+    using RangeFunc = std::function<void(int64_t begin, int64_t end)>;
+
+public:
+    static TaskScheduler* GetInstance();
+
+    // a scheduler of its own, e.g. to check or measure a worker count. everything else shares GetInstance
+    explicit TaskScheduler(const int workerCount);
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler& other) = delete;
+    TaskScheduler(TaskScheduler&& other) = delete;
+    TaskScheduler& operator=(const TaskScheduler& other) = delete;
+    TaskScheduler& operator=(TaskScheduler&& other) = delete;
+
+    int GetThreadCount() const;
+
+    // func(begin, end) over disjoint sub ranges of [begin, end), at most grainSize long
+    void ParallelFor(const int64_t begin, const int64_t end, const int64_t grainSize, const RangeFunc& func);
+
+private:
+    struct Job
+    {
+        const RangeFunc* pFunc;
+        int64_t GrainSize;
+
+        // scope of the caller, the ranges are profiled under its name
+        const char* pZoneName;
+
+        // elements not processed yet
+        std::atomic<int64_t> RemainingCount;
+    };
+
+    struct Range
+    {
+        Job* pJob;
+        int64_t Begin;
+        int64_t End;
+    };
+
+    struct alignas(64) WorkQueue
+    {
+        std::mutex Mutex;
+        std::deque<Range> Ranges;
+    };
+
+private:
+    std::vector<std::thread> mWorkers;
+
+    // one per worker and a shared one for threads outside of the scheduler
+    std::vector<WorkQueue> mQueues;
+
+    std::atomic<int> mQueuedRangeCount;
+    std::mutex mSleepMutex;
+    std::condition_variable mWakeCondition;
+
+    bool mbStopping;
+
+private:
+    // a worker per hardware thread besides the caller
+    TaskScheduler();
+
+    void workerLoop(const int queueIndex);
+
+    int getQueueIndex() const;
+
+    void push(const int queueIndex, const Range& range);
+    bool tryPop(const int queueIndex, Range& outRange);
+    bool trySteal(const int thiefIndex, Range& outRange);
+    bool tryAcquire(const int queueIndex, Range& outRange);
+
+    void execute(const int queueIndex, Range range);
+};
@@ -0,0 +1,160 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "TaskScheduler.h"
+
+enum ETaskSchedulerTestConstant
+{
+    // items of the stealing check, each one sleeps so that an idle worker gets to steal
+    STEAL_ITEM_COUNT = 64,
+    STEAL_ITEM_SLEEP_US = 200,
+
+    NESTED_OUTER_COUNT = 64,
+    NESTED_INNER_COUNT = 1000
+};
+
+static std::atomic<int> staticFailureCount(0);
+
+static void check(const bool bCondition, const char* pWhat, const int workerCount, const int64_t grainSize, const int64_t elementCount)
+{
+    if (!bCondition)
+    {
+        fprintf(stderr, "failed: %s, workers: %d, grain: %lld, elements: %lld\n",
+            pWhat, workerCount, static_cast<long long>(grainSize), static_cast<long long>(elementCount));
+
+        ++staticFailureCount;
+    }
+}
+
+// every index of [begin, end) exactly once, no range longer than the grain
+static void checkCoverage(TaskScheduler& scheduler, const int workerCount, const int64_t begin, const int64_t elementCount, const int64_t grainSize)
+{
+    const int64_t end = begin + elementCount;
+
+    std::unique_ptr<std::atomic<int>[]> visitCounts(new std::atomic<int>[elementCount + 1]);
+    for (int64_t i = 0; i < elementCount; ++i)
+    {
+        visitCounts[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<bool> bRangeValid(true);
+
+    scheduler.ParallelFor(begin, end, grainSize, [&](const int64_t rangeBegin, const int64_t rangeEnd)
+        {
+            if (rangeBegin < begin || rangeEnd > end || rangeBegin >= rangeEnd || rangeEnd - rangeBegin > grainSize)
+            {
+                bRangeValid.store(false, std::memory_order_relaxed);
+
+                return;
+            }
+
+            for (int64_t i = rangeBegin; i < rangeEnd; ++i)
+            {
+                visitCounts[i - begin].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+    bool bEveryIndexOnce = true;
+    for (int64_t i = 0; i < elementCount; ++i)
+    {
+        bEveryIndexOnce = bEveryIndexOnce && visitCounts[i].load(std::memory_order_relaxed) == 1;
+    }
+
+    check(bRangeValid.load(), "range outside of the loop or longer than the grain", workerCount, grainSize, elementCount);
+    check(bEveryIndexOnce, "index not visited exactly once", workerCount, grainSize, elementCount);
+}
+
+// ParallelFor inside a range of another, the caller helps instead of waiting, so this must not dead lock
+static void checkNested(TaskScheduler& scheduler, const int workerCount)
+{
+    std::atomic<int64_t> sum(0);
+
+    scheduler.ParallelFor(0, NESTED_OUTER_COUNT, 1, [&](const int64_t outerBegin, const int64_t outerEnd)
+        {
+            for (int64_t outer = outerBegin; outer < outerEnd; ++outer)
+            {
+                scheduler.ParallelFor(0, NESTED_INNER_COUNT, 16, [&](const int64_t innerBegin, const int64_t innerEnd)
+                    {
+                        sum.fetch_add(innerEnd - innerBegin, std::memory_order_relaxed);
+                    });
+            }
+        });
+
+    check(sum.load() == static_cast<int64_t>(NESTED_OUTER_COUNT) * NESTED_INNER_COUNT, "nested loops lost elements", workerCount, 16, NESTED_INNER_COUNT);
+}
+
+// ranges pushed by the caller end up on the workers
+static void checkStealing(TaskScheduler& scheduler, const int workerCount)
+{
+    std::mutex threadIdMutex;
+    std::set<std::thread::id> threadIds;
+
+    scheduler.ParallelFor(0, STEAL_ITEM_COUNT, 1, [&](const int64_t, const int64_t)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(STEAL_ITEM_SLEEP_US));
+
+            std::lock_guard<std::mutex> lock(threadIdMutex);
+            threadIds.insert(std::this_thread::get_id());
+        });
+
+    check(threadIds.size() > 1, "no range was stolen", workerCount, 1, STEAL_ITEM_COUNT);
+}
+
+int main()
+{
+    const int workerCounts[] = { 0, 1, 3, 7 };
+    const int64_t grainSizes[] = { 1, 7, 64, 1000, DEFAULT_GRAIN_PIXEL_COUNT };
+    const int64_t elementCounts[] = { 0, 1, 999, 100003 };
+
+    for (const int workerCount : workerCounts)
+    {
+        TaskScheduler scheduler(workerCount);
+        check(scheduler.GetThreadCount() == workerCount + 1, "thread count", workerCount, 0, 0);
+
+        for (const int64_t grainSize : grainSizes)
+        {
+            for (const int64_t elementCount : elementCounts)
+            {
+                checkCoverage(scheduler, workerCount, 0, elementCount, grainSize);
+
+                // loops need not start at zero
+                checkCoverage(scheduler, workerCount, -elementCount / 2, elementCount, grainSize);
+            }
+        }
+
+        checkNested(scheduler, workerCount);
+
+        if (workerCount > 0)
+        {
+            checkStealing(scheduler, workerCount);
+        }
+    }
+
+    // the shared instance, a worker of one scheduler is an external thread of another
+    {
+        TaskScheduler scheduler(2);
+        scheduler.ParallelFor(0, 8, 1, [&](const int64_t, const int64_t)
+            {
+                checkCoverage(*TaskScheduler::GetInstance(), TaskScheduler::GetInstance()->GetThreadCount() - 1, 0, 10000, 100);
+            });
+    }
+
+    if (staticFailureCount > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", staticFailureCount.load());
+
+        return EXIT_FAILURE;
+    }
+
+    printf("task scheduler: all checks passed\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include "TexturePresentationSink.h"
+
+#include "PixelBufferPool.h"
+
+TexturePresentationSink::TexturePresentationSink(ID3D11Device* const pDevice, ID3D11DeviceContext* const pDeviceContext)
+    : PresentationSink()
+    , mpDevice(pDevice)
+    , mpDeviceContext(pDeviceContext)
+    , mTextureSets()
+    , mCurrentSetIndex(-1)
+{
+    ASSERT(pDevice != nullptr);
+    ASSERT(pDeviceContext != nullptr);
+}
+
+TexturePresentationSink::~TexturePresentationSink()
+{
+    for (TextureSet& set : mTextureSets)
+    {
+        releaseTextureSet(set);
+    }
+}
+
+bool TexturePresentationSink::resize(const int width, const int height)
+{
+    ASSERT(width > 0);
+    ASSERT(height > 0);
+
+    // a size seen before binds its textures again, the caller uploads every row
+    int setIndex = -1;
+    for (int i = 0; i < TEXTURE_SET_COUNT; ++i)
+    {
+        const TextureSet& set = mTextureSets[i];
+        if (set.pTexture != nullptr && set.Width == width && set.Height == height)
+        {
+            setIndex = i;
+
+            break;
+        }
+    }
+
+    if (setIndex < 0)
+    {
+        // an empty set first, otherwise the one that is not presented
+        for (int i = 0; i < TEXTURE_SET_COUNT && setIndex < 0; ++i)
+        {
+            if (mTextureSets[i].pTexture == nullptr)
+            {
+                setIndex = i;
+            }
+        }
+
+        if (setIndex < 0)
+        {
+            setIndex = (mCurrentSetIndex + 1) % TEXTURE_SET_COUNT;
+        }
+
+        TextureSet& set = mTextureSets[setIndex];
+        releaseTextureSet(set);
+
+        if (!createTextureSet(width, height, set))
+        {
+            mCurrentSetIndex = -1;
+
+            return false;
+        }
+    }
+
+    mCurrentSetIndex = setIndex;
+    mpDeviceContext->PSSetShaderResources(0, 1, &mTextureSets[setIndex].pTextureView);
+
+    return true;
+}
+
+bool TexturePresentationSink::map(const DirtyRect& /*dirtyRect*/, MutableImageView& outView)
+{
+    ASSERT(mCurrentSetIndex >= 0);
+
+    const TextureSet& set = mTextureSets[mCurrentSetIndex];
+
+    outView.pPixels = set.pPixels;
+    outView.Width = set.Width;
+    outView.Height = set.Height;
+    outView.Stride = set.Width;
+    outView.ChannelCount = MAX_CHANNEL_COUNT;
+
+    return true;
+}
+
+void TexturePresentationSink::unmap(const DirtyRect& dirtyRect)
+{
+    ASSERT(mCurrentSetIndex >= 0);
+
+    if (dirtyRect.IsEmpty())
+    {
+        return;
+    }
+
+    const TextureSet& set = mTextureSets[mCurrentSetIndex];
+
+    D3D11_BOX box;
+    box.left = dirtyRect.Left;
+    box.top = dirtyRect.Top;
+    box.front = 0;
+    box.right = dirtyRect.Right;
+    box.bottom = dirtyRect.Bottom;
+    box.back = 1;
+
+    // the runtime copies the rows into memory of its own, the gpu may still read the texture
+    const Pixel* const pFirstPixel = set.pPixels + static_cast<int64_t>(dirtyRect.Top) * set.Width + dirtyRect.Left;
+    mpDeviceContext->UpdateSubresource(set.pTexture, 0, &box, pFirstPixel, set.Width * sizeof(Pixel), 0);
+}
+
+bool TexturePresentationSink::createTextureSet(const int width, const int height, TextureSet& outSet)
+{
+    char msg[EDebugConstant::DEFAULT_BUFFER_SIZE];
+
+    D3D11_TEXTURE2D_DESC imageDesc;
+    imageDesc.Width = width;
+    imageDesc.Height = height;
+    imageDesc.MipLevels = 1;
+    imageDesc.ArraySize = 1;
+    imageDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    imageDesc.SampleDesc.Count = 1;
+    imageDesc.SampleDesc.Quality = 0;
+    imageDesc.Usage = D3D11_USAGE_DEFAULT;
+    imageDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    imageDesc.CPUAccessFlags = 0;
+    imageDesc.MiscFlags = 0;
+
+    HRESULT hr = mpDevice->CreateTexture2D(&imageDesc, nullptr, &outSet.pTexture);
+    if (FAILED(hr))
+    {
+        GetErrorDescription(hr, msg);
+        ASSERT(false, msg);
+
+        return false;
+    }
+
+    hr = mpDevice->CreateShaderResourceView(outSet.pTexture, nullptr, &outSet.pTextureView);
+    if (FAILED(hr))
+    {
+        GetErrorDescription(hr, msg);
+        ASSERT(false, msg);
+
+        releaseTextureSet(outSet);
+
+        return false;
+    }
+
+    outSet.pPixels = PixelBufferPool::GetInstance()->AcquireArray<Pixel>(static_cast<int64_t>(width) * height);
+    outSet.Width = width;
+    outSet.Height = height;
+
+    return true;
+}
+
+void TexturePresentationSink::releaseTextureSet(TextureSet& set)
+{
+    SafeRelease(set.pTextureView);
+    SafeRelease(set.pTexture);
+
+    if (set.pPixels != nullptr)
+    {
+        PixelBufferPool::GetInstance()->Release(set.pPixels);
+        set.pPixels = nullptr;
+    }
+
+    set.Width = 0;
+    set.Height = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "Debug.h"
+#include "ComHelper.h"
+#include "PresentationSink.h"
+
+enum ETexturePresentationConstant
+{
+    // preview level and full resolution, switching between them recreates nothing
+    TEXTURE_SET_COUNT = 2
+};
+
+// shader resource texture bound to slot 0 of the pixel shader.
+// the frame is kept in memory and the dirty rows are handed to UpdateSubresource, which copies them
+// without waiting for the gpu. mapping a staging texture would wait for the copy of the previous frame,
+// a dynamic texture would have to be rewritten as a whole after every WRITE_DISCARD
+class TexturePresentationSink final : public PresentationSink
+{
+public:
+    TexturePresentationSink(ID3D11Device* const pDevice, ID3D11DeviceContext* const pDeviceContext);
+    virtual ~TexturePresentationSink();
+    TexturePresentationSink(const TexturePresentationSink& other) = delete;
+    TexturePresentationSink(TexturePresentationSink&& other) = delete;
+    TexturePresentationSink& operator=(const TexturePresentationSink& other) = delete;
+    TexturePresentationSink& operator=(TexturePresentationSink&& other) = delete;
+
+protected:
+    virtual bool resize(const int width, const int height) override;
+    virtual bool map(const DirtyRect& dirtyRect, MutableImageView& outView) override;
+    virtual void unmap(const DirtyRect& dirtyRect) override;
+
+private:
+    // texture of one frame size with the frame in memory, rows that are not dirty keep the previous frame
+    struct TextureSet
+    {
+        ID3D11Texture2D* pTexture;
+        ID3D11ShaderResourceView* pTextureView;
+        Pixel* pPixels;
+
+        int Width;
+        int Height;
+    };
+
+private:
+    ID3D11Device* mpDevice;
+    ID3D11DeviceContext* mpDeviceContext;
+
+    TextureSet mTextureSets[TEXTURE_SET_COUNT];
+
+    // set of the presented size, -1 before the first frame
+    int mCurrentSetIndex;
+
+private:
+    bool createTextureSet(const int width, const int height, TextureSet& outSet);
+    void releaseTextureSet(TextureSet& set);
+};